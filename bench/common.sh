@@ -0,0 +1,31 @@
+# Setup shared by the bench scripts, sourced once BUILD and FRAMES are set.
+#
+# Points the loader at the stand-in runtime, free-running, with a session that stops after FRAMES frames, and runs
+# openxrstub under xvfb-run when there is no display.  Logs and stats files go to OUT, BUILD/bench by default.
+
+OUT=${OUT:-$BUILD/bench}
+
+mkdir -p "$OUT" || exit 1
+
+export XR_RUNTIME_JSON="$BUILD/openxrstub_runtime.json"
+export OPENXRSTUB_THROTTLE=0
+export OPENXRSTUB_SESSION_SCRIPT="READY@0,SYNCHRONIZED@0,VISIBLE@0,FOCUSED@0,STOPPING@$FRAMES"
+
+RUN=""
+if [ -z "$DISPLAY" ]; then
+    RUN="xvfb-run -a"
+fi
+
+# usage: run_openxrstub name log [openxrstub args...]
+#
+# Runs openxrstub with its output in log.  If it fails, prints where to look and returns non-zero.
+run_openxrstub() {
+    # sh has no locals, so these don't reuse the callers' names.
+    run_name=$1
+    run_log=$2
+    shift 2
+    if ! $RUN "$BUILD/openxrstub" "$@" > "$run_log" 2>&1; then
+        echo "$run_name: run failed, see $run_log"
+        return 1
+    fi
+}
@@ -0,0 +1,242 @@
+// fill cost of each color swapchain format on the current gl driver
+//
+// usage: openxrstub_fillrate [size] [passes]
+//
+// Renders passes full screen, alpha blended triangles into a size x size render target of each format, and
+// reports the median gpu time per pass, measured with GL_TIME_ELAPSED queries.  Blending reads and writes every
+// pixel, which is close to what a compositor does with a projection layer.
+
+#include <GL/glew.h>
+#include <SDL2/SDL.h>
+
+#include <vector>
+#include <algorithm>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+struct FillFormat
+{
+    const char* name;
+    GLenum internalFormat;
+    GLenum format;              // and type, of the texture without texture storage
+    GLenum type;
+    uint32_t bytesPerPixel;
+};
+
+// same names and order as the --color-format option
+static const FillFormat FILL_FORMATS[] = {
+    {"srgb8", GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE, 4},
+    {"rgb10a2", GL_RGB10_A2, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, 4},
+    {"r11g11b10f", GL_R11F_G11F_B10F, GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV, 4},
+    {"rgba16f", GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, 8},
+    {"rgba8", GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4}
+};
+static const uint32_t NUM_FILL_FORMATS = sizeof(FILL_FORMATS) / sizeof(FILL_FORMATS[0]);
+
+// each pass is timed this many times, the median is reported.
+static const int NUM_SAMPLES = 15;
+
+static bool CompileShader(GLuint& shader, GLenum type, const char* source)
+{
+    shader = glCreateShader(type);
+    int size = (int)strlen(source);
+    glShaderSource(shader, 1, (const GLchar**)&source, &size);
+    glCompileShader(shader);
+
+    GLint compiled;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    return (bool)compiled;
+}
+
+static bool CompileFillProgram(GLuint& program)
+{
+    // a triangle that covers the whole viewport, generated from gl_VertexID.
+    const char* vertSource = R"_(#version 330
+void main()
+{
+    vec2 uv = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);
+}
+)_";
+
+    const char* fragSource = R"_(#version 330
+out vec4 fragColor;
+void main()
+{
+    fragColor = vec4(0.25, 0.5, 0.75, 0.5);
+}
+)_";
+
+    GLuint vertShader = 0;
+    GLuint fragShader = 0;
+    if (!CompileShader(vertShader, GL_VERTEX_SHADER, vertSource) ||
+        !CompileShader(fragShader, GL_FRAGMENT_SHADER, fragSource))
+    {
+        printf("Failed to compile fill shaders\n");
+        return false;
+    }
+
+    program = glCreateProgram();
+    glAttachShader(program, vertShader);
+    glAttachShader(program, fragShader);
+    glLinkProgram(program);
+    glDeleteShader(vertShader);
+    glDeleteShader(fragShader);
+
+    GLint linked;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked)
+    {
+        printf("Failed to link fill program\n");
+        return false;
+    }
+    return true;
+}
+
+// median gpu time in nanoseconds of drawing passes full screen triangles into a render target of the given format,
+// returns false if the format can't be rendered to.
+static bool MeasureFill(const FillFormat& format, int32_t size, int passes, GLuint program, GLuint vao, double& result)
+{
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    // glTexStorage2D is gl 4.2, a 3.3 context may only have the mutable equivalent.
+    if (GLEW_VERSION_4_2 || GLEW_ARB_texture_storage)
+    {
+        glTexStorage2D(GL_TEXTURE_2D, 1, format.internalFormat, size, size);
+    }
+    else
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, format.internalFormat, size, size, 0, format.format, format.type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    GLuint frameBuffer;
+    glGenFramebuffers(1, &frameBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    const bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    if (complete)
+    {
+        glViewport(0, 0, size, size);
+        glUseProgram(program);
+        glBindVertexArray(vao);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        // one untimed round, so allocation and shader compilation aren't measured.
+        std::vector<double> samples;
+        GLuint query;
+        glGenQueries(1, &query);
+        for (int i = 0; i <= NUM_SAMPLES; i++)
+        {
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            glBeginQuery(GL_TIME_ELAPSED, query);
+            for (int j = 0; j < passes; j++)
+            {
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+            }
+            glEndQuery(GL_TIME_ELAPSED);
+
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+            if (i > 0)
+            {
+                samples.push_back((double)elapsed / passes);
+            }
+        }
+        glDeleteQueries(1, &query);
+
+        glDisable(GL_BLEND);
+        glBindVertexArray(0);
+        glUseProgram(0);
+
+        std::sort(samples.begin(), samples.end());
+        result = samples[samples.size() / 2];
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &frameBuffer);
+    glDeleteTextures(1, &texture);
+
+    return complete && glGetError() == GL_NO_ERROR;
+}
+
+int main(int argc, char *argv[])
+{
+    const int32_t size = argc > 1 ? atoi(argv[1]) : 2048;
+    const int passes = argc > 2 ? atoi(argv[2]) : 20;
+    if (size <= 0 || passes <= 0)
+    {
+        printf("usage: openxrstub_fillrate [size] [passes]\n");
+        return 1;
+    }
+
+    if (SDL_Init(SDL_INIT_VIDEO) != 0)
+    {
+        SDL_Log("Failed to initialize SDL: %s", SDL_GetError());
+        return 1;
+    }
+
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+    SDL_Window* window = SDL_CreateWindow("openxrstub_fillrate", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                                          64, 64, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+    SDL_GLContext glContext = window ? SDL_GL_CreateContext(window) : NULL;
+    if (!glContext)
+    {
+        SDL_Log("Failed to create gl context: %s", SDL_GetError());
+        return 1;
+    }
+
+    glewExperimental = GL_TRUE;
+    GLenum err = glewInit();
+    if (GLEW_OK != err)
+    {
+        printf("glewInit failed: %s\n", glewGetErrorString(err));
+        return 1;
+    }
+    // glewInit can leave an error behind on core contexts.
+    glGetError();
+
+    GLuint program = 0;
+    if (!CompileFillProgram(program))
+    {
+        return 1;
+    }
+
+    // core profile needs a vao bound to draw, even with no attributes.
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+
+    printf("%s, %dx%d, %d blended passes\n", (const char*)glGetString(GL_RENDERER), size, size, passes);
+    printf("%-12s %6s %12s %12s %12s\n", "format", "bpp", "us/pass", "Gpix/s", "GB/s");
+    const double pixels = (double)size * (double)size;
+    for (uint32_t i = 0; i < NUM_FILL_FORMATS; i++)
+    {
+        const FillFormat& format = FILL_FORMATS[i];
+        double ns = 0.0;
+        if (!MeasureFill(format, size, passes, program, vao, ns) || ns <= 0.0)
+        {
+            printf("%-12s %6u %12s\n", format.name, format.bytesPerPixel, "unsupported");
+            continue;
+        }
+        // blending reads and writes each pixel.
+        printf("%-12s %6u %12.1f %12.2f %12.2f\n", format.name, format.bytesPerPixel, ns / 1.0e3,
+               pixels / ns, 2.0 * pixels * format.bytesPerPixel / ns);
+    }
+
+    glDeleteVertexArrays(1, &vao);
+    glDeleteProgram(program);
+    SDL_GL_DeleteContext(glContext);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+
+    return 0;
+}
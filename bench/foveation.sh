@@ -0,0 +1,36 @@
+#!/bin/sh
+# Compares fixed foveation ring configurations on the stand-in runtime.
+#
+# usage: bench/foveation.sh [build dir] [frames] [stereo mode]
+#
+# Each configuration's gpu time of all views, (gpuRender), in microseconds, and the time saved against
+# rendering every pixel at full resolution.  The "foveation:" line in the log gives the fraction of pixels shaded.
+
+BUILD=${1:-build}
+FRAMES=${2:-2000}
+STEREO=${3:-twopass}
+. "$(dirname "$0")/common.sh"
+
+printf "%-28s %10s %12s %12s %10s\n" rings shaded gpu_p50 gpu_p95 saved
+base=""
+for rings in off 0.5:1,1:0.5 0.5:1,0.8:0.5,1:0.25 0.4:1,0.7:0.5,1:0.25 0.3:1,0.6:0.5,1:0.25; do
+    if [ $rings = off ]; then
+        args=""
+    else
+        args="--foveation-rings $rings"
+    fi
+    log="$OUT/foveation-$rings.log"
+    csv="$OUT/foveation-$rings.csv"
+    run_openxrstub $rings "$log" --stereo $STEREO $args --stats "$csv" || continue
+    shaded=$(sed -n 's/^foveation: .* rings, \([0-9.]*%\).*/\1/p' "$log")
+    line=$(awk -F, -v rings=$rings -v shaded="${shaded:-100%}" -v base="$base" '
+        $1 == "gpuRender" { gpu50 = $4; gpu95 = $5 }
+        END {
+            saved = base != "" && base > 0 ? sprintf("%.1f%%", 100.0 * (base - gpu50) / base) : "-"
+            printf "%-28s %10s %12s %12s %10s %s\n", rings, shaded, gpu50, gpu95, saved, gpu50
+        }' "$csv")
+    if [ -z "$base" ]; then
+        base=${line##* }
+    fi
+    echo "${line% *}"
+done
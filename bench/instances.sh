@@ -0,0 +1,32 @@
+#!/bin/sh
+# Compares the submit modes drawing many objects on the stand-in runtime, e.g. under llvmpipe.
+#
+# usage: bench/instances.sh [build dir] [frames] [stereo mode]
+#
+# For 10k and 100k stress instances and each submit mode: the frame time, in microseconds, the gl draw calls per
+# frame, and the objects drawn per second, the objects inside the views (cullVisible) over the frame time.
+
+BUILD=${1:-build}
+FRAMES=${2:-500}
+STEREO=${3:-twopass}
+. "$(dirname "$0")/common.sh"
+
+printf "%-10s %-10s %12s %12s %12s %14s\n" instances submit frame_p50 frame_mean draw_calls objects/s
+for instances in 10000 100000; do
+    for submit in direct instanced indirect; do
+        log="$OUT/instances-$instances-$submit.log"
+        csv="$OUT/instances-$instances-$submit.csv"
+        run_openxrstub "$instances $submit" "$log" --stereo $STEREO --stress-instances $instances --submit $submit \
+            --stats "$csv" || continue
+        # the mode actually used, in case the requested one isn't supported.
+        used=$(sed -n 's/^submit mode: \([a-z]*\).*/\1/p' "$log")
+        awk -F, -v instances=$instances -v submit="${used:-$submit}" '
+            $1 == "frame" { p50 = $4; mean = $3 }
+            $1 == "cullVisible" { visible = $3 }
+            $1 == "drawCalls" { calls = $3 }
+            END {
+                rate = mean > 0 ? visible / (mean / 1e6) : 0
+                printf "%-10s %-10s %12s %12s %12s %14.0f\n", instances, submit, p50, mean, calls, rate
+            }' "$csv"
+    done
+done
@@ -0,0 +1,29 @@
+#!/bin/sh
+# Compares msaa sample counts and resolve modes on the stand-in runtime.
+#
+# usage: bench/msaa.sh [build dir] [frames] [stereo mode]
+#
+# Each sample count is rendered with every resolve mode, the table shows the gpu time of all views including
+# the resolve, (gpuRender), in microseconds.  Modes that can't be used fall back, see the "msaa:" line in the log.
+
+BUILD=${1:-build}
+FRAMES=${2:-2000}
+STEREO=${3:-twopass}
+. "$(dirname "$0")/common.sh"
+
+printf "%-8s %-10s %-24s %12s %12s\n" samples mode used gpu_p50 gpu_p95
+for samples in 1 2 4 8; do
+    for mode in swapchain rtt blit; do
+        if [ $samples = 1 ] && [ $mode != swapchain ]; then
+            continue
+        fi
+        log="$OUT/msaa-$samples-$mode.log"
+        csv="$OUT/msaa-$samples-$mode.csv"
+        run_openxrstub "$samples $mode" "$log" --stereo $STEREO --samples $samples --msaa $mode \
+            --stats "$csv" || continue
+        used=$(sed -n 's/^msaa: //p' "$log" | tr ' ' '_')
+        awk -F, -v samples=$samples -v mode=$mode -v used="$used" '
+            $1 == "gpuRender" { gpu50 = $4; gpu95 = $5 }
+            END { printf "%-8s %-10s %-24s %12s %12s\n", samples, mode, used, gpu50, gpu95 }' "$csv"
+    done
+done
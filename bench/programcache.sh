@@ -0,0 +1,22 @@
+#!/bin/sh
+# Compares program link time with a cold and a warm program binary cache on the stand-in runtime.
+#
+# usage: bench/programcache.sh [build dir] [stereo mode] [submit mode]
+#
+# Runs a few frames twice against a fresh cache directory, the first run compiles and saves every program, the
+# second loads them with glProgramBinary.  Prints the "programs:" startup line of each run.
+
+BUILD=${1:-build}
+STEREO=${2:-twopass}
+SUBMIT=${3:-direct}
+FRAMES=10
+. "$(dirname "$0")/common.sh"
+
+CACHE="$OUT/programcache"
+rm -rf "$CACHE"
+
+for run in cold warm; do
+    log="$OUT/programcache-$run.log"
+    run_openxrstub $run "$log" --stereo $STEREO --submit $SUBMIT --program-cache "$CACHE" || continue
+    printf "%-6s %s\n" $run "$(grep '^programs:' "$log")"
+done
@@ -0,0 +1,126 @@
+// scene file load time
+//
+// usage: openxrstub_sceneload FILE [iterations]
+//
+// Times loading a scene file the way openxrstub does, mapping it and validating it with SceneLoad,
+// against reading the whole file into memory with fread, the copy a parser would start from.  Mapping only
+// costs page faults once the data is touched, so both are also timed through a first pass over every vertex
+// and index, which is what the gpu upload does.  Reports the median of each over the iterations.
+//
+// Make a big enough file with openxrstub_meshconv --generate 1000000 big.scene.  The page cache is warm after
+// the first iteration, drop it beforehand (echo 3 > /proc/sys/vm/drop_caches) to see a cold first load.
+
+#include "scene.h"
+
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static double Now()
+{
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double Median(std::vector<double> times)
+{
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+// reads every position and index once, returning something that depends on all of them.
+static uint64_t Touch(const float* positions, uint64_t vertexCount, const void* indices, uint64_t indexCount, uint32_t indexSize)
+{
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < vertexCount * 3; i++)
+    {
+        uint32_t bits;
+        memcpy(&bits, &positions[i], sizeof(bits));
+        sum += bits;
+    }
+    for (uint64_t i = 0; i < indexCount; i++)
+    {
+        sum += indexSize == 2 ? ((const uint16_t*)indices)[i] : ((const uint32_t*)indices)[i];
+    }
+    return sum;
+}
+
+static bool ReadWholeFile(const char* path, std::vector<uint8_t>& data)
+{
+    FILE* fp = fopen(path, "rb");
+    if (!fp)
+    {
+        return false;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    data.resize(size > 0 ? (size_t)size : 0);
+    bool ok = size > 0 && fread(data.data(), 1, data.size(), fp) == data.size();
+    fclose(fp);
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    const int iterations = argc > 2 ? atoi(argv[2]) : 10;
+    if (argc < 2 || iterations <= 0)
+    {
+        printf("usage: openxrstub_sceneload FILE [iterations]\n");
+        return 1;
+    }
+    const char* path = argv[1];
+
+    std::vector<double> mapTimes, mapTouchTimes, readTimes, readTouchTimes;
+    uint64_t mapSum = 0;
+    uint64_t readSum = 0;
+    Scene scene;
+    for (int it = 0; it < iterations; it++)
+    {
+        double t0 = Now();
+        if (!SceneLoad(scene, path))
+        {
+            return 1;
+        }
+        double t1 = Now();
+        mapSum = Touch(scene.positions, scene.vertexCount, scene.indices, scene.indexCount, scene.indexSize);
+        double t2 = Now();
+        mapTimes.push_back(t1 - t0);
+        mapTouchTimes.push_back(t2 - t0);
+        if (it + 1 < iterations)
+        {
+            SceneUnload(scene);
+        }
+
+        // the same arrays, found in a copy of the file.
+        std::vector<uint8_t> data;
+        t0 = Now();
+        if (!ReadWholeFile(path, data))
+        {
+            printf("Failed to read \"%s\"\n", path);
+            return 1;
+        }
+        t1 = Now();
+        SceneFileHeader header;
+        memcpy(&header, data.data(), sizeof(header));
+        readSum = Touch((const float*)(data.data() + header.vertexOffset), header.vertexCount,
+                        data.data() + header.indexOffset, header.indexCount, header.indexSize);
+        t2 = Now();
+        readTimes.push_back(t1 - t0);
+        readTouchTimes.push_back(t2 - t0);
+    }
+
+    printf("%s: %u meshes, %llu vertices, %llu indices, %.1f MB, %d iterations\n", path, scene.meshCount,
+           (unsigned long long)scene.vertexCount, (unsigned long long)scene.indexCount,
+           (double)scene.mappingSize / (1024.0 * 1024.0), iterations);
+    printf("%-16s %12s %16s\n", "median ms", "load", "load + touch");
+    printf("%-16s %12.3f %16.3f\n", "mmap", Median(mapTimes) / 1e6, Median(mapTouchTimes) / 1e6);
+    printf("%-16s %12.3f %16.3f\n", "fread", Median(readTimes) / 1e6, Median(readTouchTimes) / 1e6);
+    printf("mmap load + touch: %.1f M vertices/s\n", (double)scene.vertexCount / (Median(mapTouchTimes) / 1e3));
+
+    SceneUnload(scene);
+    return mapSum == readSum ? 0 : 1;
+}
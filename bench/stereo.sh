@@ -0,0 +1,24 @@
+#!/bin/sh
+# Compares the stereo rendering modes on the stand-in runtime.
+#
+# usage: bench/stereo.sh [build dir] [frames]
+#
+# Each mode renders the same frames with the runtime free-running, the table shows the cpu time spent
+# submitting the views, (renderView) and the gpu time of all views, (gpuRender), in microseconds.
+# Modes the gl implementation doesn't support fall back, see the "stereo mode:" line in the log.
+
+BUILD=${1:-build}
+FRAMES=${2:-2000}
+. "$(dirname "$0")/common.sh"
+
+printf "%-10s %-10s %12s %12s %12s %12s\n" mode used cpu_p50 cpu_p95 gpu_p50 gpu_p95
+for mode in twopass doublewide multiview layered; do
+    log="$OUT/stereo-$mode.log"
+    csv="$OUT/stereo-$mode.csv"
+    run_openxrstub $mode "$log" --stereo $mode --stats "$csv" || continue
+    used=$(sed -n 's/^stereo mode: //p' "$log")
+    awk -F, -v mode=$mode -v used="$used" '
+        $1 == "renderView" { cpu50 = $4; cpu95 = $5 }
+        $1 == "gpuRender" { gpu50 = $4; gpu95 = $5 }
+        END { printf "%-10s %-10s %12s %12s %12s %12s\n", mode, used, cpu50, cpu95, gpu50, gpu95 }' "$csv"
+done
@@ -0,0 +1,282 @@
+// scalar vs vector math kernels
+//
+// usage: openxrstub_xrmath_bench [iterations]
+//
+// Times the scalar matrix functions main.cpp used before src/xrmath.cpp against the xrmath kernels, on the same
+// random poses and fovs, and checks that they agree.  Reports nanoseconds per operation, the speedup and the
+// largest difference between the results.  Build with -mavx to time the AVX batch kernel.
+
+#include "xrmath.h"
+
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+// number of matrices each case works through per iteration, about the size of a large scene's draw list.
+static const uint32_t NUM_MATRICES = 1024;
+
+//
+// the scalar functions from main.cpp, as they were
+//
+
+static void InitPoseMat(float* result, const XrPosef& pose)
+{
+    const float x2 = pose.orientation.x + pose.orientation.x;
+    const float y2 = pose.orientation.y + pose.orientation.y;
+    const float z2 = pose.orientation.z + pose.orientation.z;
+
+    const float xx2 = pose.orientation.x * x2;
+    const float yy2 = pose.orientation.y * y2;
+    const float zz2 = pose.orientation.z * z2;
+
+    const float yz2 = pose.orientation.y * z2;
+    const float wx2 = pose.orientation.w * x2;
+    const float xy2 = pose.orientation.x * y2;
+    const float wz2 = pose.orientation.w * z2;
+    const float xz2 = pose.orientation.x * z2;
+    const float wy2 = pose.orientation.w * y2;
+
+    result[0] = 1.0f - yy2 - zz2;
+    result[1] = xy2 + wz2;
+    result[2] = xz2 - wy2;
+    result[3] = 0.0f;
+
+    result[4] = xy2 - wz2;
+    result[5] = 1.0f - xx2 - zz2;
+    result[6] = yz2 + wx2;
+    result[7] = 0.0f;
+
+    result[8] = xz2 + wy2;
+    result[9] = yz2 - wx2;
+    result[10] = 1.0f - xx2 - yy2;
+    result[11] = 0.0f;
+
+    result[12] = pose.position.x;
+    result[13] = pose.position.y;
+    result[14] = pose.position.z;
+    result[15] = 1.0;
+}
+
+static void MultiplyMat(float* result, const float* a, const float* b)
+{
+    result[0] = a[0] * b[0] + a[4] * b[1] + a[8] * b[2] + a[12] * b[3];
+    result[1] = a[1] * b[0] + a[5] * b[1] + a[9] * b[2] + a[13] * b[3];
+    result[2] = a[2] * b[0] + a[6] * b[1] + a[10] * b[2] + a[14] * b[3];
+    result[3] = a[3] * b[0] + a[7] * b[1] + a[11] * b[2] + a[15] * b[3];
+
+    result[4] = a[0] * b[4] + a[4] * b[5] + a[8] * b[6] + a[12] * b[7];
+    result[5] = a[1] * b[4] + a[5] * b[5] + a[9] * b[6] + a[13] * b[7];
+    result[6] = a[2] * b[4] + a[6] * b[5] + a[10] * b[6] + a[14] * b[7];
+    result[7] = a[3] * b[4] + a[7] * b[5] + a[11] * b[6] + a[15] * b[7];
+
+    result[8] = a[0] * b[8] + a[4] * b[9] + a[8] * b[10] + a[12] * b[11];
+    result[9] = a[1] * b[8] + a[5] * b[9] + a[9] * b[10] + a[13] * b[11];
+    result[10] = a[2] * b[8] + a[6] * b[9] + a[10] * b[10] + a[14] * b[11];
+    result[11] = a[3] * b[8] + a[7] * b[9] + a[11] * b[10] + a[15] * b[11];
+
+    result[12] = a[0] * b[12] + a[4] * b[13] + a[8] * b[14] + a[12] * b[15];
+    result[13] = a[1] * b[12] + a[5] * b[13] + a[9] * b[14] + a[13] * b[15];
+    result[14] = a[2] * b[12] + a[6] * b[13] + a[10] * b[14] + a[14] * b[15];
+    result[15] = a[3] * b[12] + a[7] * b[13] + a[11] * b[14] + a[15] * b[15];
+}
+
+static void InvertOrthogonalMat(float* result, float* src)
+{
+    result[0] = src[0];
+    result[1] = src[4];
+    result[2] = src[8];
+    result[3] = 0.0f;
+    result[4] = src[1];
+    result[5] = src[5];
+    result[6] = src[9];
+    result[7] = 0.0f;
+    result[8] = src[2];
+    result[9] = src[6];
+    result[10] = src[10];
+    result[11] = 0.0f;
+    result[12] = -(src[0] * src[12] + src[1] * src[13] + src[2] * src[14]);
+    result[13] = -(src[4] * src[12] + src[5] * src[13] + src[6] * src[14]);
+    result[14] = -(src[8] * src[12] + src[9] * src[13] + src[10] * src[14]);
+    result[15] = 1.0f;
+}
+
+static const float NEAR_Z = 0.05f;
+static const float FAR_Z = 100.0f;
+
+// what main.cpp did for every view of every frame.
+static void ComputeModelViewProjMat(float* result, const XrPosef& pose, const XrFovf& fov)
+{
+    const float tanLeft = tanf(fov.angleLeft);
+    const float tanRight = tanf(fov.angleRight);
+    const float tanDown = tanf(fov.angleDown);
+    const float tanUp = tanf(fov.angleUp);
+    float projMat[16];
+    XrMathInitProjectionMat(projMat, GRAPHICS_OPENGL, tanLeft, tanRight, tanUp, tanDown, NEAR_Z, FAR_Z);
+
+    float invViewMat[16];
+    InitPoseMat(invViewMat, pose);
+    float viewMat[16];
+    InvertOrthogonalMat(viewMat, invViewMat);
+
+    MultiplyMat(result, projMat, viewMat);
+}
+
+//
+// benchmark
+//
+
+static float Random(float lo, float hi)
+{
+    return lo + (hi - lo) * (float)rand() / (float)RAND_MAX;
+}
+
+static XrPosef RandomPose()
+{
+    XrPosef pose;
+    XrQuaternionf& q = pose.orientation;
+    q = {Random(-1.0f, 1.0f), Random(-1.0f, 1.0f), Random(-1.0f, 1.0f), Random(-1.0f, 1.0f)};
+    const float len = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+    q = {q.x / len, q.y / len, q.z / len, q.w / len};
+    pose.position = {Random(-2.0f, 2.0f), Random(0.0f, 2.0f), Random(-2.0f, 2.0f)};
+    return pose;
+}
+
+static double Now()
+{
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static float MaxDifference(const std::vector<float>& a, const std::vector<float>& b)
+{
+    float maxDiff = 0.0f;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        maxDiff = std::max(maxDiff, fabsf(a[i] - b[i]));
+    }
+    return maxDiff;
+}
+
+static void Report(const char* name, double scalarNs, double vectorNs, float maxDiff)
+{
+    printf("%-28s %10.2f %10.2f %8.2fx %12g\n", name, scalarNs, vectorNs, scalarNs / vectorNs, maxDiff);
+}
+
+int main(int argc, char *argv[])
+{
+    const int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+    if (iterations <= 0)
+    {
+        printf("usage: openxrstub_xrmath_bench [iterations]\n");
+        return 1;
+    }
+
+    srand(1);
+    std::vector<XrPosef> poses(NUM_MATRICES);
+    std::vector<float> mats(NUM_MATRICES * 16);
+    for (uint32_t i = 0; i < NUM_MATRICES; i++)
+    {
+        poses[i] = RandomPose();
+        InitPoseMat(&mats[i * 16], poses[i]);
+    }
+    float viewProjMat[16];
+    XrMathInitProjectionMat(viewProjMat, GRAPHICS_OPENGL, -1.0f, 0.9f, 0.95f, -1.0f, NEAR_Z, FAR_Z);
+
+    // like the stand-in runtime's left eye, fovs only change if the user adjusts the headset.
+    const XrFovf fov = {-0.90f, 0.80f, 0.85f, -0.90f};
+
+    std::vector<float> scalarResults(NUM_MATRICES * 16);
+    std::vector<float> vectorResults(NUM_MATRICES * 16);
+    const double ops = (double)iterations * NUM_MATRICES;
+
+    printf("xrmath backend: %s, %d iterations of %u matrices\n", XrMathBackend(), iterations, NUM_MATRICES);
+    printf("%-28s %10s %10s %9s %12s\n", "ns per matrix", "scalar", "xrmath", "speedup", "max diff");
+
+    // a * b, one pair at a time.
+    double t0 = Now();
+    for (int it = 0; it < iterations; it++)
+    {
+        for (uint32_t i = 0; i < NUM_MATRICES; i++)
+        {
+            MultiplyMat(&scalarResults[i * 16], &mats[i * 16], &mats[((i + 1) % NUM_MATRICES) * 16]);
+        }
+    }
+    double t1 = Now();
+    for (int it = 0; it < iterations; it++)
+    {
+        for (uint32_t i = 0; i < NUM_MATRICES; i++)
+        {
+            XrMathMultiplyMat(&vectorResults[i * 16], &mats[i * 16], &mats[((i + 1) % NUM_MATRICES) * 16]);
+        }
+    }
+    double t2 = Now();
+    Report("multiply", (t1 - t0) / ops, (t2 - t1) / ops, MaxDifference(scalarResults, vectorResults));
+
+    // every model matrix by one view projection.
+    t0 = Now();
+    for (int it = 0; it < iterations; it++)
+    {
+        for (uint32_t i = 0; i < NUM_MATRICES; i++)
+        {
+            MultiplyMat(&scalarResults[i * 16], viewProjMat, &mats[i * 16]);
+        }
+    }
+    t1 = Now();
+    for (int it = 0; it < iterations; it++)
+    {
+        XrMathMultiplyMatBatch(vectorResults.data(), viewProjMat, mats.data(), NUM_MATRICES);
+    }
+    t2 = Now();
+    Report("multiply batch", (t1 - t0) / ops, (t2 - t1) / ops, MaxDifference(scalarResults, vectorResults));
+
+    // view matrix of a pose.
+    t0 = Now();
+    for (int it = 0; it < iterations; it++)
+    {
+        for (uint32_t i = 0; i < NUM_MATRICES; i++)
+        {
+            float poseMat[16];
+            InitPoseMat(poseMat, poses[i]);
+            InvertOrthogonalMat(&scalarResults[i * 16], poseMat);
+        }
+    }
+    t1 = Now();
+    for (int it = 0; it < iterations; it++)
+    {
+        for (uint32_t i = 0; i < NUM_MATRICES; i++)
+        {
+            XrMathInitViewMat(&vectorResults[i * 16], poses[i]);
+        }
+    }
+    t2 = Now();
+    Report("view from pose", (t1 - t0) / ops, (t2 - t1) / ops, MaxDifference(scalarResults, vectorResults));
+
+    // the whole per view matrix, as main.cpp computes it each frame.
+    t0 = Now();
+    for (int it = 0; it < iterations; it++)
+    {
+        for (uint32_t i = 0; i < NUM_MATRICES; i++)
+        {
+            ComputeModelViewProjMat(&scalarResults[i * 16], poses[i], fov);
+        }
+    }
+    t1 = Now();
+    XrMathProjectionCache cache;
+    for (int it = 0; it < iterations; it++)
+    {
+        for (uint32_t i = 0; i < NUM_MATRICES; i++)
+        {
+            const float* projMat = XrMathGetProjectionMat(cache, fov, NEAR_Z, FAR_Z);
+            float viewMat[16];
+            XrMathInitViewMat(viewMat, poses[i]);
+            XrMathMultiplyMat(&vectorResults[i * 16], projMat, viewMat);
+        }
+    }
+    t2 = Now();
+    Report("view projection", (t1 - t0) / ops, (t2 - t1) / ops, MaxDifference(scalarResults, vectorResults));
+
+    return 0;
+}
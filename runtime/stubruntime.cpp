@@ -0,0 +1,1679 @@
+// openxrstub stand-in runtime
+//
+// A headless, deterministic OpenXR runtime that implements just enough of the api for openxrstub to run
+// its full frame loop without a headset.  It is loaded through the regular OpenXR loader by pointing
+// XR_RUNTIME_JSON at the generated openxrstub_runtime.json manifest.
+//
+// Swapchain images are plain OpenGL textures created in the application's current context,
+// nothing is ever presented.  Behaviour is controlled with environment variables:
+//
+//    OPENXRSTUB_DISPLAY_HZ       display refresh rate, (default 90)
+//    OPENXRSTUB_THROTTLE         1 = xrWaitFrame blocks on a virtual vsync, 0 = free-run (default 1)
+//    OPENXRSTUB_VIEW_SIZE        recommended per-eye image size, WIDTHxHEIGHT (default 1024x1024)
+//    OPENXRSTUB_POSE_SCRIPT      "static", "orbit" or a path to a keyframe file (default static)
+//    OPENXRSTUB_SESSION_SCRIPT   comma separated STATE@frame list (default READY@0,SYNCHRONIZED@0,VISIBLE@0,FOCUSED@0)
+//
+// Pose keyframe files have one keyframe per line: "frame px py pz qx qy qz qw", lines starting with # are ignored.
+// Keyframes are indexed by display frame, (displayTime - sessionBeginTime) / displayPeriod, so with
+// OPENXRSTUB_THROTTLE=0 every run sees exactly the same sequence of poses.
+//
+// Session script entries fire once the given number of frames have been ended with xrEndFrame.
+// For example "READY@0,SYNCHRONIZED@0,VISIBLE@0,FOCUSED@0,STOPPING@900" runs for 900 frames then asks the
+// application to end the session, after xrEndSession the runtime transitions to IDLE and EXITING.
+//
+// With XR_KHR_visibility_mask, each view's hidden area is the part of its fov outside an inscribed ellipse,
+// and a XR_TYPE_EVENT_DATA_VISIBILITY_MASK_CHANGED_KHR event is queued per view when the session begins.
+
+#define XR_USE_GRAPHICS_API_OPENGL
+#if defined(WIN32)
+#define XR_USE_PLATFORM_WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#define RUNTIME_EXPORT extern "C" __declspec(dllexport)
+#else
+#define XR_USE_PLATFORM_XLIB
+#define RUNTIME_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+#include <GL/glew.h>
+#if defined(XR_USE_PLATFORM_XLIB)
+#include <GL/glx.h>
+#endif
+
+#include <openxr/openxr.h>
+#include <openxr/openxr_platform.h>
+#include <openxr/openxr_loader_negotiation.h>
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static const uint32_t NUM_VIEWS = 2;
+static const uint32_t SWAPCHAIN_LENGTH = 3;
+static const float IPD = 0.064f;
+static const XrSystemId SYSTEM_ID = 1;
+static const double PI = 3.14159265358979323846;
+
+struct Config
+{
+    double displayHz = 90.0;
+    bool throttle = true;
+    uint32_t viewWidth = 1024;
+    uint32_t viewHeight = 1024;
+    std::string poseScript = "static";
+    std::string sessionScript = "READY@0,SYNCHRONIZED@0,VISIBLE@0,FOCUSED@0";
+};
+
+struct PoseKey
+{
+    double frame;
+    XrPosef pose;
+};
+
+struct SessionScriptEntry
+{
+    XrSessionState state;
+    uint64_t frame;
+};
+
+struct Instance
+{
+    Config config;
+    std::vector<PoseKey> poseKeys;
+    std::vector<std::string> paths;
+    std::deque<XrEventDataBuffer> events;
+    std::mutex mutex;
+    bool depthLayerEnabled = false;
+    bool visibilityMaskEnabled = false;
+};
+
+struct Session
+{
+    Instance* instance;
+    XrSessionState state = XR_SESSION_STATE_UNKNOWN;
+    bool running = false;
+    bool exitRequested = false;
+    std::vector<SessionScriptEntry> script;
+    size_t scriptPos = 0;
+
+    // frame loop bookkeeping, guarded by frameMutex.
+    std::mutex frameMutex;
+    std::condition_variable frameCond;
+    XrTime epoch = 0;
+    XrDuration period = 0;
+    uint64_t lastDisplayIndex = 0;
+    uint64_t framesWaited = 0;
+    uint64_t framesBegun = 0;
+    uint64_t framesEnded = 0;
+    uint64_t framesLate = 0;
+    uint64_t depthViewsSubmitted = 0;
+    bool frameInProgress = false;
+};
+
+struct Space
+{
+    Session* session;
+    XrReferenceSpaceType type;  // XR_REFERENCE_SPACE_TYPE_MAX_ENUM for action spaces
+    XrPosef pose;
+};
+
+struct ActionSet
+{
+    Instance* instance;
+};
+
+struct Action
+{
+    ActionSet* actionSet;
+    XrActionType type;
+};
+
+struct Swapchain
+{
+    Session* session;
+    XrSwapchainCreateInfo info;
+    std::vector<uint32_t> images;
+    uint32_t nextIndex = 0;
+    std::deque<uint32_t> acquired;
+    bool waited = false;
+};
+
+//
+// time
+//
+
+static XrTime Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void SleepUntil(XrTime t)
+{
+    XrTime now = Now();
+    if (t > now)
+    {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(t - now));
+    }
+}
+
+//
+// pose math
+//
+
+static XrQuaternionf QuatMul(const XrQuaternionf& a, const XrQuaternionf& b)
+{
+    XrQuaternionf r;
+    r.w = a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z;
+    r.x = a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y;
+    r.y = a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x;
+    r.z = a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w;
+    return r;
+}
+
+static XrVector3f QuatRotate(const XrQuaternionf& q, const XrVector3f& v)
+{
+    XrQuaternionf p = {v.x, v.y, v.z, 0.0f};
+    XrQuaternionf qc = {-q.x, -q.y, -q.z, q.w};
+    XrQuaternionf r = QuatMul(QuatMul(q, p), qc);
+    return {r.x, r.y, r.z};
+}
+
+static XrQuaternionf QuatFromYawPitch(float yaw, float pitch)
+{
+    XrQuaternionf qy = {0.0f, sinf(yaw * 0.5f), 0.0f, cosf(yaw * 0.5f)};
+    XrQuaternionf qx = {sinf(pitch * 0.5f), 0.0f, 0.0f, cosf(pitch * 0.5f)};
+    return QuatMul(qy, qx);
+}
+
+// result = a * b
+static XrPosef PoseMul(const XrPosef& a, const XrPosef& b)
+{
+    XrPosef r;
+    r.orientation = QuatMul(a.orientation, b.orientation);
+    XrVector3f p = QuatRotate(a.orientation, b.position);
+    r.position = {p.x + a.position.x, p.y + a.position.y, p.z + a.position.z};
+    return r;
+}
+
+static XrPosef PoseInverse(const XrPosef& a)
+{
+    XrPosef r;
+    r.orientation = {-a.orientation.x, -a.orientation.y, -a.orientation.z, a.orientation.w};
+    XrVector3f p = QuatRotate(r.orientation, a.position);
+    r.position = {-p.x, -p.y, -p.z};
+    return r;
+}
+
+static XrPosef PoseLerp(const XrPosef& a, const XrPosef& b, float t)
+{
+    XrPosef r;
+    r.position.x = a.position.x + (b.position.x - a.position.x) * t;
+    r.position.y = a.position.y + (b.position.y - a.position.y) * t;
+    r.position.z = a.position.z + (b.position.z - a.position.z) * t;
+
+    // nlerp, taking the short way around.
+    XrQuaternionf qb = b.orientation;
+    float dot = a.orientation.x * qb.x + a.orientation.y * qb.y + a.orientation.z * qb.z + a.orientation.w * qb.w;
+    if (dot < 0.0f)
+    {
+        qb = {-qb.x, -qb.y, -qb.z, -qb.w};
+    }
+    XrQuaternionf q;
+    q.x = a.orientation.x + (qb.x - a.orientation.x) * t;
+    q.y = a.orientation.y + (qb.y - a.orientation.y) * t;
+    q.z = a.orientation.z + (qb.z - a.orientation.z) * t;
+    q.w = a.orientation.w + (qb.w - a.orientation.w) * t;
+    float len = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+    r.orientation = {q.x / len, q.y / len, q.z / len, q.w / len};
+    return r;
+}
+
+static const XrPosef IDENTITY_POSE = {{0.0f, 0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, 0.0f}};
+
+//
+// config & scripts
+//
+
+static const char* SessionStateToString(XrSessionState state)
+{
+    switch (state)
+    {
+    case XR_SESSION_STATE_IDLE: return "IDLE";
+    case XR_SESSION_STATE_READY: return "READY";
+    case XR_SESSION_STATE_SYNCHRONIZED: return "SYNCHRONIZED";
+    case XR_SESSION_STATE_VISIBLE: return "VISIBLE";
+    case XR_SESSION_STATE_FOCUSED: return "FOCUSED";
+    case XR_SESSION_STATE_STOPPING: return "STOPPING";
+    case XR_SESSION_STATE_LOSS_PENDING: return "LOSS_PENDING";
+    case XR_SESSION_STATE_EXITING: return "EXITING";
+    default: return "UNKNOWN";
+    }
+}
+
+static void LoadConfig(Config& config)
+{
+    const char* str;
+    if ((str = getenv("OPENXRSTUB_DISPLAY_HZ")) && atof(str) > 0.0)
+    {
+        config.displayHz = atof(str);
+    }
+    if ((str = getenv("OPENXRSTUB_THROTTLE")))
+    {
+        config.throttle = atoi(str) != 0;
+    }
+    if ((str = getenv("OPENXRSTUB_VIEW_SIZE")))
+    {
+        unsigned int w, h;
+        if (sscanf(str, "%ux%u", &w, &h) == 2 && w > 0 && h > 0)
+        {
+            config.viewWidth = w;
+            config.viewHeight = h;
+        }
+    }
+    if ((str = getenv("OPENXRSTUB_POSE_SCRIPT")))
+    {
+        config.poseScript = str;
+    }
+    if ((str = getenv("OPENXRSTUB_SESSION_SCRIPT")))
+    {
+        config.sessionScript = str;
+    }
+}
+
+static bool LoadPoseScript(const std::string& filename, std::vector<PoseKey>& keys)
+{
+    FILE* fp = fopen(filename.c_str(), "r");
+    if (!fp)
+    {
+        printf("openxrstub runtime: could not open pose script \"%s\"\n", filename.c_str());
+        return false;
+    }
+
+    char line[512];
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (line[0] == '#')
+        {
+            continue;
+        }
+        PoseKey key;
+        XrPosef& p = key.pose;
+        if (sscanf(line, "%lf %f %f %f %f %f %f %f", &key.frame, &p.position.x, &p.position.y, &p.position.z,
+                   &p.orientation.x, &p.orientation.y, &p.orientation.z, &p.orientation.w) == 8)
+        {
+            keys.push_back(key);
+        }
+    }
+    fclose(fp);
+
+    if (keys.empty())
+    {
+        printf("openxrstub runtime: pose script \"%s\" has no keyframes\n", filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+static bool ParseSessionScript(const std::string& str, std::vector<SessionScriptEntry>& script)
+{
+    static const XrSessionState states[] = {
+        XR_SESSION_STATE_IDLE, XR_SESSION_STATE_READY, XR_SESSION_STATE_SYNCHRONIZED, XR_SESSION_STATE_VISIBLE,
+        XR_SESSION_STATE_FOCUSED, XR_SESSION_STATE_STOPPING, XR_SESSION_STATE_LOSS_PENDING, XR_SESSION_STATE_EXITING
+    };
+
+    size_t start = 0;
+    while (start < str.size())
+    {
+        size_t end = str.find(',', start);
+        if (end == std::string::npos)
+        {
+            end = str.size();
+        }
+        std::string entry = str.substr(start, end - start);
+        start = end + 1;
+
+        size_t at = entry.find('@');
+        std::string name = entry.substr(0, at);
+        SessionScriptEntry e;
+        e.state = XR_SESSION_STATE_UNKNOWN;
+        e.frame = at == std::string::npos ? 0 : strtoull(entry.c_str() + at + 1, NULL, 10);
+        for (auto state : states)
+        {
+            if (name == SessionStateToString(state))
+            {
+                e.state = state;
+            }
+        }
+        if (e.state == XR_SESSION_STATE_UNKNOWN)
+        {
+            printf("openxrstub runtime: bad session script entry \"%s\"\n", entry.c_str());
+            return false;
+        }
+        script.push_back(e);
+    }
+    return true;
+}
+
+// head pose in stage space for a fractional display frame index.
+static XrPosef HeadPose(const Instance* instance, double frame)
+{
+    const Config& config = instance->config;
+    if (!instance->poseKeys.empty())
+    {
+        const std::vector<PoseKey>& keys = instance->poseKeys;
+        if (frame <= keys.front().frame)
+        {
+            return keys.front().pose;
+        }
+        for (size_t i = 1; i < keys.size(); i++)
+        {
+            if (frame < keys[i].frame)
+            {
+                float t = (float)((frame - keys[i - 1].frame) / (keys[i].frame - keys[i - 1].frame));
+                return PoseLerp(keys[i - 1].pose, keys[i].pose, t);
+            }
+        }
+        return keys.back().pose;
+    }
+
+    XrPosef pose;
+    pose.position = {0.0f, 1.6f, 0.0f};
+    if (config.poseScript == "orbit")
+    {
+        // one full turn every 10 seconds, with a gentle nod.
+        const double seconds = frame / config.displayHz;
+        const float yaw = (float)(seconds * 2.0 * PI / 10.0);
+        const float pitch = 0.2f * (float)sin(seconds * 2.0 * PI / 3.0);
+        pose.orientation = QuatFromYawPitch(yaw, pitch);
+    }
+    else
+    {
+        pose.orientation = {0.0f, 0.0f, 0.0f, 1.0f};
+    }
+    return pose;
+}
+
+//
+// events & session state
+//
+
+// instance->mutex must be held.
+static void PushSessionStateEvent(Session* session, XrSessionState state)
+{
+    XrEventDataBuffer buffer;
+    memset(&buffer, 0, sizeof(buffer));
+    XrEventDataSessionStateChanged* ssc = (XrEventDataSessionStateChanged*)&buffer;
+    ssc->type = XR_TYPE_EVENT_DATA_SESSION_STATE_CHANGED;
+    ssc->next = NULL;
+    ssc->session = (XrSession)session;
+    ssc->state = state;
+    ssc->time = Now();
+    session->instance->events.push_back(buffer);
+    session->state = state;
+}
+
+// instance->mutex must be held.
+static void PushVisibilityMaskChangedEvent(Session* session, uint32_t viewIndex)
+{
+    XrEventDataBuffer buffer;
+    memset(&buffer, 0, sizeof(buffer));
+    XrEventDataVisibilityMaskChangedKHR* vmc = (XrEventDataVisibilityMaskChangedKHR*)&buffer;
+    vmc->type = XR_TYPE_EVENT_DATA_VISIBILITY_MASK_CHANGED_KHR;
+    vmc->next = NULL;
+    vmc->session = (XrSession)session;
+    vmc->viewConfigurationType = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO;
+    vmc->viewIndex = viewIndex;
+    session->instance->events.push_back(buffer);
+}
+
+// advance the session script, instance->mutex must be held.
+static void UpdateSessionState(Session* session, uint64_t framesEnded)
+{
+    while (session->scriptPos < session->script.size())
+    {
+        const SessionScriptEntry& entry = session->script[session->scriptPos];
+        if (framesEnded < entry.frame)
+        {
+            break;
+        }
+
+        // states that are part of a running frame loop must wait for xrBeginSession.
+        bool needsRunning = entry.state == XR_SESSION_STATE_SYNCHRONIZED ||
+            entry.state == XR_SESSION_STATE_VISIBLE ||
+            entry.state == XR_SESSION_STATE_FOCUSED ||
+            entry.state == XR_SESSION_STATE_STOPPING;
+        if (needsRunning && !session->running)
+        {
+            break;
+        }
+
+        PushSessionStateEvent(session, entry.state);
+        session->scriptPos++;
+    }
+}
+
+//
+// gl helpers
+//
+
+static bool InitGL()
+{
+    // swapchain images are created in the application's context, which must be current on this thread.
+    static bool initialized = false;
+    if (!initialized)
+    {
+        glewExperimental = GL_TRUE;
+        GLenum err = glewInit();
+        if (GLEW_OK != err)
+        {
+            printf("openxrstub runtime: glewInit failed: %s\n", glewGetErrorString(err));
+            return false;
+        }
+        initialized = true;
+    }
+    return true;
+}
+
+// color formats first, in order of preference, then depth formats for XR_KHR_composition_layer_depth.
+static const int64_t SWAPCHAIN_FORMATS[] = {
+    GL_RGBA16F, GL_RGBA8, GL_SRGB8_ALPHA8, GL_RGB10_A2, GL_R11F_G11F_B10F,
+    GL_DEPTH_COMPONENT32F, GL_DEPTH24_STENCIL8, GL_DEPTH_COMPONENT16, GL_DEPTH_COMPONENT32
+};
+static const uint32_t NUM_COLOR_FORMATS = 5;
+
+static bool FormatSupported(int64_t format)
+{
+    for (auto f : SWAPCHAIN_FORMATS)
+    {
+        if (f == format)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool IsDepthFormat(int64_t format)
+{
+    for (uint32_t i = NUM_COLOR_FORMATS; i < sizeof(SWAPCHAIN_FORMATS) / sizeof(SWAPCHAIN_FORMATS[0]); i++)
+    {
+        if (SWAPCHAIN_FORMATS[i] == format)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static GLuint CreateSwapchainTexture(const XrSwapchainCreateInfo& info)
+{
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    GLenum internalFormat = (GLenum)info.format;
+    if (info.sampleCount > 1)
+    {
+        if (info.arraySize > 1)
+        {
+            glBindTexture(GL_TEXTURE_2D_MULTISAMPLE_ARRAY, texture);
+            glTexStorage3DMultisample(GL_TEXTURE_2D_MULTISAMPLE_ARRAY, info.sampleCount, internalFormat,
+                                       info.width, info.height, info.arraySize, GL_TRUE);
+            glBindTexture(GL_TEXTURE_2D_MULTISAMPLE_ARRAY, 0);
+        }
+        else
+        {
+            glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, texture);
+            glTexStorage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, info.sampleCount, internalFormat,
+                                       info.width, info.height, GL_TRUE);
+            glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+        }
+    }
+    else if (info.arraySize > 1)
+    {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, info.mipCount, internalFormat, info.width, info.height, info.arraySize);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+    else
+    {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexStorage2D(GL_TEXTURE_2D, info.mipCount, internalFormat, info.width, info.height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    return texture;
+}
+
+//
+// two-call idiom helper
+//
+
+template <typename T>
+static XrResult FillArray(const T* src, uint32_t count, uint32_t capacityInput, uint32_t* countOutput, T* dst)
+{
+    if (!countOutput)
+    {
+        return XR_ERROR_VALIDATION_FAILURE;
+    }
+    *countOutput = count;
+    if (capacityInput == 0)
+    {
+        return XR_SUCCESS;
+    }
+    if (capacityInput < count)
+    {
+        return XR_ERROR_SIZE_INSUFFICIENT;
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        dst[i] = src[i];
+    }
+    return XR_SUCCESS;
+}
+
+//
+// instance
+//
+
+static const char* const SUPPORTED_EXTENSIONS[] = {
+    XR_KHR_OPENGL_ENABLE_EXTENSION_NAME,
+    XR_KHR_COMPOSITION_LAYER_DEPTH_EXTENSION_NAME,
+    XR_KHR_VISIBILITY_MASK_EXTENSION_NAME
+};
+
+static XrResult XRAPI_CALL stub_xrEnumerateInstanceExtensionProperties(const char* layerName, uint32_t propertyCapacityInput,
+                                                                       uint32_t* propertyCountOutput, XrExtensionProperties* properties)
+{
+    if (layerName)
+    {
+        return XR_ERROR_API_LAYER_NOT_PRESENT;
+    }
+    const uint32_t count = sizeof(SUPPORTED_EXTENSIONS) / sizeof(SUPPORTED_EXTENSIONS[0]);
+    *propertyCountOutput = count;
+    if (propertyCapacityInput == 0)
+    {
+        return XR_SUCCESS;
+    }
+    if (propertyCapacityInput < count)
+    {
+        return XR_ERROR_SIZE_INSUFFICIENT;
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        strncpy(properties[i].extensionName, SUPPORTED_EXTENSIONS[i], XR_MAX_EXTENSION_NAME_SIZE - 1);
+        properties[i].extensionName[XR_MAX_EXTENSION_NAME_SIZE - 1] = '\0';
+        properties[i].extensionVersion = 1;
+    }
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrCreateInstance(const XrInstanceCreateInfo* createInfo, XrInstance* instance)
+{
+    if (!createInfo || createInfo->type != XR_TYPE_INSTANCE_CREATE_INFO || !instance)
+    {
+        return XR_ERROR_VALIDATION_FAILURE;
+    }
+
+    for (uint32_t i = 0; i < createInfo->enabledExtensionCount; i++)
+    {
+        bool found = false;
+        for (auto ext : SUPPORTED_EXTENSIONS)
+        {
+            if (!strcmp(ext, createInfo->enabledExtensionNames[i]))
+            {
+                found = true;
+            }
+        }
+        if (!found)
+        {
+            return XR_ERROR_EXTENSION_NOT_PRESENT;
+        }
+    }
+
+    Instance* inst = new Instance();
+    LoadConfig(inst->config);
+    for (uint32_t i = 0; i < createInfo->enabledExtensionCount; i++)
+    {
+        if (!strcmp(createInfo->enabledExtensionNames[i], XR_KHR_COMPOSITION_LAYER_DEPTH_EXTENSION_NAME))
+        {
+            inst->depthLayerEnabled = true;
+        }
+        if (!strcmp(createInfo->enabledExtensionNames[i], XR_KHR_VISIBILITY_MASK_EXTENSION_NAME))
+        {
+            inst->visibilityMaskEnabled = true;
+        }
+    }
+    if (inst->config.poseScript != "static" && inst->config.poseScript != "orbit")
+    {
+        if (!LoadPoseScript(inst->config.poseScript, inst->poseKeys))
+        {
+            delete inst;
+            return XR_ERROR_INITIALIZATION_FAILED;
+        }
+    }
+
+    printf("openxrstub runtime: %.1f Hz %s, %ux%u per eye, pose script \"%s\"\n", inst->config.displayHz,
+           inst->config.throttle ? "throttled" : "free-running", inst->config.viewWidth, inst->config.viewHeight,
+           inst->config.poseScript.c_str());
+
+    *instance = (XrInstance)inst;
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrDestroyInstance(XrInstance instance)
+{
+    delete (Instance*)instance;
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrGetInstanceProperties(XrInstance instance, XrInstanceProperties* instanceProperties)
+{
+    instanceProperties->runtimeVersion = XR_MAKE_VERSION(0, 1, 0);
+    strcpy(instanceProperties->runtimeName, "openxrstub stand-in runtime");
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrResultToString(XrInstance instance, XrResult value, char buffer[XR_MAX_RESULT_STRING_SIZE])
+{
+    const char* str = NULL;
+    switch (value)
+    {
+#define RESULT_CASE(r) case r: str = #r; break;
+    RESULT_CASE(XR_SUCCESS)
+    RESULT_CASE(XR_TIMEOUT_EXPIRED)
+    RESULT_CASE(XR_SESSION_LOSS_PENDING)
+    RESULT_CASE(XR_EVENT_UNAVAILABLE)
+    RESULT_CASE(XR_SESSION_NOT_FOCUSED)
+    RESULT_CASE(XR_FRAME_DISCARDED)
+    RESULT_CASE(XR_ERROR_VALIDATION_FAILURE)
+    RESULT_CASE(XR_ERROR_RUNTIME_FAILURE)
+    RESULT_CASE(XR_ERROR_HANDLE_INVALID)
+    RESULT_CASE(XR_ERROR_SIZE_INSUFFICIENT)
+    RESULT_CASE(XR_ERROR_FUNCTION_UNSUPPORTED)
+    RESULT_CASE(XR_ERROR_EXTENSION_NOT_PRESENT)
+    RESULT_CASE(XR_ERROR_SESSION_RUNNING)
+    RESULT_CASE(XR_ERROR_SESSION_NOT_RUNNING)
+    RESULT_CASE(XR_ERROR_SESSION_NOT_READY)
+    RESULT_CASE(XR_ERROR_SESSION_NOT_STOPPING)
+    RESULT_CASE(XR_ERROR_CALL_ORDER_INVALID)
+    RESULT_CASE(XR_ERROR_LAYER_INVALID)
+    RESULT_CASE(XR_ERROR_SWAPCHAIN_RECT_INVALID)
+    RESULT_CASE(XR_ERROR_SWAPCHAIN_FORMAT_UNSUPPORTED)
+    RESULT_CASE(XR_ERROR_PATH_FORMAT_INVALID)
+    RESULT_CASE(XR_ERROR_PATH_INVALID)
+    RESULT_CASE(XR_ERROR_FORM_FACTOR_UNSUPPORTED)
+    RESULT_CASE(XR_ERROR_VIEW_CONFIGURATION_TYPE_UNSUPPORTED)
+    RESULT_CASE(XR_ERROR_REFERENCE_SPACE_UNSUPPORTED)
+    RESULT_CASE(XR_ERROR_INITIALIZATION_FAILED)
+#undef RESULT_CASE
+    default:
+        break;
+    }
+    if (str)
+    {
+        snprintf(buffer, XR_MAX_RESULT_STRING_SIZE, "%s", str);
+    }
+    else
+    {
+        snprintf(buffer, XR_MAX_RESULT_STRING_SIZE, "XR_%s_%d", XR_SUCCEEDED(value) ? "UNKNOWN_SUCCESS" : "UNKNOWN_FAILURE", (int)value);
+    }
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrPollEvent(XrInstance instance, XrEventDataBuffer* eventData)
+{
+    Instance* inst = (Instance*)instance;
+    std::lock_guard<std::mutex> lock(inst->mutex);
+    if (inst->events.empty())
+    {
+        return XR_EVENT_UNAVAILABLE;
+    }
+    *eventData = inst->events.front();
+    inst->events.pop_front();
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrStringToPath(XrInstance instance, const char* pathString, XrPath* path)
+{
+    Instance* inst = (Instance*)instance;
+    if (!pathString || pathString[0] != '/')
+    {
+        return XR_ERROR_PATH_FORMAT_INVALID;
+    }
+    std::lock_guard<std::mutex> lock(inst->mutex);
+    for (size_t i = 0; i < inst->paths.size(); i++)
+    {
+        if (inst->paths[i] == pathString)
+        {
+            *path = (XrPath)(i + 1);
+            return XR_SUCCESS;
+        }
+    }
+    inst->paths.push_back(pathString);
+    *path = (XrPath)inst->paths.size();
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrPathToString(XrInstance instance, XrPath path, uint32_t bufferCapacityInput,
+                                               uint32_t* bufferCountOutput, char* buffer)
+{
+    Instance* inst = (Instance*)instance;
+    std::lock_guard<std::mutex> lock(inst->mutex);
+    if (path == XR_NULL_PATH || path > inst->paths.size())
+    {
+        return XR_ERROR_PATH_INVALID;
+    }
+    const std::string& str = inst->paths[path - 1];
+    return FillArray(str.c_str(), (uint32_t)str.size() + 1, bufferCapacityInput, bufferCountOutput, buffer);
+}
+
+//
+// system
+//
+
+static XrResult XRAPI_CALL stub_xrGetSystem(XrInstance instance, const XrSystemGetInfo* getInfo, XrSystemId* systemId)
+{
+    if (getInfo->formFactor != XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY)
+    {
+        return XR_ERROR_FORM_FACTOR_UNSUPPORTED;
+    }
+    *systemId = SYSTEM_ID;
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrGetSystemProperties(XrInstance instance, XrSystemId systemId, XrSystemProperties* properties)
+{
+    const Config& config = ((Instance*)instance)->config;
+    properties->systemId = systemId;
+    properties->vendorId = 0;
+    strcpy(properties->systemName, "openxrstub headless hmd");
+    properties->graphicsProperties.maxLayerCount = 16;
+    properties->graphicsProperties.maxSwapchainImageWidth = config.viewWidth * 4;
+    properties->graphicsProperties.maxSwapchainImageHeight = config.viewHeight * 2;
+    properties->trackingProperties.orientationTracking = XR_TRUE;
+    properties->trackingProperties.positionTracking = XR_TRUE;
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrEnumerateViewConfigurations(XrInstance instance, XrSystemId systemId, uint32_t viewConfigurationTypeCapacityInput,
+                                                              uint32_t* viewConfigurationTypeCountOutput, XrViewConfigurationType* viewConfigurationTypes)
+{
+    static const XrViewConfigurationType types[] = {XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO};
+    return FillArray(types, 1, viewConfigurationTypeCapacityInput, viewConfigurationTypeCountOutput, viewConfigurationTypes);
+}
+
+static XrResult XRAPI_CALL stub_xrGetViewConfigurationProperties(XrInstance instance, XrSystemId systemId, XrViewConfigurationType viewConfigurationType,
+                                                                 XrViewConfigurationProperties* configurationProperties)
+{
+    if (viewConfigurationType != XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO)
+    {
+        return XR_ERROR_VIEW_CONFIGURATION_TYPE_UNSUPPORTED;
+    }
+    configurationProperties->viewConfigurationType = viewConfigurationType;
+    configurationProperties->fovMutable = XR_FALSE;
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrEnumerateViewConfigurationViews(XrInstance instance, XrSystemId systemId, XrViewConfigurationType viewConfigurationType,
+                                                                  uint32_t viewCapacityInput, uint32_t* viewCountOutput, XrViewConfigurationView* views)
+{
+    if (viewConfigurationType != XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO)
+    {
+        return XR_ERROR_VIEW_CONFIGURATION_TYPE_UNSUPPORTED;
+    }
+    *viewCountOutput = NUM_VIEWS;
+    if (viewCapacityInput == 0)
+    {
+        return XR_SUCCESS;
+    }
+    if (viewCapacityInput < NUM_VIEWS)
+    {
+        return XR_ERROR_SIZE_INSUFFICIENT;
+    }
+    const Config& config = ((Instance*)instance)->config;
+    for (uint32_t i = 0; i < NUM_VIEWS; i++)
+    {
+        views[i].recommendedImageRectWidth = config.viewWidth;
+        views[i].recommendedImageRectHeight = config.viewHeight;
+        views[i].maxImageRectWidth = config.viewWidth * 2;
+        views[i].maxImageRectHeight = config.viewHeight * 2;
+        views[i].recommendedSwapchainSampleCount = 1;
+        views[i].maxSwapchainSampleCount = 4;
+    }
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrEnumerateEnvironmentBlendModes(XrInstance instance, XrSystemId systemId, XrViewConfigurationType viewConfigurationType,
+                                                                 uint32_t environmentBlendModeCapacityInput, uint32_t* environmentBlendModeCountOutput,
+                                                                 XrEnvironmentBlendMode* environmentBlendModes)
+{
+    static const XrEnvironmentBlendMode modes[] = {XR_ENVIRONMENT_BLEND_MODE_OPAQUE};
+    return FillArray(modes, 1, environmentBlendModeCapacityInput, environmentBlendModeCountOutput, environmentBlendModes);
+}
+
+static XrResult XRAPI_CALL stub_xrGetOpenGLGraphicsRequirementsKHR(XrInstance instance, XrSystemId systemId,
+                                                                   XrGraphicsRequirementsOpenGLKHR* graphicsRequirements)
+{
+    graphicsRequirements->minApiVersionSupported = XR_MAKE_VERSION(3, 3, 0);
+    graphicsRequirements->maxApiVersionSupported = XR_MAKE_VERSION(4, 6, 0);
+    return XR_SUCCESS;
+}
+
+//
+// session
+//
+
+static XrResult XRAPI_CALL stub_xrCreateSession(XrInstance instance, const XrSessionCreateInfo* createInfo, XrSession* session)
+{
+    Instance* inst = (Instance*)instance;
+    if (createInfo->systemId != SYSTEM_ID)
+    {
+        return XR_ERROR_SYSTEM_INVALID;
+    }
+
+    bool hasBinding = false;
+    for (const XrBaseInStructure* next = (const XrBaseInStructure*)createInfo->next; next; next = next->next)
+    {
+        if (next->type == XR_TYPE_GRAPHICS_BINDING_OPENGL_WIN32_KHR ||
+            next->type == XR_TYPE_GRAPHICS_BINDING_OPENGL_XLIB_KHR ||
+            next->type == XR_TYPE_GRAPHICS_BINDING_OPENGL_XCB_KHR ||
+            next->type == XR_TYPE_GRAPHICS_BINDING_OPENGL_WAYLAND_KHR)
+        {
+            hasBinding = true;
+        }
+    }
+    if (!hasBinding)
+    {
+        return XR_ERROR_GRAPHICS_DEVICE_INVALID;
+    }
+
+    Session* s = new Session();
+    s->instance = inst;
+    s->period = (XrDuration)(1.0e9 / inst->config.displayHz);
+    if (!ParseSessionScript(inst->config.sessionScript, s->script))
+    {
+        delete s;
+        return XR_ERROR_INITIALIZATION_FAILED;
+    }
+
+    std::lock_guard<std::mutex> lock(inst->mutex);
+    PushSessionStateEvent(s, XR_SESSION_STATE_IDLE);
+    UpdateSessionState(s, 0);
+
+    *session = (XrSession)s;
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrDestroySession(XrSession session)
+{
+    Session* s = (Session*)session;
+    printf("openxrstub runtime: %llu frames submitted, %llu late\n",
+           (unsigned long long)s->framesEnded, (unsigned long long)s->framesLate);
+    if (s->instance->depthLayerEnabled)
+    {
+        printf("openxrstub runtime: %llu views submitted with depth\n", (unsigned long long)s->depthViewsSubmitted);
+    }
+    delete s;
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrBeginSession(XrSession session, const XrSessionBeginInfo* beginInfo)
+{
+    Session* s = (Session*)session;
+    if (beginInfo->primaryViewConfigurationType != XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO)
+    {
+        return XR_ERROR_VIEW_CONFIGURATION_TYPE_UNSUPPORTED;
+    }
+
+    std::lock_guard<std::mutex> lock(s->instance->mutex);
+    if (s->running)
+    {
+        return XR_ERROR_SESSION_RUNNING;
+    }
+    if (s->state != XR_SESSION_STATE_READY)
+    {
+        return XR_ERROR_SESSION_NOT_READY;
+    }
+    s->running = true;
+    {
+        std::lock_guard<std::mutex> frameLock(s->frameMutex);
+        s->epoch = Now();
+        s->lastDisplayIndex = 0;
+    }
+    UpdateSessionState(s, s->framesEnded);
+
+    // like a real runtime refining the lens area once the display is running, so applications see the event.
+    for (uint32_t i = 0; s->instance->visibilityMaskEnabled && i < NUM_VIEWS; i++)
+    {
+        PushVisibilityMaskChangedEvent(s, i);
+    }
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrEndSession(XrSession session)
+{
+    Session* s = (Session*)session;
+    std::lock_guard<std::mutex> lock(s->instance->mutex);
+    if (!s->running)
+    {
+        return XR_ERROR_SESSION_NOT_RUNNING;
+    }
+    if (s->state != XR_SESSION_STATE_STOPPING)
+    {
+        return XR_ERROR_SESSION_NOT_STOPPING;
+    }
+    s->running = false;
+    PushSessionStateEvent(s, XR_SESSION_STATE_IDLE);
+    PushSessionStateEvent(s, XR_SESSION_STATE_EXITING);
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrRequestExitSession(XrSession session)
+{
+    Session* s = (Session*)session;
+    std::lock_guard<std::mutex> lock(s->instance->mutex);
+    if (!s->running)
+    {
+        return XR_ERROR_SESSION_NOT_RUNNING;
+    }
+    if (!s->exitRequested)
+    {
+        s->exitRequested = true;
+        s->scriptPos = s->script.size();
+        PushSessionStateEvent(s, XR_SESSION_STATE_STOPPING);
+    }
+    return XR_SUCCESS;
+}
+
+//
+// spaces
+//
+
+static XrResult XRAPI_CALL stub_xrEnumerateReferenceSpaces(XrSession session, uint32_t spaceCapacityInput, uint32_t* spaceCountOutput,
+                                                           XrReferenceSpaceType* spaces)
+{
+    static const XrReferenceSpaceType types[] = {
+        XR_REFERENCE_SPACE_TYPE_VIEW, XR_REFERENCE_SPACE_TYPE_LOCAL, XR_REFERENCE_SPACE_TYPE_STAGE
+    };
+    return FillArray(types, 3, spaceCapacityInput, spaceCountOutput, spaces);
+}
+
+static XrResult XRAPI_CALL stub_xrCreateReferenceSpace(XrSession session, const XrReferenceSpaceCreateInfo* createInfo, XrSpace* space)
+{
+    if (createInfo->referenceSpaceType != XR_REFERENCE_SPACE_TYPE_VIEW &&
+        createInfo->referenceSpaceType != XR_REFERENCE_SPACE_TYPE_LOCAL &&
+        createInfo->referenceSpaceType != XR_REFERENCE_SPACE_TYPE_STAGE)
+    {
+        return XR_ERROR_REFERENCE_SPACE_UNSUPPORTED;
+    }
+    Space* s = new Space();
+    s->session = (Session*)session;
+    s->type = createInfo->referenceSpaceType;
+    s->pose = createInfo->poseInReferenceSpace;
+    *space = (XrSpace)s;
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrCreateActionSpace(XrSession session, const XrActionSpaceCreateInfo* createInfo, XrSpace* space)
+{
+    Space* s = new Space();
+    s->session = (Session*)session;
+    s->type = XR_REFERENCE_SPACE_TYPE_MAX_ENUM;
+    s->pose = createInfo->poseInActionSpace;
+    *space = (XrSpace)s;
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrLocateSpace(XrSpace space, XrSpace baseSpace, XrTime time, XrSpaceLocation* location)
+{
+    // there are no controllers, so action spaces are never tracked.
+    location->locationFlags = 0;
+    location->pose = IDENTITY_POSE;
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrDestroySpace(XrSpace space)
+{
+    delete (Space*)space;
+    return XR_SUCCESS;
+}
+
+// pose of the space's origin in stage space at the given display frame.
+static XrPosef SpaceToStage(const Space* space, double frame)
+{
+    switch (space->type)
+    {
+    case XR_REFERENCE_SPACE_TYPE_VIEW:
+        return PoseMul(HeadPose(space->session->instance, frame), space->pose);
+    case XR_REFERENCE_SPACE_TYPE_LOCAL:
+    {
+        // local space sits at eye height above the stage origin.
+        XrPosef local = IDENTITY_POSE;
+        local.position.y = 1.6f;
+        return PoseMul(local, space->pose);
+    }
+    default:
+        return space->pose;
+    }
+}
+
+//
+// actions
+//
+
+static XrResult XRAPI_CALL stub_xrCreateActionSet(XrInstance instance, const XrActionSetCreateInfo* createInfo, XrActionSet* actionSet)
+{
+    if (createInfo->actionSetName[0] == '\0')
+    {
+        return XR_ERROR_NAME_INVALID;
+    }
+    ActionSet* as = new ActionSet();
+    as->instance = (Instance*)instance;
+    *actionSet = (XrActionSet)as;
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrDestroyActionSet(XrActionSet actionSet)
+{
+    delete (ActionSet*)actionSet;
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrCreateAction(XrActionSet actionSet, const XrActionCreateInfo* createInfo, XrAction* action)
+{
+    if (createInfo->actionName[0] == '\0')
+    {
+        return XR_ERROR_NAME_INVALID;
+    }
+    Action* a = new Action();
+    a->actionSet = (ActionSet*)actionSet;
+    a->type = createInfo->actionType;
+    *action = (XrAction)a;
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrDestroyAction(XrAction action)
+{
+    delete (Action*)action;
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrSuggestInteractionProfileBindings(XrInstance instance, const XrInteractionProfileSuggestedBinding* suggestedBindings)
+{
+    if (suggestedBindings->interactionProfile == XR_NULL_PATH)
+    {
+        return XR_ERROR_PATH_INVALID;
+    }
+    for (uint32_t i = 0; i < suggestedBindings->countSuggestedBindings; i++)
+    {
+        if (suggestedBindings->suggestedBindings[i].binding == XR_NULL_PATH)
+        {
+            return XR_ERROR_PATH_INVALID;
+        }
+    }
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrAttachSessionActionSets(XrSession session, const XrSessionActionSetsAttachInfo* attachInfo)
+{
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrSyncActions(XrSession session, const XrActionsSyncInfo* syncInfo)
+{
+    Session* s = (Session*)session;
+    std::lock_guard<std::mutex> lock(s->instance->mutex);
+    if (!s->running)
+    {
+        return XR_ERROR_SESSION_NOT_RUNNING;
+    }
+    return s->state == XR_SESSION_STATE_FOCUSED ? XR_SUCCESS : XR_SESSION_NOT_FOCUSED;
+}
+
+//
+// swapchains
+//
+
+static XrResult XRAPI_CALL stub_xrEnumerateSwapchainFormats(XrSession session, uint32_t formatCapacityInput, uint32_t* formatCountOutput, int64_t* formats)
+{
+    Session* s = (Session*)session;
+    const uint32_t count = s->instance->depthLayerEnabled ? sizeof(SWAPCHAIN_FORMATS) / sizeof(SWAPCHAIN_FORMATS[0]) : NUM_COLOR_FORMATS;
+    return FillArray(SWAPCHAIN_FORMATS, count, formatCapacityInput, formatCountOutput, formats);
+}
+
+static XrResult XRAPI_CALL stub_xrCreateSwapchain(XrSession session, const XrSwapchainCreateInfo* createInfo, XrSwapchain* swapchain)
+{
+    if (!FormatSupported(createInfo->format))
+    {
+        return XR_ERROR_SWAPCHAIN_FORMAT_UNSUPPORTED;
+    }
+    if (IsDepthFormat(createInfo->format) && !(createInfo->usageFlags & XR_SWAPCHAIN_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT))
+    {
+        return XR_ERROR_VALIDATION_FAILURE;
+    }
+    if (createInfo->faceCount != 1 || createInfo->arraySize < 1 || createInfo->mipCount < 1 ||
+        createInfo->sampleCount < 1 || createInfo->width == 0 || createInfo->height == 0)
+    {
+        return XR_ERROR_VALIDATION_FAILURE;
+    }
+    if (!InitGL())
+    {
+        return XR_ERROR_RUNTIME_FAILURE;
+    }
+    if (!GLEW_ARB_texture_storage || (createInfo->sampleCount > 1 && !GLEW_ARB_texture_storage_multisample))
+    {
+        return XR_ERROR_FEATURE_UNSUPPORTED;
+    }
+
+    Swapchain* sc = new Swapchain();
+    sc->session = (Session*)session;
+    sc->info = *createInfo;
+    sc->info.next = NULL;
+    for (uint32_t i = 0; i < SWAPCHAIN_LENGTH; i++)
+    {
+        sc->images.push_back(CreateSwapchainTexture(sc->info));
+    }
+    *swapchain = (XrSwapchain)sc;
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrDestroySwapchain(XrSwapchain swapchain)
+{
+    Swapchain* sc = (Swapchain*)swapchain;
+    glDeleteTextures((GLsizei)sc->images.size(), sc->images.data());
+    delete sc;
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrEnumerateSwapchainImages(XrSwapchain swapchain, uint32_t imageCapacityInput, uint32_t* imageCountOutput,
+                                                           XrSwapchainImageBaseHeader* images)
+{
+    Swapchain* sc = (Swapchain*)swapchain;
+    const uint32_t count = (uint32_t)sc->images.size();
+    *imageCountOutput = count;
+    if (imageCapacityInput == 0)
+    {
+        return XR_SUCCESS;
+    }
+    if (imageCapacityInput < count)
+    {
+        return XR_ERROR_SIZE_INSUFFICIENT;
+    }
+    XrSwapchainImageOpenGLKHR* glImages = (XrSwapchainImageOpenGLKHR*)images;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (glImages[i].type != XR_TYPE_SWAPCHAIN_IMAGE_OPENGL_KHR)
+        {
+            return XR_ERROR_VALIDATION_FAILURE;
+        }
+        glImages[i].image = sc->images[i];
+    }
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrAcquireSwapchainImage(XrSwapchain swapchain, const XrSwapchainImageAcquireInfo* acquireInfo, uint32_t* index)
+{
+    Swapchain* sc = (Swapchain*)swapchain;
+    if (sc->acquired.size() >= sc->images.size())
+    {
+        return XR_ERROR_CALL_ORDER_INVALID;
+    }
+    *index = sc->nextIndex;
+    sc->acquired.push_back(sc->nextIndex);
+    sc->nextIndex = (sc->nextIndex + 1) % (uint32_t)sc->images.size();
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrWaitSwapchainImage(XrSwapchain swapchain, const XrSwapchainImageWaitInfo* waitInfo)
+{
+    Swapchain* sc = (Swapchain*)swapchain;
+    if (sc->acquired.empty() || sc->waited)
+    {
+        return XR_ERROR_CALL_ORDER_INVALID;
+    }
+    // images are never in use by a compositor, so they are always immediately available.
+    sc->waited = true;
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrReleaseSwapchainImage(XrSwapchain swapchain, const XrSwapchainImageReleaseInfo* releaseInfo)
+{
+    Swapchain* sc = (Swapchain*)swapchain;
+    if (!sc->waited)
+    {
+        return XR_ERROR_CALL_ORDER_INVALID;
+    }
+    sc->acquired.pop_front();
+    sc->waited = false;
+    return XR_SUCCESS;
+}
+
+//
+// frame loop
+//
+
+static XrResult XRAPI_CALL stub_xrWaitFrame(XrSession session, const XrFrameWaitInfo* frameWaitInfo, XrFrameState* frameState)
+{
+    Session* s = (Session*)session;
+    bool shouldRender;
+    {
+        std::lock_guard<std::mutex> lock(s->instance->mutex);
+        if (!s->running)
+        {
+            return XR_ERROR_SESSION_NOT_RUNNING;
+        }
+        shouldRender = s->state == XR_SESSION_STATE_VISIBLE || s->state == XR_SESSION_STATE_FOCUSED;
+    }
+
+    std::unique_lock<std::mutex> frameLock(s->frameMutex);
+
+    // a second xrWaitFrame blocks until the previous frame has been begun.
+    s->frameCond.wait(frameLock, [s]() { return s->framesBegun >= s->framesWaited; });
+
+    uint64_t displayIndex = s->lastDisplayIndex + 1;
+    if (s->instance->config.throttle)
+    {
+        // return one period before the next vsync that we can still make.
+        const XrTime now = Now();
+        const uint64_t nowIndex = now > s->epoch ? (uint64_t)((now - s->epoch) / s->period) : 0;
+        if (nowIndex + 1 > displayIndex)
+        {
+            displayIndex = nowIndex + 1;
+        }
+        const XrTime wakeTime = s->epoch + (XrTime)(displayIndex - 1) * s->period;
+        frameLock.unlock();
+        SleepUntil(wakeTime);
+        frameLock.lock();
+    }
+
+    s->lastDisplayIndex = displayIndex;
+    s->framesWaited++;
+
+    frameState->predictedDisplayTime = s->epoch + (XrTime)displayIndex * s->period;
+    frameState->predictedDisplayPeriod = s->period;
+    frameState->shouldRender = shouldRender ? XR_TRUE : XR_FALSE;
+    return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL stub_xrBeginFrame(XrSession session, const XrFrameBeginInfo* frameBeginInfo)
+{
+    Session* s = (Session*)session;
+    XrResult result = XR_SUCCESS;
+    {
+        std::lock_guard<std::mutex> frameLock(s->frameMutex);
+        if (s->framesBegun >= s->framesWaited)
+        {
+            return XR_ERROR_CALL_ORDER_INVALID;
+        }
+        if (s->frameInProgress)
+        {
+            // the previous frame was never ended, it is discarded.
+            result = XR_FRAME_DISCARDED;
+        }
+        s->frameInProgress = true;
+        s->framesBegun++;
+    }
+    s->frameCond.notify_all();
+    return result;
+}
+
+static bool SubImageValid(const XrSwapchainSubImage& sub)
+{
+    const Swapchain* sc = (const Swapchain*)sub.swapchain;
+    return sub.imageRect.offset.x >= 0 && sub.imageRect.offset.y >= 0 &&
+           sub.imageRect.extent.width > 0 && sub.imageRect.extent.height > 0 &&
+           (uint32_t)(sub.imageRect.offset.x + sub.imageRect.extent.width) <= sc->info.width &&
+           (uint32_t)(sub.imageRect.offset.y + sub.imageRect.extent.height) <= sc->info.height;
+}
+
+static XrResult XRAPI_CALL stub_xrEndFrame(XrSession session, const XrFrameEndInfo* frameEndInfo)
+{
+    Session* s = (Session*)session;
+    if (frameEndInfo->environmentBlendMode != XR_ENVIRONMENT_BLEND_MODE_OPAQUE)
+    {
+        return XR_ERROR_ENVIRONMENT_BLEND_MODE_UNSUPPORTED;
+    }
+
+    for (uint32_t i = 0; i < frameEndInfo->layerCount; i++)
+    {
+        const XrCompositionLayerBaseHeader* layer = frameEndInfo->layers[i];
+        if (!layer)
+        {
+            return XR_ERROR_LAYER_INVALID;
+        }
+        if (layer->type != XR_TYPE_COMPOSITION_LAYER_PROJECTION)
+        {
+            continue;
+        }
+        const XrCompositionLayerProjection* proj = (const XrCompositionLayerProjection*)layer;
+        if (proj->viewCount != NUM_VIEWS)
+        {
+            return XR_ERROR_VALIDATION_FAILURE;
+        }
+        for (uint32_t v = 0; v < proj->viewCount; v++)
+        {
+            const XrSwapchainSubImage& sub = proj->views[v].subImage;
+            const Swapchain* sc = (const Swapchain*)sub.swapchain;
+            if (!sc)
+            {
+                return XR_ERROR_HANDLE_INVALID;
+            }
+            if (!SubImageValid(sub))
+            {
+                return XR_ERROR_SWAPCHAIN_RECT_INVALID;
+            }
+            if (sub.imageArrayIndex >= sc->info.arraySize)
+            {
+                return XR_ERROR_VALIDATION_FAILURE;
+            }
+
+            // the depth is only validated, the stand-in compositor never reprojects.
+            for (const XrBaseInStructure* ext = (const XrBaseInStructure*)proj->views[v].next; ext; ext = ext->next)
+            {
+                if (ext->type != XR_TYPE_COMPOSITION_LAYER_DEPTH_INFO_KHR)
+                {
+                    continue;
+                }
+                if (!s->instance->depthLayerEnabled)
+                {
+                    return XR_ERROR_VALIDATION_FAILURE;
+                }
+                const XrCompositionLayerDepthInfoKHR* depthInfo = (const XrCompositionLayerDepthInfoKHR*)ext;
+                const Swapchain* depthSc = (const Swapchain*)depthInfo->subImage.swapchain;
+                if (!depthSc)
+                {
+                    return XR_ERROR_HANDLE_INVALID;
+                }
+                if (!IsDepthFormat(depthSc->info.format) || depthInfo->subImage.imageArrayIndex >= depthSc->info.arraySize)
+                {
+                    return XR_ERROR_VALIDATION_FAILURE;
+                }
+                if (!SubImageValid(depthInfo->subImage))
+                {
+                    return XR_ERROR_SWAPCHAIN_RECT_INVALID;
+                }
+                if (depthInfo->minDepth < 0.0f || depthInfo->maxDepth > 1.0f || depthInfo->minDepth >= depthInfo->maxDepth ||
+                    depthInfo->nearZ == depthInfo->farZ)
+                {
+                    return XR_ERROR_VALIDATION_FAILURE;
+                }
+                s->depthViewsSubmitted++;
+            }
+        }
+    }
+
+    uint64_t framesEnded;
+    {
+        std::lock_guard<std::mutex> frameLock(s->frameMutex);
+        if (!s->frameInProgress)
+        {
+            return XR_ERROR_CALL_ORDER_INVALID;
+        }
+        s->frameInProgress = false;
+        if (Now() > frameEndInfo->displayTime && s->instance->config.throttle)
+        {
+            s->framesLate++;
+        }
+        framesEnded = ++s->framesEnded;
+    }
+
+    std::lock_guard<std::mutex> lock(s->instance->mutex);
+    UpdateSessionState(s, framesEnded);
+    return XR_SUCCESS;
+}
+
+// slightly asymmetric, canted-outward fovs, like a typical hmd.
+static XrFovf ViewFov(uint32_t viewIndex)
+{
+    const XrFovf leftFov = {-0.90f, 0.80f, 0.85f, -0.90f};
+    if (viewIndex == 0)
+    {
+        return leftFov;
+    }
+    return {-leftFov.angleRight, -leftFov.angleLeft, leftFov.angleUp, leftFov.angleDown};
+}
+
+static XrResult XRAPI_CALL stub_xrLocateViews(XrSession session, const XrViewLocateInfo* viewLocateInfo, XrViewState* viewState,
+                                              uint32_t viewCapacityInput, uint32_t* viewCountOutput, XrView* views)
+{
+    Session* s = (Session*)session;
+    if (viewLocateInfo->viewConfigurationType != XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO)
+    {
+        return XR_ERROR_VIEW_CONFIGURATION_TYPE_UNSUPPORTED;
+    }
+    *viewCountOutput = NUM_VIEWS;
+    if (viewCapacityInput == 0)
+    {
+        return XR_SUCCESS;
+    }
+    if (viewCapacityInput < NUM_VIEWS)
+    {
+        return XR_ERROR_SIZE_INSUFFICIENT;
+    }
+
+    XrTime epoch;
+    XrDuration period;
+    {
+        std::lock_guard<std::mutex> frameLock(s->frameMutex);
+        epoch = s->epoch;
+        period = s->period;
+    }
+    const double frame = (double)(viewLocateInfo->displayTime - epoch) / (double)period;
+
+    // views are located in the requested space: inverse(space) * head * eye.
+    const XrPosef headPose = HeadPose(s->instance, frame);
+    const XrPosef spaceInv = PoseInverse(SpaceToStage((const Space*)viewLocateInfo->space, frame));
+
+    for (uint32_t i = 0; i < NUM_VIEWS; i++)
+    {
+        XrPosef eye = IDENTITY_POSE;
+        eye.position.x = (i == 0 ? -0.5f : 0.5f) * IPD;
+        views[i].pose = PoseMul(spaceInv, PoseMul(headPose, eye));
+        views[i].fov = ViewFov(i);
+    }
+
+    viewState->viewStateFlags = XR_VIEW_STATE_ORIENTATION_VALID_BIT | XR_VIEW_STATE_POSITION_VALID_BIT |
+        XR_VIEW_STATE_ORIENTATION_TRACKED_BIT | XR_VIEW_STATE_POSITION_TRACKED_BIT;
+    return XR_SUCCESS;
+}
+
+//
+// XR_KHR_visibility_mask
+//
+
+// segments around the ellipse, a multiple of 8 so the corners of the fov rect are on the outer ring.
+static const uint32_t VISIBILITY_MASK_SEGMENTS = 32;
+
+// the part of the view's fov rect outside the inscribed ellipse, as a ring of quads between the ellipse and
+// the rect, on the z = -1 plane.  About 21% of the rect, close to the hidden area of real lenses.
+static void BuildHiddenAreaMesh(const XrFovf& fov, std::vector<XrVector2f>& vertices, std::vector<uint32_t>& indices)
+{
+    const float left = tanf(fov.angleLeft);
+    const float right = tanf(fov.angleRight);
+    const float down = tanf(fov.angleDown);
+    const float up = tanf(fov.angleUp);
+    const float cx = 0.5f * (left + right);
+    const float cy = 0.5f * (down + up);
+    const float rx = 0.5f * (right - left);
+    const float ry = 0.5f * (up - down);
+
+    // vertex 2 * i is on the ellipse, 2 * i + 1 where the same ray leaves the rect.
+    vertices.resize(2 * VISIBILITY_MASK_SEGMENTS);
+    for (uint32_t i = 0; i < VISIBILITY_MASK_SEGMENTS; i++)
+    {
+        const float a = 2.0f * (float)PI * (float)i / (float)VISIBILITY_MASK_SEGMENTS;
+        const float c = cosf(a);
+        const float s = sinf(a);
+        const float edge = 1.0f / std::max(fabsf(c), fabsf(s));
+        vertices[2 * i] = {cx + rx * c, cy + ry * s};
+        vertices[2 * i + 1] = {cx + rx * c * edge, cy + ry * s * edge};
+    }
+
+    // counter-clockwise, as the extension requires.
+    indices.clear();
+    for (uint32_t i = 0; i < VISIBILITY_MASK_SEGMENTS; i++)
+    {
+        const uint32_t j = (i + 1) % VISIBILITY_MASK_SEGMENTS;
+        const uint32_t quad[6] = {2 * i, 2 * i + 1, 2 * j + 1, 2 * i, 2 * j + 1, 2 * j};
+        indices.insert(indices.end(), quad, quad + 6);
+    }
+}
+
+static XrResult XRAPI_CALL stub_xrGetVisibilityMaskKHR(XrSession session, XrViewConfigurationType viewConfigurationType,
+                                                       uint32_t viewIndex, XrVisibilityMaskTypeKHR visibilityMaskType,
+                                                       XrVisibilityMaskKHR* visibilityMask)
+{
+    Session* s = (Session*)session;
+    if (!s->instance->visibilityMaskEnabled)
+    {
+        return XR_ERROR_FUNCTION_UNSUPPORTED;
+    }
+    if (viewConfigurationType != XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO)
+    {
+        return XR_ERROR_VIEW_CONFIGURATION_TYPE_UNSUPPORTED;
+    }
+    if (viewIndex >= NUM_VIEWS || !visibilityMask || visibilityMask->type != XR_TYPE_VISIBILITY_MASK_KHR)
+    {
+        return XR_ERROR_VALIDATION_FAILURE;
+    }
+
+    // only the hidden mesh is provided, the visible mesh and line loop are empty, which the extension allows.
+    std::vector<XrVector2f> vertices;
+    std::vector<uint32_t> indices;
+    if (visibilityMaskType == XR_VISIBILITY_MASK_TYPE_HIDDEN_TRIANGLE_MESH_KHR)
+    {
+        BuildHiddenAreaMesh(ViewFov(viewIndex), vertices, indices);
+    }
+
+    XrResult result = FillArray(vertices.data(), (uint32_t)vertices.size(), visibilityMask->vertexCapacityInput,
+                                &visibilityMask->vertexCountOutput, visibilityMask->vertices);
+    if (result != XR_SUCCESS)
+    {
+        return result;
+    }
+    return FillArray(indices.data(), (uint32_t)indices.size(), visibilityMask->indexCapacityInput,
+                     &visibilityMask->indexCountOutput, visibilityMask->indices);
+}
+
+//
+// dispatch
+//
+
+struct ProcEntry
+{
+    const char* name;
+    PFN_xrVoidFunction func;
+};
+
+#define PROC(name) {#name, (PFN_xrVoidFunction)stub_##name}
+
+static const ProcEntry PROCS[] = {
+    PROC(xrEnumerateInstanceExtensionProperties),
+    PROC(xrCreateInstance),
+    PROC(xrDestroyInstance),
+    PROC(xrGetInstanceProperties),
+    PROC(xrResultToString),
+    PROC(xrPollEvent),
+    PROC(xrStringToPath),
+    PROC(xrPathToString),
+    PROC(xrGetSystem),
+    PROC(xrGetSystemProperties),
+    PROC(xrEnumerateViewConfigurations),
+    PROC(xrGetViewConfigurationProperties),
+    PROC(xrEnumerateViewConfigurationViews),
+    PROC(xrEnumerateEnvironmentBlendModes),
+    PROC(xrGetOpenGLGraphicsRequirementsKHR),
+    PROC(xrCreateSession),
+    PROC(xrDestroySession),
+    PROC(xrBeginSession),
+    PROC(xrEndSession),
+    PROC(xrRequestExitSession),
+    PROC(xrEnumerateReferenceSpaces),
+    PROC(xrCreateReferenceSpace),
+    PROC(xrCreateActionSpace),
+    PROC(xrLocateSpace),
+    PROC(xrDestroySpace),
+    PROC(xrCreateActionSet),
+    PROC(xrDestroyActionSet),
+    PROC(xrCreateAction),
+    PROC(xrDestroyAction),
+    PROC(xrSuggestInteractionProfileBindings),
+    PROC(xrAttachSessionActionSets),
+    PROC(xrSyncActions),
+    PROC(xrEnumerateSwapchainFormats),
+    PROC(xrCreateSwapchain),
+    PROC(xrDestroySwapchain),
+    PROC(xrEnumerateSwapchainImages),
+    PROC(xrAcquireSwapchainImage),
+    PROC(xrWaitSwapchainImage),
+    PROC(xrReleaseSwapchainImage),
+    PROC(xrWaitFrame),
+    PROC(xrBeginFrame),
+    PROC(xrEndFrame),
+    PROC(xrLocateViews),
+    PROC(xrGetVisibilityMaskKHR),
+};
+
+#undef PROC
+
+static XrResult XRAPI_CALL stub_xrGetInstanceProcAddr(XrInstance instance, const char* name, PFN_xrVoidFunction* function)
+{
+    if (!strcmp(name, "xrGetInstanceProcAddr"))
+    {
+        *function = (PFN_xrVoidFunction)stub_xrGetInstanceProcAddr;
+        return XR_SUCCESS;
+    }
+
+    // only these may be queried without an instance.
+    if (instance == XR_NULL_HANDLE && strcmp(name, "xrEnumerateInstanceExtensionProperties") &&
+        strcmp(name, "xrEnumerateApiLayerProperties") && strcmp(name, "xrCreateInstance"))
+    {
+        *function = NULL;
+        return XR_ERROR_HANDLE_INVALID;
+    }
+
+    for (auto& proc : PROCS)
+    {
+        if (!strcmp(name, proc.name))
+        {
+            *function = proc.func;
+            return XR_SUCCESS;
+        }
+    }
+    *function = NULL;
+    return XR_ERROR_FUNCTION_UNSUPPORTED;
+}
+
+RUNTIME_EXPORT XrResult XRAPI_CALL xrNegotiateLoaderRuntimeInterface(const XrNegotiateLoaderInfo* loaderInfo,
+                                                                     XrNegotiateRuntimeRequest* runtimeRequest)
+{
+    if (!loaderInfo || !runtimeRequest ||
+        loaderInfo->structType != XR_LOADER_INTERFACE_STRUCT_LOADER_INFO ||
+        loaderInfo->structVersion != XR_LOADER_INFO_STRUCT_VERSION ||
+        loaderInfo->structSize != sizeof(XrNegotiateLoaderInfo) ||
+        runtimeRequest->structType != XR_LOADER_INTERFACE_STRUCT_RUNTIME_REQUEST ||
+        runtimeRequest->structVersion != XR_RUNTIME_INFO_STRUCT_VERSION ||
+        runtimeRequest->structSize != sizeof(XrNegotiateRuntimeRequest) ||
+        loaderInfo->minInterfaceVersion > XR_CURRENT_LOADER_RUNTIME_VERSION ||
+        loaderInfo->maxInterfaceVersion < XR_CURRENT_LOADER_RUNTIME_VERSION)
+    {
+        return XR_ERROR_INITIALIZATION_FAILED;
+    }
+
+    runtimeRequest->runtimeInterfaceVersion = XR_CURRENT_LOADER_RUNTIME_VERSION;
+    runtimeRequest->runtimeApiVersion = XR_CURRENT_API_VERSION;
+    runtimeRequest->getInstanceProcAddr = stub_xrGetInstanceProcAddr;
+    return XR_SUCCESS;
+}
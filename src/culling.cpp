@@ -0,0 +1,340 @@
+// view frustum culling
+
+#include "culling.h"
+#include "vec4.h"
+#include "xrmath.h"
+
+#include <algorithm>
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+static void SetPlane(CullFrustum& frustum, uint32_t i, const float* rotation, const XrVector3f& position,
+                     float x, float y, float z, float d)
+{
+    // normalize, then take the normal to world space and move the plane with the view.
+    const float invLength = 1.0f / sqrtf(x * x + y * y + z * z);
+    const float nx = (rotation[0] * x + rotation[4] * y + rotation[8] * z) * invLength;
+    const float ny = (rotation[1] * x + rotation[5] * y + rotation[9] * z) * invLength;
+    const float nz = (rotation[2] * x + rotation[6] * y + rotation[10] * z) * invLength;
+    frustum.nx[i] = nx;
+    frustum.ny[i] = ny;
+    frustum.nz[i] = nz;
+    frustum.d[i] = d * invLength - (nx * position.x + ny * position.y + nz * position.z);
+}
+
+void CullFrustumFromView(CullFrustum& frustum, const XrPosef& pose, const XrFovf& fov, float nearZ, float farZ)
+{
+    const float tanLeft = tanf(fov.angleLeft);
+    const float tanRight = tanf(fov.angleRight);
+    const float tanDown = tanf(fov.angleDown);
+    const float tanUp = tanf(fov.angleUp);
+    float poseMat[16];
+    XrMathInitPoseMat(poseMat, pose);
+
+    // in view space, looking down -z.
+    SetPlane(frustum, 0, poseMat, pose.position, 1.0f, 0.0f, tanLeft, 0.0f);
+    SetPlane(frustum, 1, poseMat, pose.position, -1.0f, 0.0f, -tanRight, 0.0f);
+    SetPlane(frustum, 2, poseMat, pose.position, 0.0f, 1.0f, tanDown, 0.0f);
+    SetPlane(frustum, 3, poseMat, pose.position, 0.0f, -1.0f, -tanUp, 0.0f);
+    SetPlane(frustum, 4, poseMat, pose.position, 0.0f, 0.0f, -1.0f, -nearZ);
+    SetPlane(frustum, 5, poseMat, pose.position, 0.0f, 0.0f, 1.0f, farZ);
+    for (uint32_t i = CULL_FRUSTUM_PLANES; i < 8; i++)
+    {
+        frustum.nx[i] = frustum.ny[i] = frustum.nz[i] = 0.0f;
+        frustum.d[i] = 1.0f;
+    }
+
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        const float z = i < 4 ? nearZ : farZ;
+        const float x = (i == 0 || i == 3 || i == 4 || i == 7 ? tanLeft : tanRight) * z;
+        const float y = (i % 4 < 2 ? tanDown : tanUp) * z;
+        for (int j = 0; j < 3; j++)
+        {
+            frustum.corners[i][j] = poseMat[j] * x + poseMat[4 + j] * y - poseMat[8 + j] * z + poseMat[12 + j];
+        }
+    }
+}
+
+void CullFrustumUnion(CullFrustum& result, const CullFrustum* frusta, uint32_t count)
+{
+    assert(count > 0);
+    result = frusta[0];
+    for (uint32_t plane = 0; plane < CULL_FRUSTUM_PLANES; plane++)
+    {
+        // of the views' planes on this side, the one that needs moving out the least to contain every view.
+        float bestMove = INFINITY;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const CullFrustum& f = frusta[i];
+            float move = 0.0f;
+            for (uint32_t j = 0; j < count; j++)
+            {
+                for (uint32_t k = 0; j != i && k < 8; k++)
+                {
+                    const float* c = frusta[j].corners[k];
+                    const float dist = f.nx[plane] * c[0] + f.ny[plane] * c[1] + f.nz[plane] * c[2] + f.d[plane];
+                    move = std::max(move, -dist);
+                }
+            }
+            if (move < bestMove)
+            {
+                bestMove = move;
+                result.nx[plane] = f.nx[plane];
+                result.ny[plane] = f.ny[plane];
+                result.nz[plane] = f.nz[plane];
+                result.d[plane] = f.d[plane] + move;
+            }
+        }
+    }
+}
+
+void CullTransformBox(CullBox& result, const CullBox& box, const float* mat)
+{
+    // each column adds its smaller and larger products to the translation, Arvo's method.
+    for (int i = 0; i < 3; i++)
+    {
+        result.min[i] = result.max[i] = mat[12 + i];
+        for (int j = 0; j < 3; j++)
+        {
+            const float a = mat[j * 4 + i] * box.min[j];
+            const float b = mat[j * 4 + i] * box.max[j];
+            result.min[i] += std::min(a, b);
+            result.max[i] += std::max(a, b);
+        }
+    }
+    result.min[3] = result.max[3] = 0.0f;
+}
+
+//
+// hierarchy
+//
+
+struct BuildItem
+{
+    uint32_t object;
+    float centroid[3];
+};
+
+static void GrowBounds(CullBvhNode& node, uint32_t child, const CullBox& box)
+{
+    node.minX[child] = std::min(node.minX[child], box.min[0]);
+    node.minY[child] = std::min(node.minY[child], box.min[1]);
+    node.minZ[child] = std::min(node.minZ[child], box.min[2]);
+    node.maxX[child] = std::max(node.maxX[child], box.max[0]);
+    node.maxY[child] = std::max(node.maxY[child], box.max[1]);
+    node.maxZ[child] = std::max(node.maxZ[child], box.max[2]);
+}
+
+// sorts items[first, first + count) so its first half is below the median along the centroids' longest axis.
+static void SplitAtMedian(std::vector<BuildItem>& items, uint32_t first, uint32_t count)
+{
+    float lo[3] = {INFINITY, INFINITY, INFINITY};
+    float hi[3] = {-INFINITY, -INFINITY, -INFINITY};
+    for (uint32_t i = first; i < first + count; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            lo[j] = std::min(lo[j], items[i].centroid[j]);
+            hi[j] = std::max(hi[j], items[i].centroid[j]);
+        }
+    }
+    const int axis = hi[0] - lo[0] >= hi[1] - lo[1] ? (hi[0] - lo[0] >= hi[2] - lo[2] ? 0 : 2)
+                                                     : (hi[1] - lo[1] >= hi[2] - lo[2] ? 1 : 2);
+    std::nth_element(items.begin() + first, items.begin() + first + count / 2, items.begin() + first + count,
+                     [axis](const BuildItem& a, const BuildItem& b) { return a.centroid[axis] < b.centroid[axis]; });
+}
+
+static int32_t BuildNode(CullBvh& bvh, std::vector<BuildItem>& items, uint32_t first, uint32_t count)
+{
+    const int32_t nodeIndex = (int32_t)bvh.nodes.size();
+    bvh.nodes.emplace_back();
+
+    // up to four groups of objects, one per child, from two median splits.
+    uint32_t groupFirst[4];
+    uint32_t groupCount[4];
+    uint32_t groups = 0;
+    if (count <= 4)
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            groupFirst[groups] = first + i;
+            groupCount[groups++] = 1;
+        }
+    }
+    else
+    {
+        SplitAtMedian(items, first, count);
+        const uint32_t halfCounts[2] = {count / 2, count - count / 2};
+        uint32_t halfFirst = first;
+        for (uint32_t half = 0; half < 2; half++)
+        {
+            SplitAtMedian(items, halfFirst, halfCounts[half]);
+            groupFirst[groups] = halfFirst;
+            groupCount[groups++] = halfCounts[half] / 2;
+            groupFirst[groups] = halfFirst + halfCounts[half] / 2;
+            groupCount[groups++] = halfCounts[half] - halfCounts[half] / 2;
+            halfFirst += halfCounts[half];
+        }
+    }
+
+    // children are built first, bvh.nodes may be reallocated while they are.
+    int32_t children[4];
+    for (uint32_t i = 0; i < groups; i++)
+    {
+        children[i] = groupCount[i] == 1 ? ~(int32_t)items[groupFirst[i]].object
+                                         : BuildNode(bvh, items, groupFirst[i], groupCount[i]);
+    }
+
+    CullBvhNode& node = bvh.nodes[nodeIndex];
+    node.childCount = groups;
+    node.firstObject = first;
+    node.objectCount = count;
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        node.children[i] = i < groups ? children[i] : 0;
+        node.minX[i] = node.minY[i] = node.minZ[i] = INFINITY;
+        node.maxX[i] = node.maxY[i] = node.maxZ[i] = -INFINITY;
+        for (uint32_t j = 0; i < groups && j < groupCount[i]; j++)
+        {
+            GrowBounds(node, i, bvh.boxes[items[groupFirst[i] + j].object]);
+        }
+    }
+    return nodeIndex;
+}
+
+void CullBuildBvh(CullBvh& bvh, const CullBox* boxes, uint32_t count)
+{
+    bvh.boxes.assign(boxes, boxes + count);
+    bvh.nodes.clear();
+    bvh.objectOrder.clear();
+    if (count == 0)
+    {
+        return;
+    }
+
+    std::vector<BuildItem> items(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        items[i].object = i;
+        for (int j = 0; j < 3; j++)
+        {
+            items[i].centroid[j] = 0.5f * (boxes[i].min[j] + boxes[i].max[j]);
+        }
+    }
+    BuildNode(bvh, items, 0, count);
+
+    // every node's objects are contiguous in the final order.
+    bvh.objectOrder.resize(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        bvh.objectOrder[i] = items[i].object;
+    }
+}
+
+//
+// kernels
+//
+
+// tests the node's four children against the frustum's planes at once, and returns a bit per child that is
+// entirely outside one of them, and in inside, a bit per child that is entirely inside all of them.
+static inline uint32_t TestChildren(const CullBvhNode& node, const CullFrustum& frustum, uint32_t& inside)
+{
+    const Vec4 zero = Splat(0.0f);
+    const Vec4 minX = Load(node.minX), minY = Load(node.minY), minZ = Load(node.minZ);
+    const Vec4 maxX = Load(node.maxX), maxY = Load(node.maxY), maxZ = Load(node.maxZ);
+    Mask4 outside = Less(Splat(1.0f), zero);
+    Mask4 crossing = outside;
+    for (uint32_t i = 0; i < CULL_FRUSTUM_PLANES; i++)
+    {
+        // the corners furthest along the plane's normal, and furthest against it.
+        const Vec4 nx = Splat(frustum.nx[i]), ny = Splat(frustum.ny[i]), nz = Splat(frustum.nz[i]);
+        const Vec4 d = Splat(frustum.d[i]);
+        const bool px = frustum.nx[i] >= 0.0f, py = frustum.ny[i] >= 0.0f, pz = frustum.nz[i] >= 0.0f;
+        const Vec4 farDist = MulAdd(px ? maxX : minX, nx, MulAdd(py ? maxY : minY, ny, MulAdd(pz ? maxZ : minZ, nz, d)));
+        const Vec4 nearDist = MulAdd(px ? minX : maxX, nx, MulAdd(py ? minY : maxY, ny, MulAdd(pz ? minZ : maxZ, nz, d)));
+        outside = Or(outside, Less(farDist, zero));
+        crossing = Or(crossing, Less(nearDist, zero));
+    }
+    inside = ~MoveMask(crossing) & 0xF;
+    return MoveMask(outside);
+}
+
+// tests one box against four planes at a time, true if it is entirely outside any of them.
+static inline bool BoxOutside(const CullBox& box, const CullFrustum& frustum)
+{
+    const Vec4 zero = Splat(0.0f);
+    const Vec4 minX = Splat(box.min[0]), minY = Splat(box.min[1]), minZ = Splat(box.min[2]);
+    const Vec4 maxX = Splat(box.max[0]), maxY = Splat(box.max[1]), maxZ = Splat(box.max[2]);
+    for (uint32_t i = 0; i < 8; i += 4)
+    {
+        const Vec4 nx = Load(frustum.nx + i), ny = Load(frustum.ny + i), nz = Load(frustum.nz + i);
+        const Vec4 x = Select(Less(nx, zero), minX, maxX);
+        const Vec4 y = Select(Less(ny, zero), minY, maxY);
+        const Vec4 z = Select(Less(nz, zero), minZ, maxZ);
+        const Vec4 dist = MulAdd(x, nx, MulAdd(y, ny, MulAdd(z, nz, Load(frustum.d + i))));
+        if (MoveMask(Less(dist, zero)))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void CullBvhObjects(const CullBvh& bvh, const CullFrustum& frustum, std::vector<uint32_t>& visible, uint32_t& tested)
+{
+    if (bvh.nodes.empty())
+    {
+        return;
+    }
+
+    // depth first, the hierarchy is balanced so it is never deeper than about log2(objects) / 2.
+    int32_t stack[128];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0)
+    {
+        const CullBvhNode& node = bvh.nodes[stack[--stackSize]];
+        uint32_t inside;
+        const uint32_t outside = TestChildren(node, frustum, inside);
+        tested += node.childCount;
+        for (uint32_t i = 0; i < node.childCount; i++)
+        {
+            const int32_t child = node.children[i];
+            if (outside & (1u << i))
+            {
+                continue;
+            }
+            if (child < 0)
+            {
+                visible.push_back((uint32_t)~child);
+            }
+            else if (inside & (1u << i))
+            {
+                const CullBvhNode& childNode = bvh.nodes[child];
+                visible.insert(visible.end(), bvh.objectOrder.begin() + childNode.firstObject,
+                               bvh.objectOrder.begin() + childNode.firstObject + childNode.objectCount);
+            }
+            else
+            {
+                assert(stackSize < sizeof(stack) / sizeof(stack[0]));
+                stack[stackSize++] = child;
+            }
+        }
+    }
+}
+
+void CullObjects(const CullBvh& bvh, const CullFrustum& frustum, const std::vector<uint32_t>& candidates,
+                 std::vector<uint32_t>& visible, uint32_t& tested)
+{
+    tested += (uint32_t)candidates.size();
+    for (uint32_t object : candidates)
+    {
+        if (!BoxOutside(bvh.boxes[object], frustum))
+        {
+            visible.push_back(object);
+        }
+    }
+}
@@ -0,0 +1,75 @@
+// view frustum culling
+//
+// Objects are culled by their axis aligned bounding boxes, kept in a bounding volume hierarchy with four children
+// per node.  Each node stores its children's bounds as x, y and z arrays, so one plane is tested against all four
+// children with a single 4-wide vector operation.  Nodes entirely inside the frustum are accepted along with
+// everything below them, without testing further.
+//
+// Frusta are planes in world space.  The views of a frame are culled together once, through the hierarchy,
+// against a frustum that contains all of them, and the objects that pass are then tested against each view
+// separately, one box against four planes at a time.
+
+#pragma once
+
+#include <openxr/openxr.h>
+
+#include <vector>
+#include <cstdint>
+
+// planes as arrays of their components, n . p + d >= 0 inside.  The last two always pass.
+static const uint32_t CULL_FRUSTUM_PLANES = 6;
+struct CullFrustum
+{
+    float nx[8];
+    float ny[8];
+    float nz[8];
+    float d[8];
+    float corners[8][3];    // near then far corners, for building frusta around several views
+};
+
+struct CullBox
+{
+    float min[4];   // w is unused
+    float max[4];
+};
+
+struct CullBvhNode
+{
+    float minX[4];
+    float minY[4];
+    float minZ[4];
+    float maxX[4];
+    float maxY[4];
+    float maxZ[4];
+    int32_t children[4];    // index of a child node, or ~index of an object
+    uint32_t childCount;
+    uint32_t firstObject;   // the node's objects are objectOrder[firstObject, firstObject + objectCount)
+    uint32_t objectCount;
+};
+
+struct CullBvh
+{
+    std::vector<CullBox> boxes;
+    std::vector<CullBvhNode> nodes;         // nodes[0] is the root
+    std::vector<uint32_t> objectOrder;      // objects in the order the hierarchy visits them
+};
+
+// the frustum of a view located by xrLocateViews.
+void CullFrustumFromView(CullFrustum& frustum, const XrPosef& pose, const XrFovf& fov, float nearZ, float farZ);
+
+// a frustum containing every one of count frusta, made of their planes, each moved out as far as it needs to be.
+void CullFrustumUnion(CullFrustum& result, const CullFrustum* frusta, uint32_t count);
+
+// the box around box transformed by a column major matrix.
+void CullTransformBox(CullBox& result, const CullBox& box, const float* mat);
+
+// builds the hierarchy over count boxes, splitting objects at the median along the longest axis.
+void CullBuildBvh(CullBvh& bvh, const CullBox* boxes, uint32_t count);
+
+// appends the objects that may be inside frustum to visible.
+// tested is increased by the number of boxes tested.
+void CullBvhObjects(const CullBvh& bvh, const CullFrustum& frustum, std::vector<uint32_t>& visible, uint32_t& tested);
+
+// appends the objects of candidates that may be inside frustum to visible.
+void CullObjects(const CullBvh& bvh, const CullFrustum& frustum, const std::vector<uint32_t>& candidates,
+                 std::vector<uint32_t>& visible, uint32_t& tested);
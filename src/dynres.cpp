@@ -0,0 +1,94 @@
+// dynamic resolution
+
+#include "dynres.h"
+
+#include "gputimer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+// frames are aimed at this fraction of the display period, leaving the rest for the compositor.
+static const double TARGET_FRACTION = 0.8;
+
+// the scale is lowered after DECREASE_FRAMES frames over the high fraction, and raised after
+// INCREASE_FRAMES frames under the low fraction.
+static const double HIGH_FRACTION = 0.9;
+static const double LOW_FRACTION = 0.65;
+static const uint32_t DECREASE_FRAMES = 3;
+static const uint32_t INCREASE_FRAMES = 90;
+
+// largest change in one step, down and up.
+static const float MAX_DECREASE = 0.8f;
+static const float MAX_INCREASE = 1.05f;
+
+// gpu times arrive GPU_TIMER_LATENCY frames late, so don't judge a new scale until it shows up in them.
+static const uint32_t SETTLE_FRAMES = GPU_TIMER_LATENCY + 2;
+
+// weight of each new frame in the smoothed frame time.
+static const double SMOOTHING = 0.2;
+
+static float s_minScale = 1.0f;
+static float s_maxScale = 1.0f;
+static float s_scale = 1.0f;
+static double s_frameTime = 0.0;
+static uint32_t s_overFrames = 0;
+static uint32_t s_underFrames = 0;
+static uint32_t s_settleFrames = 0;
+
+void DynResInit(float minScale, float maxScale)
+{
+    s_minScale = minScale;
+    s_maxScale = std::max(minScale, maxScale);
+    s_scale = std::min(std::max(1.0f, s_minScale), s_maxScale);
+    s_frameTime = 0.0;
+    s_overFrames = 0;
+    s_underFrames = 0;
+    s_settleFrames = SETTLE_FRAMES;
+    printf("dynamic resolution: scale %.2f, between %.2f and %.2f\n", s_scale, s_minScale, s_maxScale);
+}
+
+float DynResUpdate(uint64_t gpuTime, uint64_t cpuTime, uint64_t displayPeriod)
+{
+    // whichever of the cpu and gpu is the bottleneck sets the frame time.
+    const double frameTime = (double)std::max(gpuTime, cpuTime);
+    if (displayPeriod == 0 || frameTime == 0.0)
+    {
+        return s_scale;
+    }
+    s_frameTime = s_frameTime == 0.0 ? frameTime : s_frameTime + (frameTime - s_frameTime) * SMOOTHING;
+
+    if (s_settleFrames > 0)
+    {
+        s_settleFrames--;
+        return s_scale;
+    }
+
+    const double period = (double)displayPeriod;
+    s_overFrames = s_frameTime > HIGH_FRACTION * period ? s_overFrames + 1 : 0;
+    s_underFrames = s_frameTime < LOW_FRACTION * period ? s_underFrames + 1 : 0;
+    if (s_overFrames < DECREASE_FRAMES && s_underFrames < INCREASE_FRAMES)
+    {
+        return s_scale;
+    }
+
+    // fill cost goes with the number of pixels, the square of the scale.
+    float factor = (float)sqrt(TARGET_FRACTION * period / s_frameTime);
+    factor = std::min(std::max(factor, MAX_DECREASE), MAX_INCREASE);
+    const float scale = std::min(std::max(s_scale * factor, s_minScale), s_maxScale);
+    if (fabsf(scale - s_scale) >= 0.01f)
+    {
+        printf("dynamic resolution: scale %.2f -> %.2f, frame time %.2f ms, display period %.2f ms\n",
+               s_scale, scale, s_frameTime / 1.0e6, period / 1.0e6);
+        s_scale = scale;
+        s_settleFrames = SETTLE_FRAMES;
+    }
+    s_overFrames = 0;
+    s_underFrames = 0;
+    return s_scale;
+}
+
+float DynResScale()
+{
+    return s_scale;
+}
@@ -0,0 +1,19 @@
+// dynamic resolution
+//
+// Picks the fraction of the recommended view size to render at, from how long recent frames took against
+// the display period.  The scale drops quickly once frames run over budget, and only creeps back up after
+// frames have been comfortably under budget for a while, so it doesn't oscillate around the limit.  After
+// each change it waits for the new scale to show up in the (late) gpu timings before changing it again.
+
+#pragma once
+
+#include <cstdint>
+
+// minScale and maxScale bound the scale, which starts at 1, the recommended size.
+void DynResInit(float minScale, float maxScale);
+
+// feeds in the cost of the last frame, gpu time as it is read back and cpu time of the render thread,
+// against the runtime's predictedDisplayPeriod, all in nanoseconds.  returns the scale for the next frame.
+float DynResUpdate(uint64_t gpuTime, uint64_t cpuTime, uint64_t displayPeriod);
+
+float DynResScale();
@@ -0,0 +1,159 @@
+// frame pacing thread
+
+#include "framepacer.h"
+#include "framestats.h"
+#include "spscqueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+// only one or two frames are ever in flight, since xrWaitFrame blocks until the previous frame is begun.
+static SpscQueue<PacedFrame, 4> s_queue;
+static std::thread s_thread;
+static std::atomic<bool> s_stopRequested(false);
+static std::atomic<bool> s_exited(true);
+static XrSession s_session = XR_NULL_HANDLE;
+
+static void PacingThread()
+{
+    while (!s_stopRequested.load(std::memory_order_acquire))
+    {
+        PacedFrame frame;
+        frame.frameState.type = XR_TYPE_FRAME_STATE;
+        frame.frameState.next = NULL;
+
+        XrFrameWaitInfo fwi;
+        fwi.type = XR_TYPE_FRAME_WAIT_INFO;
+        fwi.next = NULL;
+
+        frame.waitStart = FrameStatsNow();
+        frame.result = xrWaitFrame(s_session, &fwi, &frame.frameState);
+        frame.waitEnd = FrameStatsNow();
+
+        while (!s_queue.Push(frame))
+        {
+            std::this_thread::yield();
+        }
+
+        if (XR_FAILED(frame.result))
+        {
+            break;
+        }
+    }
+    s_exited.store(true, std::memory_order_release);
+}
+
+bool FramePacerStart(XrSession session)
+{
+    if (!s_exited.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+    // a thread that stopped by itself after xrWaitFrame failed still has to be joined before it's replaced.
+    if (s_thread.joinable())
+    {
+        s_thread.join();
+    }
+    s_session = session;
+    s_stopRequested.store(false, std::memory_order_release);
+    s_exited.store(false, std::memory_order_release);
+    s_thread = std::thread(PacingThread);
+    return true;
+}
+
+bool FramePacerRunning()
+{
+    return s_thread.joinable();
+}
+
+bool FramePacerPop(PacedFrame& frame)
+{
+    // spin briefly, then back off, the next frame is usually less than a frame period away.
+    uint32_t spins = 0;
+    while (!s_queue.Pop(frame))
+    {
+        if (s_exited.load(std::memory_order_acquire))
+        {
+            // the thread may have pushed its last frame just before exiting.
+            return s_queue.Pop(frame);
+        }
+        if (++spins < 64)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+    return true;
+}
+
+// begins and ends a frame the pacing thread waited for but that will not be rendered.
+static void DiscardFrame(const PacedFrame& frame)
+{
+    if (XR_FAILED(frame.result))
+    {
+        return;
+    }
+
+    XrFrameBeginInfo fbi;
+    fbi.type = XR_TYPE_FRAME_BEGIN_INFO;
+    fbi.next = NULL;
+    XrResult result = xrBeginFrame(s_session, &fbi);
+    if (XR_FAILED(result))
+    {
+        printf("frame pacer: xrBeginFrame failed while draining, %d\n", (int)result);
+        return;
+    }
+
+    XrFrameEndInfo fei;
+    fei.type = XR_TYPE_FRAME_END_INFO;
+    fei.next = NULL;
+    fei.displayTime = frame.frameState.predictedDisplayTime;
+    fei.environmentBlendMode = XR_ENVIRONMENT_BLEND_MODE_OPAQUE;
+    fei.layerCount = 0;
+    fei.layers = NULL;
+    result = xrEndFrame(s_session, &fei);
+    if (XR_FAILED(result))
+    {
+        printf("frame pacer: xrEndFrame failed while draining, %d\n", (int)result);
+    }
+}
+
+void FramePacerStop()
+{
+    if (!s_thread.joinable())
+    {
+        return;
+    }
+
+    // the thread may be blocked in xrWaitFrame until a frame it already queued is begun,
+    // so keep draining until it notices the request and exits.
+    s_stopRequested.store(true, std::memory_order_release);
+    PacedFrame frame;
+    while (!s_exited.load(std::memory_order_acquire))
+    {
+        if (s_queue.Pop(frame))
+        {
+            DiscardFrame(frame);
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+    s_thread.join();
+
+    while (s_queue.Pop(frame))
+    {
+        DiscardFrame(frame);
+    }
+}
+
+FramePacerScope::~FramePacerScope()
+{
+    FramePacerStop();
+}
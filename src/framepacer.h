@@ -0,0 +1,38 @@
+// frame pacing thread
+//
+// Runs xrWaitFrame on its own thread, so the wait for frame N+1 overlaps the render thread submitting
+// frame N.  Each frame state is handed to the render thread through a lock-free queue, which then calls
+// xrBeginFrame, renders and calls xrEndFrame as usual.  The runtime keeps the pacing thread from running
+// ahead, since xrWaitFrame doesn't return until the previous frame has been begun.
+
+#pragma once
+
+#include <openxr/openxr.h>
+
+#include <cstdint>
+
+struct PacedFrame
+{
+    XrResult result;            // of xrWaitFrame, the pacing thread stops after a failure
+    XrFrameState frameState;
+    uint64_t waitStart;         // FrameStatsNow() around xrWaitFrame
+    uint64_t waitEnd;
+};
+
+// starts the pacing thread, call after xrBeginSession.
+bool FramePacerStart(XrSession session);
+
+bool FramePacerRunning();
+
+// waits for the next frame from the pacing thread, returns false if it has stopped and there are none left.
+bool FramePacerPop(PacedFrame& frame);
+
+// stops the pacing thread, call between frames and before xrEndSession.  Frames it has already waited
+// for are begun and ended without layers, so the runtime's frame loop is left balanced.
+void FramePacerStop();
+
+// stops the pacing thread when it goes out of scope, so returning early from the frame loop still joins it.
+struct FramePacerScope
+{
+    ~FramePacerScope();
+};
@@ -0,0 +1,413 @@
+// per-phase frame timing
+
+#include "framestats.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+bool g_frameStatsEnabled = false;
+
+static const char* s_phaseNames[NUM_FRAME_PHASES] = {
+    "frame",
+    "syncInput",
+    "waitFrame",
+    "dequeueFrame",
+    "beginFrame",
+    "locateViews",
+    "acquireImage",
+    "waitImage",
+    "renderView",
+    "releaseImage",
+    "endFrame",
+    "poseAge",
+    "gpuView0",
+    "gpuView1",
+    "gpuRender"
+};
+
+static const char* s_counterNames[NUM_FRAME_COUNTERS] = {
+    "cullTested",
+    "cullVisible",
+    "drawsSaved",
+    "drawCalls",
+    "fenceWaits"
+};
+
+// log-linear histogram, 32 linear sub-buckets per power of two of 100ns units, about 3% resolution.
+// 640 buckets covers durations up to several seconds.
+static const uint32_t HISTOGRAM_SUB_BUCKETS = 32;
+static const uint32_t HISTOGRAM_BUCKETS = 640;
+static const uint64_t HISTOGRAM_UNIT_NS = 100;
+
+// number of recent frames kept, must be a power of two.
+static const uint32_t RING_SIZE = 1024;
+
+struct FrameRecord
+{
+    uint64_t frameIndex;
+    uint32_t phaseMask;    // bit per phase that ran this frame
+    uint64_t start[NUM_FRAME_PHASES];  // 0 for phases that have no cpu timestamp
+    uint64_t duration[NUM_FRAME_PHASES];
+    uint32_t counterMask;   // bit per counter added to this frame
+    uint64_t counts[NUM_FRAME_COUNTERS];
+};
+
+struct PhaseHistogram
+{
+    uint32_t buckets[HISTOGRAM_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+};
+
+struct CounterTotals
+{
+    uint64_t frames;
+    uint64_t sum;
+    uint64_t max;
+};
+
+static std::string s_outputPath;
+static FrameRecord s_ring[RING_SIZE];
+static PhaseHistogram s_histograms[NUM_FRAME_PHASES];
+static CounterTotals s_counterTotals[NUM_FRAME_COUNTERS];
+static uint64_t s_frameCount = 0;
+static bool s_inFrame = false;
+static volatile sig_atomic_t s_dumpRequested = 0;
+
+static uint32_t BucketForDuration(uint64_t ns)
+{
+    uint64_t v = ns / HISTOGRAM_UNIT_NS;
+    if (v < 2 * HISTOGRAM_SUB_BUCKETS)
+    {
+        return (uint32_t)v;
+    }
+
+    uint32_t msb = 0;
+    while ((v >> msb) > 1)
+    {
+        msb++;
+    }
+    const uint32_t shift = msb - 5;
+    const uint32_t bucket = (shift + 1) * HISTOGRAM_SUB_BUCKETS + (uint32_t)((v >> shift) - HISTOGRAM_SUB_BUCKETS);
+    return bucket < HISTOGRAM_BUCKETS ? bucket : HISTOGRAM_BUCKETS - 1;
+}
+
+// midpoint of the bucket in nanoseconds
+static double BucketValue(uint32_t bucket)
+{
+    if (bucket < 2 * HISTOGRAM_SUB_BUCKETS)
+    {
+        return (bucket + 0.5) * HISTOGRAM_UNIT_NS;
+    }
+    const uint32_t shift = bucket / HISTOGRAM_SUB_BUCKETS - 1;
+    const uint64_t low = (uint64_t)(HISTOGRAM_SUB_BUCKETS + bucket % HISTOGRAM_SUB_BUCKETS) << shift;
+    const uint64_t width = (uint64_t)1 << shift;
+    return (low + 0.5 * width) * HISTOGRAM_UNIT_NS;
+}
+
+static double Percentile(const PhaseHistogram& h, double p)
+{
+    if (h.count == 0)
+    {
+        return 0.0;
+    }
+    const uint64_t target = (uint64_t)(p * (double)h.count + 0.5);
+    uint64_t cumulative = 0;
+    for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        cumulative += h.buckets[i];
+        if (cumulative >= target && cumulative > 0)
+        {
+            const double value = BucketValue(i);
+            return value < (double)h.max ? value : (double)h.max;
+        }
+    }
+    return (double)h.max;
+}
+
+#if defined(SIGUSR1)
+static void DumpSignalHandler(int)
+{
+    s_dumpRequested = 1;
+}
+#endif
+
+bool FrameStatsInit(const char* outputPath)
+{
+    s_outputPath = outputPath;
+    memset(s_ring, 0, sizeof(s_ring));
+    memset(s_histograms, 0, sizeof(s_histograms));
+    memset(s_counterTotals, 0, sizeof(s_counterTotals));
+    s_frameCount = 0;
+    s_inFrame = false;
+
+#if defined(SIGUSR1)
+    signal(SIGUSR1, DumpSignalHandler);
+#endif
+
+    g_frameStatsEnabled = true;
+    return true;
+}
+
+uint64_t FrameStatsClock()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void FrameStatsBeginFrame()
+{
+    if (!g_frameStatsEnabled)
+    {
+        return;
+    }
+    FrameRecord& record = s_ring[s_frameCount & (RING_SIZE - 1)];
+    memset(&record, 0, sizeof(record));
+    record.frameIndex = s_frameCount;
+    s_inFrame = true;
+}
+
+void FrameStatsAddPhase(FramePhase phase, uint64_t start, uint64_t end)
+{
+    if (!g_frameStatsEnabled || !s_inFrame)
+    {
+        return;
+    }
+    FrameRecord& record = s_ring[s_frameCount & (RING_SIZE - 1)];
+    if (!(record.phaseMask & (1u << phase)))
+    {
+        record.phaseMask |= 1u << phase;
+        record.start[phase] = start;
+    }
+    record.duration[phase] += end - start;
+}
+
+void FrameStatsAddCount(FrameCounter counter, uint64_t count)
+{
+    if (!g_frameStatsEnabled || !s_inFrame)
+    {
+        return;
+    }
+    FrameRecord& record = s_ring[s_frameCount & (RING_SIZE - 1)];
+    record.counterMask |= 1u << counter;
+    record.counts[counter] += count;
+}
+
+static void AddToHistogram(FramePhase phase, uint64_t duration)
+{
+    PhaseHistogram& h = s_histograms[phase];
+    h.buckets[BucketForDuration(duration)]++;
+    h.count++;
+    h.sum += duration;
+    if (duration > h.max)
+    {
+        h.max = duration;
+    }
+}
+
+uint64_t FrameStatsCurrentFrame()
+{
+    return s_frameCount;
+}
+
+void FrameStatsAddLatePhase(uint64_t frameIndex, FramePhase phase, uint64_t duration)
+{
+    if (!g_frameStatsEnabled)
+    {
+        return;
+    }
+    FrameRecord& record = s_ring[frameIndex & (RING_SIZE - 1)];
+    if (record.frameIndex == frameIndex && frameIndex < s_frameCount)
+    {
+        record.phaseMask |= 1u << phase;
+        record.duration[phase] += duration;
+    }
+    AddToHistogram(phase, duration);
+}
+
+void FrameStatsEndFrame()
+{
+    if (!g_frameStatsEnabled || !s_inFrame)
+    {
+        return;
+    }
+    const FrameRecord& record = s_ring[s_frameCount & (RING_SIZE - 1)];
+    for (int i = 0; i < NUM_FRAME_PHASES; i++)
+    {
+        // phases that didn't run this frame, (e.g. no rendering while not visible) are not counted.
+        if (record.phaseMask & (1u << i))
+        {
+            AddToHistogram((FramePhase)i, record.duration[i]);
+        }
+    }
+    for (int i = 0; i < NUM_FRAME_COUNTERS; i++)
+    {
+        if (record.counterMask & (1u << i))
+        {
+            CounterTotals& totals = s_counterTotals[i];
+            totals.frames++;
+            totals.sum += record.counts[i];
+            totals.max = record.counts[i] > totals.max ? record.counts[i] : totals.max;
+        }
+    }
+    s_frameCount++;
+    s_inFrame = false;
+}
+
+static void PrintSummary()
+{
+    printf("frame stats, %llu frames (ms):\n", (unsigned long long)s_frameCount);
+    printf("    %-14s %10s %10s %10s %10s %10s\n", "phase", "mean", "p50", "p95", "p99", "max");
+    for (int i = 0; i < NUM_FRAME_PHASES; i++)
+    {
+        const PhaseHistogram& h = s_histograms[i];
+        if (h.count == 0)
+        {
+            continue;
+        }
+        printf("    %-14s %10.3f %10.3f %10.3f %10.3f %10.3f\n", s_phaseNames[i],
+               (double)h.sum / (double)h.count / 1.0e6, Percentile(h, 0.50) / 1.0e6,
+               Percentile(h, 0.95) / 1.0e6, Percentile(h, 0.99) / 1.0e6, (double)h.max / 1.0e6);
+    }
+    for (int i = 0; i < NUM_FRAME_COUNTERS; i++)
+    {
+        const CounterTotals& totals = s_counterTotals[i];
+        if (totals.frames > 0)
+        {
+            printf("    %-14s %10.1f per frame, max %llu\n", s_counterNames[i],
+                   (double)totals.sum / (double)totals.frames, (unsigned long long)totals.max);
+        }
+    }
+
+    // called out on its own line, it's the number to compare with and without --late-latch.
+    const PhaseHistogram& poseAge = s_histograms[PHASE_POSE_AGE];
+    if (poseAge.count > 0)
+    {
+        printf("pose age, xrLocateViews to xrEndFrame: p50 %.3f ms, p95 %.3f ms\n", Percentile(poseAge, 0.50) / 1.0e6,
+               Percentile(poseAge, 0.95) / 1.0e6);
+    }
+}
+
+static bool WriteCSV(FILE* fp)
+{
+    fprintf(fp, "phase,count,mean_us,p50_us,p95_us,p99_us,max_us\n");
+    for (int i = 0; i < NUM_FRAME_PHASES; i++)
+    {
+        const PhaseHistogram& h = s_histograms[i];
+        fprintf(fp, "%s,%llu,%.3f,%.3f,%.3f,%.3f,%.3f\n", s_phaseNames[i], (unsigned long long)h.count,
+                h.count ? (double)h.sum / (double)h.count / 1.0e3 : 0.0, Percentile(h, 0.50) / 1.0e3,
+                Percentile(h, 0.95) / 1.0e3, Percentile(h, 0.99) / 1.0e3, (double)h.max / 1.0e3);
+    }
+    fprintf(fp, "\ncounter,frames,mean_per_frame,max_per_frame\n");
+    for (int i = 0; i < NUM_FRAME_COUNTERS; i++)
+    {
+        const CounterTotals& totals = s_counterTotals[i];
+        fprintf(fp, "%s,%llu,%.1f,%llu\n", s_counterNames[i], (unsigned long long)totals.frames,
+                totals.frames ? (double)totals.sum / (double)totals.frames : 0.0, (unsigned long long)totals.max);
+    }
+    return true;
+}
+
+static bool WriteJSON(FILE* fp)
+{
+    fprintf(fp, "{\n    \"frameCount\": %llu,\n    \"phases\": {\n", (unsigned long long)s_frameCount);
+    for (int i = 0; i < NUM_FRAME_PHASES; i++)
+    {
+        const PhaseHistogram& h = s_histograms[i];
+        fprintf(fp, "        \"%s\": {\"count\": %llu, \"mean_us\": %.3f, \"p50_us\": %.3f, \"p95_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f}%s\n",
+                s_phaseNames[i], (unsigned long long)h.count,
+                h.count ? (double)h.sum / (double)h.count / 1.0e3 : 0.0, Percentile(h, 0.50) / 1.0e3,
+                Percentile(h, 0.95) / 1.0e3, Percentile(h, 0.99) / 1.0e3, (double)h.max / 1.0e3,
+                i + 1 < NUM_FRAME_PHASES ? "," : "");
+    }
+    fprintf(fp, "    },\n    \"counters\": {\n");
+    for (int i = 0; i < NUM_FRAME_COUNTERS; i++)
+    {
+        const CounterTotals& totals = s_counterTotals[i];
+        fprintf(fp, "        \"%s\": {\"frames\": %llu, \"mean_per_frame\": %.1f, \"max_per_frame\": %llu}%s\n",
+                s_counterNames[i], (unsigned long long)totals.frames,
+                totals.frames ? (double)totals.sum / (double)totals.frames : 0.0, (unsigned long long)totals.max,
+                i + 1 < NUM_FRAME_COUNTERS ? "," : "");
+    }
+    fprintf(fp, "    },\n");
+
+    // the most recent frames, oldest first, as [start offset, duration] in microseconds.
+    // gpu phases have no cpu start time, so only the duration is written.  Counters follow the phases.
+    const uint64_t first = s_frameCount > RING_SIZE ? s_frameCount - RING_SIZE : 0;
+    fprintf(fp, "    \"recentFrames\": [\n");
+    for (uint64_t f = first; f < s_frameCount; f++)
+    {
+        const FrameRecord& record = s_ring[f & (RING_SIZE - 1)];
+        const uint64_t frameStart = record.start[PHASE_FRAME];
+        fprintf(fp, "        {\"frame\": %llu", (unsigned long long)record.frameIndex);
+        for (int i = 0; i < NUM_FRAME_PHASES; i++)
+        {
+            if (!(record.phaseMask & (1u << i)))
+            {
+                continue;
+            }
+            if (record.start[i] == 0)
+            {
+                fprintf(fp, ", \"%s\": %.3f", s_phaseNames[i], (double)record.duration[i] / 1.0e3);
+            }
+            else
+            {
+                fprintf(fp, ", \"%s\": [%.3f, %.3f]", s_phaseNames[i],
+                        record.start[i] >= frameStart ? (double)(record.start[i] - frameStart) / 1.0e3 : 0.0,
+                        (double)record.duration[i] / 1.0e3);
+            }
+        }
+        for (int i = 0; i < NUM_FRAME_COUNTERS; i++)
+        {
+            if (record.counterMask & (1u << i))
+            {
+                fprintf(fp, ", \"%s\": %llu", s_counterNames[i], (unsigned long long)record.counts[i]);
+            }
+        }
+        fprintf(fp, "}%s\n", f + 1 < s_frameCount ? "," : "");
+    }
+    fprintf(fp, "    ]\n}\n");
+    return true;
+}
+
+static bool WriteOutput()
+{
+    FILE* fp = fopen(s_outputPath.c_str(), "w");
+    if (!fp)
+    {
+        printf("Failed to open frame stats file \"%s\"\n", s_outputPath.c_str());
+        return false;
+    }
+
+    const size_t len = s_outputPath.size();
+    bool json = len >= 5 && s_outputPath.compare(len - 5, 5, ".json") == 0;
+    bool result = json ? WriteJSON(fp) : WriteCSV(fp);
+    fclose(fp);
+
+    printf("frame stats written to %s\n", s_outputPath.c_str());
+    return result;
+}
+
+void FrameStatsPoll()
+{
+    if (g_frameStatsEnabled && s_dumpRequested)
+    {
+        s_dumpRequested = 0;
+        PrintSummary();
+        WriteOutput();
+    }
+}
+
+void FrameStatsShutdown()
+{
+    if (!g_frameStatsEnabled)
+    {
+        return;
+    }
+    PrintSummary();
+    WriteOutput();
+    g_frameStatsEnabled = false;
+}
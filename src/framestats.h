@@ -0,0 +1,76 @@
+// per-phase frame timing
+//
+// Each phase of the frame loop is timed with a monotonic clock and recorded into a fixed size ring of
+// recent frames, as well as a per-phase histogram covering the whole run.  The histograms are dumped as
+// p50/p95/p99 to a CSV or JSON file on exit, or whenever SIGUSR1 is received.  Counters, such as the
+// number of objects culled, are summed per frame and reported as their mean and max per frame.
+//
+// When stats are not enabled, FrameStatsNow() returns 0 without reading the clock and every other call
+// returns immediately, so the instrumentation can stay in the frame loop.
+
+#pragma once
+
+#include <cstdint>
+
+enum FramePhase
+{
+    PHASE_FRAME = 0,        // whole frame, from before xrSyncActions to after xrEndFrame
+    PHASE_SYNC_INPUT,
+    PHASE_WAIT_FRAME,
+    PHASE_DEQUEUE_FRAME,    // pipelined mode only, render thread waiting for the pacing thread
+    PHASE_BEGIN_FRAME,
+    PHASE_LOCATE_VIEWS,
+    PHASE_ACQUIRE_IMAGE,    // summed over all views
+    PHASE_WAIT_IMAGE,       // summed over all views
+    PHASE_RENDER_VIEW,      // summed over all views
+    PHASE_RELEASE_IMAGE,    // summed over all views
+    PHASE_END_FRAME,
+    PHASE_POSE_AGE,         // from xrLocateViews of the rendered poses to xrEndFrame
+    PHASE_GPU_VIEW0,        // gpu time, measured with timer queries and reported a few frames late
+    PHASE_GPU_VIEW1,
+    PHASE_GPU_RENDER,       // gpu time of all views, comparable between stereo modes
+    NUM_FRAME_PHASES
+};
+
+// counts summed over each frame, reported per frame alongside the phases.
+enum FrameCounter
+{
+    COUNTER_CULL_TESTED = 0,    // bounding boxes tested against frusta, hierarchy nodes included
+    COUNTER_CULL_VISIBLE,       // objects drawn, summed over passes
+    COUNTER_DRAWS_SAVED,        // draw calls culling left out, against drawing every object in every pass
+    COUNTER_DRAW_CALLS,         // gl draw calls made for the scene, one multi draw counted once
+    COUNTER_FENCE_WAITS,        // times the cpu blocked on a fence before reusing a uniform ring slot
+    NUM_FRAME_COUNTERS
+};
+
+extern bool g_frameStatsEnabled;
+
+// enables stats collection, results are written to outputPath, which should end in .csv or .json
+bool FrameStatsInit(const char* outputPath);
+
+// monotonic time in nanoseconds, read whether or not stats are enabled, startup timing and dynamic resolution
+// depend on it.
+uint64_t FrameStatsClock();
+
+// FrameStatsClock(), or 0 when stats are disabled, for timing phases that are only recorded with stats.
+inline uint64_t FrameStatsNow()
+{
+    return g_frameStatsEnabled ? FrameStatsClock() : 0;
+}
+
+void FrameStatsBeginFrame();
+void FrameStatsAddPhase(FramePhase phase, uint64_t start, uint64_t end);
+void FrameStatsAddCount(FrameCounter counter, uint64_t count);
+void FrameStatsEndFrame();
+
+// index of the frame currently being recorded.
+uint64_t FrameStatsCurrentFrame();
+
+// adds a duration to a frame that has already ended, used for gpu timings that are read back later.
+void FrameStatsAddLatePhase(uint64_t frameIndex, FramePhase phase, uint64_t duration);
+
+// dumps the stats if a signal has asked for it, call once per iteration of the main loop.
+void FrameStatsPoll();
+
+// prints a summary, writes the output file and disables collection.
+void FrameStatsShutdown();
@@ -0,0 +1,191 @@
+// gpu timer queries
+
+#include "gputimer.h"
+
+#include <GL/glew.h>
+
+#include <cstdio>
+#include <cstring>
+
+// maximum number of timed regions per frame.
+static const uint32_t MAX_TIMERS_PER_FRAME = 16;
+
+struct GpuTimerEntry
+{
+    FramePhase phase;
+    GLuint startQuery;
+    GLuint endQuery;
+    bool ended;
+};
+
+struct GpuTimerFrame
+{
+    uint64_t frameIndex;
+    uint32_t count;
+    GLuint lastQuery;    // most recently issued end query
+    GLuint queries[MAX_TIMERS_PER_FRAME * 2];
+    GpuTimerEntry entries[MAX_TIMERS_PER_FRAME];
+};
+
+static bool s_enabled = false;
+static GpuTimerFrame s_frames[GPU_TIMER_LATENCY];
+static GpuTimerFrame* s_current = NULL;
+static uint64_t s_frameCount = 0;
+static uint64_t s_dropped = 0;
+static uint64_t s_latest[NUM_FRAME_PHASES];
+
+bool GpuTimerInit()
+{
+    if (!GLEW_VERSION_3_3 && !GLEW_ARB_timer_query)
+    {
+        printf("GL_ARB_timer_query not supported, gpu timing disabled\n");
+        return false;
+    }
+
+    for (uint32_t i = 0; i < GPU_TIMER_LATENCY; i++)
+    {
+        glGenQueries(MAX_TIMERS_PER_FRAME * 2, s_frames[i].queries);
+        s_frames[i].count = 0;
+        s_frames[i].lastQuery = 0;
+    }
+    s_current = NULL;
+    s_frameCount = 0;
+    s_dropped = 0;
+    memset(s_latest, 0, sizeof(s_latest));
+    s_enabled = true;
+    return true;
+}
+
+// returns false if the results are not ready yet and wait is false.
+static bool ReadBack(GpuTimerFrame& frame, bool wait)
+{
+    if (frame.count == 0)
+    {
+        return true;
+    }
+
+    // queries complete in order, so if the last one issued is available they all are.
+    const GLuint lastQuery = frame.lastQuery;
+    if (lastQuery == 0)
+    {
+        frame.count = 0;
+        return true;
+    }
+
+    if (!wait)
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(lastQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+        {
+            return false;
+        }
+    }
+
+    uint64_t durations[NUM_FRAME_PHASES] = {0};
+    uint32_t phaseMask = 0;
+    for (uint32_t i = 0; i < frame.count; i++)
+    {
+        const GpuTimerEntry& entry = frame.entries[i];
+        if (!entry.ended)
+        {
+            continue;
+        }
+        GLuint64 start = 0, end = 0;
+        glGetQueryObjectui64v(entry.startQuery, GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(entry.endQuery, GL_QUERY_RESULT, &end);
+        durations[entry.phase] += end > start ? end - start : 0;
+        phaseMask |= 1u << entry.phase;
+    }
+
+    for (int i = 0; i < NUM_FRAME_PHASES; i++)
+    {
+        if (phaseMask & (1u << i))
+        {
+            FrameStatsAddLatePhase(frame.frameIndex, (FramePhase)i, durations[i]);
+            s_latest[i] = durations[i];
+        }
+    }
+    frame.count = 0;
+    return true;
+}
+
+void GpuTimerBeginFrame()
+{
+    if (!s_enabled)
+    {
+        return;
+    }
+
+    // frames are counted here, since framestats doesn't count them when it is disabled.
+    GpuTimerFrame& frame = s_frames[s_frameCount++ % GPU_TIMER_LATENCY];
+    if (!ReadBack(frame, false))
+    {
+        // rather than stall, throw away results that are still not ready.
+        s_dropped++;
+        frame.count = 0;
+    }
+    frame.frameIndex = FrameStatsCurrentFrame();
+    frame.lastQuery = 0;
+    s_current = &frame;
+}
+
+void GpuTimerBegin(FramePhase phase)
+{
+    if (!s_current || s_current->count >= MAX_TIMERS_PER_FRAME)
+    {
+        return;
+    }
+    GpuTimerEntry& entry = s_current->entries[s_current->count];
+    entry.phase = phase;
+    entry.startQuery = s_current->queries[s_current->count * 2];
+    entry.endQuery = s_current->queries[s_current->count * 2 + 1];
+    entry.ended = false;
+    s_current->count++;
+    glQueryCounter(entry.startQuery, GL_TIMESTAMP);
+}
+
+void GpuTimerEnd(FramePhase phase)
+{
+    if (!s_current)
+    {
+        return;
+    }
+    // end the most recent open timer for this phase.
+    for (uint32_t i = s_current->count; i > 0; i--)
+    {
+        GpuTimerEntry& entry = s_current->entries[i - 1];
+        if (entry.phase == phase && !entry.ended)
+        {
+            glQueryCounter(entry.endQuery, GL_TIMESTAMP);
+            entry.ended = true;
+            s_current->lastQuery = entry.endQuery;
+            return;
+        }
+    }
+}
+
+uint64_t GpuTimerLatest(FramePhase phase)
+{
+    return s_latest[phase];
+}
+
+void GpuTimerShutdown()
+{
+    if (!s_enabled)
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < GPU_TIMER_LATENCY; i++)
+    {
+        ReadBack(s_frames[i], true);
+        glDeleteQueries(MAX_TIMERS_PER_FRAME * 2, s_frames[i].queries);
+    }
+    if (s_dropped > 0)
+    {
+        printf("gpu timer: %llu frames of results were not ready in time and dropped\n", (unsigned long long)s_dropped);
+    }
+    s_current = NULL;
+    s_enabled = false;
+}
@@ -0,0 +1,28 @@
+// gpu timer queries
+//
+// GPU work is bracketed with a pair of GL_TIMESTAMP queries.  Queries come from a pool with one set per
+// frame in flight, results are read back GPU_TIMER_LATENCY frames later, and only if they are already
+// available, so timing never stalls the pipeline.  Durations are reported to framestats as late phases
+// of the frame that issued them, and the most recent one of each phase is kept for GpuTimerLatest().
+
+#pragma once
+
+#include "framestats.h"
+
+// number of frames between issuing a query and reading it back.
+static const uint32_t GPU_TIMER_LATENCY = 4;
+
+// returns false if timer queries are not supported, call after glewInit().
+bool GpuTimerInit();
+
+// reads back any results from GPU_TIMER_LATENCY frames ago, call after FrameStatsBeginFrame().
+void GpuTimerBeginFrame();
+
+void GpuTimerBegin(FramePhase phase);
+void GpuTimerEnd(FramePhase phase);
+
+// the most recent duration read back for the phase in nanoseconds, or 0 if there hasn't been one.
+uint64_t GpuTimerLatest(FramePhase phase);
+
+// waits for all outstanding results and deletes the queries, the gl context must still be current.
+void GpuTimerShutdown();
@@ -11,27 +11,534 @@
 #define XR_USE_PLATFORM_XLIB
 #endif
 
+#include <GL/glew.h>
+#if defined(XR_USE_PLATFORM_XLIB)
+#include <X11/Xlib.h>
+#include <GL/glx.h>
+#endif
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_opengl.h>
+
 #include <openxr/openxr.h>
 #include <openxr/openxr_platform.h>
 
 #include <vector>
 #include <array>
-#include <map>
-
-#include <GL/glew.h>
-#include <SDL2/SDL.h>
-#include <SDL2/SDL_opengl.h>
+#include <string>
+#include <algorithm>
+
+#include "framestats.h"
+#include "gputimer.h"
+#include "framepacer.h"
+#include "dynres.h"
+#include "xrmath.h"
+#include "scene.h"
+#include "culling.h"
+#include "programcache.h"
+#include "startup.h"
 
 #include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if !defined(WIN32)
+template <size_t N>
+static void strcpy_s(char (&dest)[N], const char* src)
+{
+    strncpy(dest, src, N - 1);
+    dest[N - 1] = '\0';
+}
+#endif
 
 static bool quitting = false;
 static float r = 0.0f;
 static SDL_Window *window = NULL;
 static SDL_GLContext gl_context;
+static SDL_GLContext workerContext = NULL;     // shares gl_context's objects, for linking programs on a worker thread
 static SDL_Renderer *renderer = NULL;
 
 bool printAll = true;
 
+enum StereoMode
+{
+    STEREO_TWO_PASS = 0,    // a swapchain per view, each view rendered separately
+    STEREO_DOUBLE_WIDE,     // one side by side swapchain, each view drawn into its own imageRect
+    STEREO_MULTIVIEW,       // one array swapchain, both views in one draw with GL_OVR_multiview2
+    STEREO_LAYERED,         // one array swapchain, both views in one instanced draw that writes gl_Layer
+};
+
+// the single pass shaders are written for exactly two views.
+static const uint32_t MAX_STEREO_VIEWS = 2;
+
+// per-frame and per-view constants are written into one of these uniform buffer slots per frame,
+// so the cpu never writes a slot the gpu may still be reading.
+static const uint32_t NUM_UNIFORM_RING_SLOTS = 3;
+static const GLuint VIEW_UNIFORM_BINDING = 0;
+
+// the ViewBlock uniform block, in std140 layout.  Views drawn one at a time get a block of their own,
+// with their constants in [0].
+struct ViewBlock
+{
+    float modelViewProjMat[MAX_STEREO_VIEWS][16];
+    float tanAngles[MAX_STEREO_VIEWS][4];       // left, right, down, up
+};
+
+// batched submission reads per-instance data from a buffer bound here, a storage buffer when supported, or else
+// a uniform buffer bound a chunk at a time, small enough for the 16KB every implementation allows.
+static const GLuint INSTANCE_BINDING = 1;
+static const uint32_t INSTANCE_CHUNK_SIZE = 192;
+
+// attribute locations bound before linking, so the vertex array doesn't depend on which program draws it.
+static const GLuint POSITION_ATTRIB_LOC = 0;
+static const GLuint INSTANCE_SLOT_ATTRIB_LOC = 1;
+
+// stress instances are the scene's meshes scaled down to this size, in meters, on a grid in the floor's plane.
+static const float STRESS_INSTANCE_SIZE = 0.3f;
+static const float STRESS_INSTANCE_SPACING = 0.4f;
+
+// bounds of the dynamic resolution scale, as a fraction of the recommended view size.
+// swapchains are allocated for the largest scale, or maxImageRectWidth/Height if that is smaller.
+static const float MIN_RESOLUTION_SCALE = 0.5f;
+static const float MAX_RESOLUTION_SCALE = 1.25f;
+
+// fixed foveation, rings from the center out, each covering size of the view's width and height around the
+// view direction, rendered at scale of full resolution.  The outermost ring covers the whole view.
+struct FoveationRing
+{
+    float size;
+    float scale;
+};
+static const uint32_t MAX_FOVEATION_RINGS = 4;
+static const FoveationRing DEFAULT_FOVEATION_RINGS[] = {{0.5f, 1.0f}, {0.8f, 0.5f}, {1.0f, 0.25f}};
+static const uint32_t NUM_DEFAULT_FOVEATION_RINGS = sizeof(DEFAULT_FOVEATION_RINGS) / sizeof(DEFAULT_FOVEATION_RINGS[0]);
+
+// longest sleep between polls for events while the session isn't running.
+static const uint32_t MAX_IDLE_WAIT_MS = 16;
+
+// clip planes of the projection matrix, also given to the runtime with submitted depth.
+static const float NEAR_Z = 0.05f;
+static const float FAR_Z = 100.0f;
+
+static const char* StereoModeToString(StereoMode stereoMode)
+{
+    switch (stereoMode)
+    {
+    case STEREO_TWO_PASS: return "twopass";
+    case STEREO_DOUBLE_WIDE: return "doublewide";
+    case STEREO_MULTIVIEW: return "multiview";
+    case STEREO_LAYERED: return "layered";
+    default: return "???";
+    }
+}
+
+enum DepthPolicy
+{
+    DEPTH_PER_IMAGE = 0,    // a depth buffer for every swapchain image
+    DEPTH_PER_VIEW,         // one depth buffer per swapchain, shared by its images
+    DEPTH_SHARED,           // one depth buffer for every swapchain, sized to fit the largest
+};
+
+static const char* DepthPolicyToString(DepthPolicy depthPolicy)
+{
+    switch (depthPolicy)
+    {
+    case DEPTH_PER_IMAGE: return "per-image";
+    case DEPTH_PER_VIEW: return "per-view";
+    case DEPTH_SHARED: return "shared";
+    default: return "???";
+    }
+}
+
+enum MsaaMode
+{
+    MSAA_AUTO = 0,              // the first of the below that can be used
+    MSAA_SWAPCHAIN,             // multisampled swapchains, resolved by the runtime
+    MSAA_RENDER_TO_TEXTURE,     // EXT_multisampled_render_to_texture, resolved implicitly by the driver
+    MSAA_BLIT,                  // transient multisampled buffers, resolved into the swapchain images with glBlitFramebuffer
+};
+
+static const char* MsaaModeToString(MsaaMode msaaMode)
+{
+    switch (msaaMode)
+    {
+    case MSAA_AUTO: return "auto";
+    case MSAA_SWAPCHAIN: return "swapchain";
+    case MSAA_RENDER_TO_TEXTURE: return "rtt";
+    case MSAA_BLIT: return "blit";
+    default: return "???";
+    }
+}
+
+enum SubmitMode
+{
+    SUBMIT_DIRECT = 0,          // a uniform update and a draw per object per pass
+    SUBMIT_INSTANCED,           // per-instance data in a buffer, a draw per mesh
+    SUBMIT_INDIRECT,            // per-instance data in a buffer, one glMultiDrawElementsIndirect per primitive type
+};
+
+static const char* SubmitModeToString(SubmitMode submitMode)
+{
+    switch (submitMode)
+    {
+    case SUBMIT_DIRECT: return "direct";
+    case SUBMIT_INSTANCED: return "instanced";
+    case SUBMIT_INDIRECT: return "indirect";
+    default: return "???";
+    }
+}
+
+// the command layout glMultiDrawElementsIndirect reads.
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+struct DepthFormatInfo
+{
+    const char* name;
+    GLenum internalFormat;
+    GLenum format;
+    GLenum type;
+    GLenum attachment;
+    uint32_t bytesPerPixel;
+};
+
+static const DepthFormatInfo DEPTH_FORMATS[] = {
+    {"d32", GL_DEPTH_COMPONENT32, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, GL_DEPTH_ATTACHMENT, 4},
+    {"d24s8", GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, GL_DEPTH_STENCIL_ATTACHMENT, 4},
+    {"d32f", GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT, GL_DEPTH_ATTACHMENT, 4},
+    {"d16", GL_DEPTH_COMPONENT16, GL_DEPTH_COMPONENT, GL_UNSIGNED_SHORT, GL_DEPTH_ATTACHMENT, 2}
+};
+static const uint32_t NUM_DEPTH_FORMATS = sizeof(DEPTH_FORMATS) / sizeof(DEPTH_FORMATS[0]);
+
+struct ColorFormatInfo
+{
+    const char* name;
+    GLenum internalFormat;
+    uint32_t bytesPerPixel;
+};
+
+// color swapchain formats in order of preference, the first one the runtime supports is used.
+// 32 bit formats come first, the compositor reads every pixel, so a 64 bit format doubles its bandwidth
+// as well as ours, for precision a projection layer rarely needs.
+static const ColorFormatInfo COLOR_FORMATS[] = {
+    {"srgb8", GL_SRGB8_ALPHA8, 4},
+    {"rgb10a2", GL_RGB10_A2, 4},
+    {"r11g11b10f", GL_R11F_G11F_B10F, 4},
+    {"rgba16f", GL_RGBA16F, 8},
+    {"rgba8", GL_RGBA8, 4}
+};
+static const uint32_t NUM_COLOR_FORMATS = sizeof(COLOR_FORMATS) / sizeof(COLOR_FORMATS[0]);
+
+struct Options
+{
+    const char* statsPath = NULL;
+    StereoMode stereoMode = STEREO_TWO_PASS;
+    DepthPolicy depthPolicy = DEPTH_PER_IMAGE;
+    const DepthFormatInfo* depthFormat = &DEPTH_FORMATS[0];
+    const ColorFormatInfo* colorFormat = NULL;     // NULL picks the first supported one in COLOR_FORMATS
+    uint32_t samples = 0;      // 0 uses the runtime's recommended sample count
+    MsaaMode msaaMode = MSAA_AUTO;
+    bool submitDepth = false;
+    bool pipelined = false;
+    bool lateLatch = false;
+    bool dynamicResolution = false;
+    bool visibilityMask = true;
+    uint32_t foveationRingCount = 0;    // 0 renders every pixel at full resolution
+    FoveationRing foveationRings[MAX_FOVEATION_RINGS];
+    const char* scenePath = NULL;       // NULL draws the built-in room
+    bool culling = true;
+    SubmitMode submitMode = SUBMIT_DIRECT;
+    uint32_t stressInstances = 0;       // 0 draws each mesh of the scene once
+    bool programCache = true;
+    const char* programCacheDir = NULL; // NULL uses DefaultProgramCacheDir()
+    bool asyncPrograms = true;
+};
+
+static void PrintUsage()
+{
+    printf("usage: openxrstub [options]\n");
+    printf("    --stats FILE    record per-phase frame timing, written to FILE (.csv or .json) on exit or SIGUSR1\n");
+    printf("    --stereo MODE   twopass (default), doublewide, singlepass, multiview or layered\n");
+    printf("                    singlepass picks multiview if supported, then layered, then falls back to twopass\n");
+    printf("    --depth POLICY  per-image (default), per-view or shared depth buffers\n");
+    printf("    --depth-format FORMAT\n");
+    printf("                    d32 (default), d24s8, d32f or d16\n");
+    printf("    --color-format FORMAT\n");
+    printf("                    srgb8, rgb10a2, r11g11b10f, rgba16f or rgba8, default is the first of these supported\n");
+    printf("    --samples N     msaa sample count, default is the runtime's recommendedSwapchainSampleCount\n");
+    printf("    --msaa MODE     auto (default), swapchain, rtt or blit, how multisampled views are resolved\n");
+    printf("    --submit-depth  submit depth to the runtime with XR_KHR_composition_layer_depth, if supported\n");
+    printf("    --pipelined     call xrWaitFrame on a separate pacing thread, overlapping rendering of the previous frame\n");
+    printf("    --dynamic-resolution\n");
+    printf("                    scale the rendered view size with the measured frame time, to keep up with the display\n");
+    printf("    --late-latch    locate views after the swapchain images are acquired, just before drawing\n");
+    printf("    --foveation     render the periphery of each view at lower resolution, twopass and doublewide only\n");
+    printf("    --foveation-rings SIZE:SCALE,...\n");
+    printf("                    foveation rings from the center out, default 0.5:1,0.8:0.5,1:0.25, the last size must be 1\n");
+    printf("    --scene FILE    draw the meshes of a scene file written by openxrstub_meshconv, instead of the room\n");
+    printf("    --no-culling    draw every object of the scene in every view, without frustum culling\n");
+    printf("    --submit MODE   direct (default), instanced or indirect, how objects are drawn\n");
+    printf("                    indirect falls back to instanced without glMultiDrawElementsIndirect\n");
+    printf("    --stress-instances N\n");
+    printf("                    draw N copies of the scene's meshes on a grid, with their own transforms and colors\n");
+    printf("    --no-visibility-mask\n");
+    printf("                    shade the whole view, even the area hidden by the lenses (XR_KHR_visibility_mask)\n");
+    printf("    --program-cache DIR\n");
+    printf("                    keep linked program binaries in DIR, default $XDG_CACHE_HOME/openxrstub or ~/.cache/openxrstub\n");
+    printf("    --no-program-cache\n");
+    printf("                    compile every program from source\n");
+    printf("    --sync-programs\n");
+    printf("                    link every program before the first frame, rather than drawing with a plain one until\n");
+    printf("                    the one asked for is linked in the background\n");
+}
+
+// parses a comma separated list of SIZE:SCALE foveation rings, sizes increasing up to 1,
+// scales in (0, 1] and no higher than the ring inside.
+static bool ParseFoveationRings(const char* str, FoveationRing* rings, uint32_t& ringCount)
+{
+    ringCount = 0;
+    while (str)
+    {
+        FoveationRing ring;
+        if (ringCount == MAX_FOVEATION_RINGS || sscanf(str, "%f:%f", &ring.size, &ring.scale) != 2 ||
+            ring.size <= (ringCount > 0 ? rings[ringCount - 1].size : 0.0f) || ring.size > 1.0f ||
+            ring.scale <= 0.0f || ring.scale > (ringCount > 0 ? rings[ringCount - 1].scale : 1.0f))
+        {
+            return false;
+        }
+        rings[ringCount++] = ring;
+        str = strchr(str, ',');
+        str = str ? str + 1 : NULL;
+    }
+    return ringCount > 0 && rings[ringCount - 1].size == 1.0f;
+}
+
+static bool ParseOptions(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--stats") && i + 1 < argc)
+        {
+            options.statsPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--stereo") && i + 1 < argc)
+        {
+            const char* mode = argv[++i];
+            if (!strcmp(mode, "twopass"))
+            {
+                options.stereoMode = STEREO_TWO_PASS;
+            }
+            else if (!strcmp(mode, "doublewide"))
+            {
+                options.stereoMode = STEREO_DOUBLE_WIDE;
+            }
+            else if (!strcmp(mode, "singlepass") || !strcmp(mode, "multiview"))
+            {
+                options.stereoMode = STEREO_MULTIVIEW;
+            }
+            else if (!strcmp(mode, "layered"))
+            {
+                options.stereoMode = STEREO_LAYERED;
+            }
+            else
+            {
+                PrintUsage();
+                return false;
+            }
+        }
+        else if (!strcmp(argv[i], "--depth") && i + 1 < argc)
+        {
+            const char* policy = argv[++i];
+            if (!strcmp(policy, "per-image"))
+            {
+                options.depthPolicy = DEPTH_PER_IMAGE;
+            }
+            else if (!strcmp(policy, "per-view"))
+            {
+                options.depthPolicy = DEPTH_PER_VIEW;
+            }
+            else if (!strcmp(policy, "shared"))
+            {
+                options.depthPolicy = DEPTH_SHARED;
+            }
+            else
+            {
+                PrintUsage();
+                return false;
+            }
+        }
+        else if (!strcmp(argv[i], "--samples") && i + 1 < argc)
+        {
+            const int samples = atoi(argv[++i]);
+            if (samples < 1)
+            {
+                PrintUsage();
+                return false;
+            }
+            options.samples = (uint32_t)samples;
+        }
+        else if (!strcmp(argv[i], "--msaa") && i + 1 < argc)
+        {
+            const char* mode = argv[++i];
+            if (!strcmp(mode, "auto"))
+            {
+                options.msaaMode = MSAA_AUTO;
+            }
+            else if (!strcmp(mode, "swapchain"))
+            {
+                options.msaaMode = MSAA_SWAPCHAIN;
+            }
+            else if (!strcmp(mode, "rtt"))
+            {
+                options.msaaMode = MSAA_RENDER_TO_TEXTURE;
+            }
+            else if (!strcmp(mode, "blit"))
+            {
+                options.msaaMode = MSAA_BLIT;
+            }
+            else
+            {
+                PrintUsage();
+                return false;
+            }
+        }
+        else if (!strcmp(argv[i], "--submit-depth"))
+        {
+            options.submitDepth = true;
+        }
+        else if (!strcmp(argv[i], "--pipelined"))
+        {
+            options.pipelined = true;
+        }
+        else if (!strcmp(argv[i], "--dynamic-resolution"))
+        {
+            options.dynamicResolution = true;
+        }
+        else if (!strcmp(argv[i], "--late-latch"))
+        {
+            options.lateLatch = true;
+        }
+        else if (!strcmp(argv[i], "--foveation"))
+        {
+            if (options.foveationRingCount == 0)
+            {
+                options.foveationRingCount = NUM_DEFAULT_FOVEATION_RINGS;
+                std::copy(DEFAULT_FOVEATION_RINGS, DEFAULT_FOVEATION_RINGS + NUM_DEFAULT_FOVEATION_RINGS, options.foveationRings);
+            }
+        }
+        else if (!strcmp(argv[i], "--foveation-rings") && i + 1 < argc)
+        {
+            if (!ParseFoveationRings(argv[++i], options.foveationRings, options.foveationRingCount))
+            {
+                PrintUsage();
+                return false;
+            }
+        }
+        else if (!strcmp(argv[i], "--scene") && i + 1 < argc)
+        {
+            options.scenePath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--submit") && i + 1 < argc)
+        {
+            const char* mode = argv[++i];
+            if (!strcmp(mode, "direct"))
+            {
+                options.submitMode = SUBMIT_DIRECT;
+            }
+            else if (!strcmp(mode, "instanced"))
+            {
+                options.submitMode = SUBMIT_INSTANCED;
+            }
+            else if (!strcmp(mode, "indirect"))
+            {
+                options.submitMode = SUBMIT_INDIRECT;
+            }
+            else
+            {
+                PrintUsage();
+                return false;
+            }
+        }
+        else if (!strcmp(argv[i], "--stress-instances") && i + 1 < argc)
+        {
+            const int count = atoi(argv[++i]);
+            if (count < 1)
+            {
+                PrintUsage();
+                return false;
+            }
+            options.stressInstances = (uint32_t)count;
+        }
+        else if (!strcmp(argv[i], "--no-culling"))
+        {
+            options.culling = false;
+        }
+        else if (!strcmp(argv[i], "--program-cache") && i + 1 < argc)
+        {
+            options.programCacheDir = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--no-program-cache"))
+        {
+            options.programCache = false;
+        }
+        else if (!strcmp(argv[i], "--sync-programs"))
+        {
+            options.asyncPrograms = false;
+        }
+        else if (!strcmp(argv[i], "--no-visibility-mask"))
+        {
+            options.visibilityMask = false;
+        }
+        else if (!strcmp(argv[i], "--color-format") && i + 1 < argc)
+        {
+            const char* format = argv[++i];
+            options.colorFormat = NULL;
+            for (uint32_t j = 0; j < NUM_COLOR_FORMATS; j++)
+            {
+                if (!strcmp(format, COLOR_FORMATS[j].name))
+                {
+                    options.colorFormat = &COLOR_FORMATS[j];
+                }
+            }
+            if (!options.colorFormat)
+            {
+                PrintUsage();
+                return false;
+            }
+        }
+        else if (!strcmp(argv[i], "--depth-format") && i + 1 < argc)
+        {
+            const char* format = argv[++i];
+            options.depthFormat = NULL;
+            for (uint32_t j = 0; j < NUM_DEPTH_FORMATS; j++)
+            {
+                if (!strcmp(format, DEPTH_FORMATS[j].name))
+                {
+                    options.depthFormat = &DEPTH_FORMATS[j];
+                }
+            }
+            if (!options.depthFormat)
+            {
+                PrintUsage();
+                return false;
+            }
+        }
+        else
+        {
+            PrintUsage();
+            return false;
+        }
+    }
+    return true;
+}
+
 struct Context
 {
     std::vector<XrExtensionProperties> extensionProps;
@@ -44,25 +551,226 @@ struct Context
     XrActionSet actionSet = XR_NULL_HANDLE;
     XrSpace stageSpace = XR_NULL_HANDLE;
 
+    StereoMode stereoMode = STEREO_TWO_PASS;
+
+    DepthPolicy depthPolicy = DEPTH_PER_IMAGE;
+    const DepthFormatInfo* depthFormat = &DEPTH_FORMATS[0];
+
+    uint32_t samples = 1;
+    MsaaMode msaaMode = MSAA_SWAPCHAIN;
+
+    // swapchains are allocated at this fraction of the recommended view size, more than 1 with dynamic resolution.
+    bool dynamicResolution = false;
+    float maxResolutionScale = 1.0f;
+
     struct SwapchainInfo
     {
         XrSwapchain handle;
+        int64_t format;
         int32_t width;
         int32_t height;
+        uint32_t arraySize;
     };
     std::vector<SwapchainInfo> swapchains;
     std::vector<std::vector<XrSwapchainImageOpenGLKHR>> swapchainImages;
-    std::map<GLuint, GLuint> colorToDepthMap;
-    GLuint frameBuffer;
+
+    // a depth swapchain for every color swapchain, when depth is submitted with XR_KHR_composition_layer_depth.
+    bool depthLayerEnabled = false;
+    std::vector<SwapchainInfo> depthSwapchains;
+    std::vector<std::vector<XrSwapchainImageOpenGLKHR>> depthSwapchainImages;
+
+    struct FrameBufferInfo
+    {
+        // a complete framebuffer per swapchain image, indexed by
+        // [(swapchain * stride + swapchainImageIndex) * depthStride + depthImageIndex]
+        // depthStride is 1 unless depth is submitted from depth swapchains.
+        std::vector<GLuint> frameBuffers;
+        uint32_t stride = 0;
+        uint32_t depthStride = 1;
+
+        // depth buffers, shared between framebuffers according to the depth policy.
+        // array swapchains need layered depth textures, everything else uses renderbuffers.
+        std::vector<GLuint> depthTextures;
+        std::vector<GLuint> depthRenderbuffers;
+        GLenum depthAttachment = GL_DEPTH_ATTACHMENT;
+
+        // depth is never read after the frame, so tell the driver it doesn't need to be kept.
+        bool invalidateDepth = false;
+
+        // with MSAA_BLIT, views are drawn into a transient multisampled target per swapchain, which
+        // frameBuffers points at for each of its images, and then blitted into the acquired images through
+        // resolveFrameBuffers, indexed by [frameBuffers index * layerCount + array layer].
+        struct MsaaTarget
+        {
+            GLuint frameBuffer = 0;
+            GLuint colorBuffer = 0;             // a renderbuffer, or a multisample array texture for array swapchains
+            GLuint depthBuffer = 0;
+            std::vector<GLuint> readFrameBuffers;   // one per array layer, blits only read a single layer
+            int32_t width = 0;
+            int32_t height = 0;
+        };
+        bool resolve = false;
+        bool resolveDepth = false;
+        uint32_t layerCount = 1;
+        std::vector<MsaaTarget> msaaTargets;
+        std::vector<GLuint> resolveFrameBuffers;
+    };
+    FrameBufferInfo frameBufferInfo;
 
     struct ProgramInfo
     {
         GLint program = 0;
         GLint modelViewProjMatUniformLoc = 0;
         GLint colorUniformLoc = 0;
-        GLint positionAttribLoc = 0;
+
+        // when set, view matrices come from the ViewBlock uniform block instead of modelViewProjMat,
+        // bound at the block of all views, or of the one view being drawn.
+        bool viewUniformBlock = false;
+
+        // direct submission sets each object's modelMat, batched submission reads it from the instance buffer,
+        // the slot given by instanceSlot's attribute in indirect mode, and by instanceOffset plus gl_InstanceID
+        // in instanced mode.
+        SubmitMode submitMode = SUBMIT_DIRECT;
+        GLint modelMatUniformLoc = -1;
+        GLint instanceOffsetUniformLoc = -1;
     };
     ProgramInfo programInfo;
+
+    // the program asked for, when it is linked in the background.  Until it is ready, frames are drawn with
+    // programInfo, the plain variant, with direct submission and matrices set as uniforms.
+    struct PendingProgramInfo
+    {
+        ProgramLink* link = NULL;
+        bool viewUniformBlock = false;
+        SubmitMode submitMode = SUBMIT_DIRECT;
+        bool storageBuffer = false;
+        uint64_t start = 0;
+        uint32_t fallbackFrames = 0;
+    };
+    PendingProgramInfo pendingProgramInfo;
+
+    // per-frame and per-view constants in a persistently mapped uniform buffer, a slot per frame in flight, each
+    // holding a ViewBlock of all views and then one per view.  Without it they are set as program uniforms.
+    struct UniformRingInfo
+    {
+        GLuint buffer = 0;
+        uint8_t* mapped = NULL;
+        GLsizeiptr blockSize = 0;       // sizeof(ViewBlock), rounded up to the offset alignment
+        GLsizeiptr slotSize = 0;
+        uint32_t slot = 0;
+        GLsync fences[NUM_UNIFORM_RING_SLOTS] = {};
+    };
+    bool uniformRing = false;
+    UniformRingInfo uniformRingInfo;
+    bool lateLatch = false;
+
+    // the scene's meshes, all in one vertex and one index buffer, and the objects placed from them.
+    struct GeometryInfo
+    {
+        struct MeshDraw
+        {
+            GLenum mode = GL_LINES;
+            GLsizei indexCount = 0;
+            GLuint firstIndex = 0;
+            const void* indexOffset = NULL;     // firstIndex in bytes
+            GLint baseVertex = 0;
+            float color[4] = {};
+        };
+        struct Object
+        {
+            uint32_t mesh = 0;
+            float modelMat[16];
+            float color[4];
+        };
+
+        // the objects drawn this frame as instances of their meshes, for the batched submit modes.  Built once per
+        // frame after culling and shared by every view, a group of consecutive instances per mesh, line meshes
+        // first so indirect mode draws each primitive type with one command array.
+        struct Instance
+        {
+            float modelMat[16];
+            float color[4];
+        };
+        struct BatchInfo
+        {
+            struct Group
+            {
+                uint32_t mesh;
+                uint32_t firstInstance;
+                uint32_t instanceCount;
+            };
+            bool storageBuffer = false;     // instances in a shader storage buffer, else in chunks of a uniform buffer
+            uint32_t viewInstances = 1;     // gl instances per object, layered stereo draws one per view
+            uint32_t chunkAlignment = 1;    // in instances, uniform buffer chunks start at multiples of this
+            GLuint instanceBuffer = 0;
+            GLuint commandBuffer = 0;
+            GLuint slotBuffer = 0;          // 0, 1, 2... read per instance, offset by each command's baseInstance
+            GLsizeiptr instanceBufferSize = 0;
+            std::vector<uint32_t> meshOrder;
+            std::vector<uint32_t> meshFirst;
+            std::vector<Instance> instances;
+            std::vector<Group> groups;
+            std::vector<DrawElementsIndirectCommand> commands;
+            uint32_t lineGroupCount = 0;
+        };
+
+        GLuint vao = 0;
+        GLuint vbo = 0;
+        GLuint ibo = 0;
+        GLenum indexType = GL_UNSIGNED_SHORT;
+        std::vector<MeshDraw> draws;
+        std::vector<Object> objects;
+        SubmitMode submitMode = SUBMIT_DIRECT;
+        BatchInfo batchInfo;
+    };
+    Scene scene;
+    GeometryInfo geometryInfo;
+
+    // the scene's objects are culled against each frame's views, see src/culling.h.  Candidates are those inside
+    // the union of the views, and visible those inside each view, for modes that draw the views one at a time
+    // with direct submission.
+    struct CullInfo
+    {
+        CullBvh bvh;
+        std::vector<uint32_t> candidates;
+        std::vector<uint32_t> visible[MAX_STEREO_VIEWS];
+    };
+    bool culling = false;
+    CullInfo cullInfo;
+
+    // the area of each view hidden by the lenses, from XR_KHR_visibility_mask, drawn into depth before anything
+    // else so none of it is shaded.  Vertices are x, y on the z = -1 plane and the view index.
+    struct VisibilityMaskInfo
+    {
+        PFN_xrGetVisibilityMaskKHR getVisibilityMask = NULL;
+        GLuint program = 0;
+        bool viewUniformBlock = false;  // tangents come from the bound ViewBlock, like the scene's matrices
+        GLint tanAnglesUniformLoc = -1;
+        GLuint vao = 0;
+        GLuint vbo = 0;
+        GLuint ibo = 0;
+        GLsizei firstIndex[MAX_STEREO_VIEWS] = {};
+        GLsizei indexCount[MAX_STEREO_VIEWS] = {};
+        GLsizei totalIndexCount = 0;
+    };
+    bool visibilityMaskEnabled = false;
+    VisibilityMaskInfo visibilityMaskInfo;
+
+    // fixed foveation of views drawn one at a time.  Rings below full rate are drawn one after another into a
+    // single sampled target, big enough for any of them, and stretched into the acquired image.
+    struct FoveationInfo
+    {
+        uint32_t ringCount = 0;
+        FoveationRing rings[MAX_FOVEATION_RINGS];
+        GLuint frameBuffer = 0;
+        GLuint colorBuffer = 0;
+        GLuint depthBuffer = 0;
+        int32_t width = 0;
+        int32_t height = 0;
+        bool blitDepth = false;     // when depth is submitted, the periphery's depth is stretched along with it
+    };
+    bool foveation = false;
+    FoveationInfo foveationInfo;
 };
 
 int SDLCALL watch(void *userdata, SDL_Event* event)
@@ -174,17 +882,26 @@ bool EnumerateLayers(std::vector<XrApiLayerProperties>& layerProps)
     return true;
 }
 
-bool CreateInstance(XrInstance& instance)
+bool CreateInstance(XrInstance& instance, bool depthLayerEnabled, bool visibilityMaskEnabled)
 {
     // create openxr instance
     XrResult result;
-    const char* const enabledExtensions[] = {XR_KHR_OPENGL_ENABLE_EXTENSION_NAME};
+    std::vector<const char*> enabledExtensions;
+    enabledExtensions.push_back(XR_KHR_OPENGL_ENABLE_EXTENSION_NAME);
+    if (depthLayerEnabled)
+    {
+        enabledExtensions.push_back(XR_KHR_COMPOSITION_LAYER_DEPTH_EXTENSION_NAME);
+    }
+    if (visibilityMaskEnabled)
+    {
+        enabledExtensions.push_back(XR_KHR_VISIBILITY_MASK_EXTENSION_NAME);
+    }
     XrInstanceCreateInfo ici;
     ici.type = XR_TYPE_INSTANCE_CREATE_INFO;
     ici.next = NULL;
     ici.createFlags = 0;
-    ici.enabledExtensionCount = 1;
-    ici.enabledExtensionNames = enabledExtensions;
+    ici.enabledExtensionCount = (uint32_t)enabledExtensions.size();
+    ici.enabledExtensionNames = enabledExtensions.data();
     ici.enabledApiLayerCount = 0;
     ici.enabledApiLayerNames = NULL;
     strcpy(ici.applicationInfo.applicationName, "OpenXR OpenGL Example");
@@ -388,11 +1105,37 @@ bool CreateSession(XrInstance instance, XrSystemId systemId, XrSession& session)
         }
     }
 
+#if defined(XR_USE_PLATFORM_WIN32)
     XrGraphicsBindingOpenGLWin32KHR glBinding;
     glBinding.type = XR_TYPE_GRAPHICS_BINDING_OPENGL_WIN32_KHR;
     glBinding.next = NULL;
     glBinding.hDC = wglGetCurrentDC();
     glBinding.hGLRC = wglGetCurrentContext();
+#elif defined(XR_USE_PLATFORM_XLIB)
+    XrGraphicsBindingOpenGLXlibKHR glBinding;
+    glBinding.type = XR_TYPE_GRAPHICS_BINDING_OPENGL_XLIB_KHR;
+    glBinding.next = NULL;
+    glBinding.xDisplay = glXGetCurrentDisplay();
+    glBinding.glxDrawable = glXGetCurrentDrawable();
+    glBinding.glxContext = glXGetCurrentContext();
+
+    // find the fbconfig & visual that SDL used to create the current context.
+    int fbConfigId = 0;
+    glXQueryContext(glBinding.xDisplay, glBinding.glxContext, GLX_FBCONFIG_ID, &fbConfigId);
+    const int fbConfigAttribs[] = {GLX_FBCONFIG_ID, fbConfigId, None};
+    int fbConfigCount = 0;
+    GLXFBConfig* fbConfigs = glXChooseFBConfig(glBinding.xDisplay, DefaultScreen(glBinding.xDisplay), fbConfigAttribs, &fbConfigCount);
+    if (!fbConfigs || fbConfigCount < 1)
+    {
+        printf("Could not find GLXFBConfig for current context\n");
+        return false;
+    }
+    glBinding.glxFBConfig = fbConfigs[0];
+    XVisualInfo* visualInfo = glXGetVisualFromFBConfig(glBinding.xDisplay, fbConfigs[0]);
+    glBinding.visualid = visualInfo ? (uint32_t)visualInfo->visualid : 0;
+    XFree(visualInfo);
+    XFree(fbConfigs);
+#endif
 
     XrSessionCreateInfo sci;
     sci.type = XR_TYPE_SESSION_CREATE_INFO;
@@ -722,12 +1465,515 @@ bool CreateStageSpace(XrInstance instance, XrSystemId systemId, XrSession sessio
     return true;
 }
 
-bool CreateSwapchains(XrInstance instance, XrSession session,
-                      const std::vector<XrViewConfigurationView>& viewConfigs,
-                      std::vector<Context::SwapchainInfo>& swapchains,
-                      std::vector<std::vector<XrSwapchainImageOpenGLKHR>>& swapchainImages)
+static const ColorFormatInfo* FindColorFormat(int64_t format)
 {
-    XrResult result;
+    for (uint32_t i = 0; i < NUM_COLOR_FORMATS; i++)
+    {
+        if (COLOR_FORMATS[i].internalFormat == format)
+        {
+            return &COLOR_FORMATS[i];
+        }
+    }
+    return NULL;
+}
+
+static uint32_t ColorFormatBytesPerPixel(int64_t format)
+{
+    const ColorFormatInfo* colorFormat = FindColorFormat(format);
+    return colorFormat ? colorFormat->bytesPerPixel : 4;
+}
+
+GLuint CreateDepthTexture(int32_t width, int32_t height, uint32_t arraySize, const DepthFormatInfo* depthFormat,
+                          uint32_t samples)
+{
+    GLenum target = arraySize > 1 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+    if (samples > 1)
+    {
+        target = arraySize > 1 ? GL_TEXTURE_2D_MULTISAMPLE_ARRAY : GL_TEXTURE_2D_MULTISAMPLE;
+    }
+
+    uint32_t depthTexture;
+    glGenTextures(1, &depthTexture);
+    glBindTexture(target, depthTexture);
+    if (samples > 1)
+    {
+        // multisample textures have no sampler state.
+        if (arraySize > 1)
+        {
+            glTexImage3DMultisample(target, samples, depthFormat->internalFormat, width, height, arraySize, GL_TRUE);
+        }
+        else
+        {
+            glTexImage2DMultisample(target, samples, depthFormat->internalFormat, width, height, GL_TRUE);
+        }
+        glBindTexture(target, 0);
+        return depthTexture;
+    }
+
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    if (arraySize > 1)
+    {
+        glTexImage3D(target, 0, depthFormat->internalFormat, width, height, arraySize, 0,
+                     depthFormat->format, depthFormat->type, nullptr);
+    }
+    else
+    {
+        glTexImage2D(target, 0, depthFormat->internalFormat, width, height, 0,
+                     depthFormat->format, depthFormat->type, nullptr);
+    }
+    glBindTexture(target, 0);
+    return depthTexture;
+}
+
+GLuint CreateDepthRenderbuffer(int32_t width, int32_t height, const DepthFormatInfo* depthFormat, uint32_t samples)
+{
+    GLuint depthRenderbuffer;
+    glGenRenderbuffers(1, &depthRenderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbuffer);
+    if (samples > 1)
+    {
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, depthFormat->internalFormat, width, height);
+    }
+    else
+    {
+        glRenderbufferStorage(GL_RENDERBUFFER, depthFormat->internalFormat, width, height);
+    }
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    return depthRenderbuffer;
+}
+
+// checks the bound framebuffer, deletes it and returns 0 if it is incomplete.
+static GLuint CheckFrameBuffer(GLuint frameBuffer)
+{
+    const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        printf("Framebuffer is incomplete, status = 0x%x\n", status);
+        glDeleteFramebuffers(1, &frameBuffer);
+        return 0;
+    }
+    return frameBuffer;
+}
+
+// returns a new framebuffer with the color texture and depth buffer attached as the stereo mode needs,
+// or 0 if it is incomplete.  samples is the sample count of multisampled swapchain images, or with
+// renderToTexture, the count the driver renders with before resolving into single sampled images.
+static GLuint CreateFrameBuffer(StereoMode stereoMode, GLuint colorTexture, GLuint depthBuffer, bool depthIsRenderbuffer,
+                                GLenum depthAttachment, uint32_t arraySize, uint32_t samples, bool renderToTexture)
+{
+    GLuint frameBuffer;
+    glGenFramebuffers(1, &frameBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+    if (stereoMode == STEREO_MULTIVIEW)
+    {
+        glFramebufferTextureMultiviewOVR(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, colorTexture, 0, 0, arraySize);
+        glFramebufferTextureMultiviewOVR(GL_FRAMEBUFFER, depthAttachment, depthBuffer, 0, 0, arraySize);
+    }
+    else if (stereoMode == STEREO_LAYERED)
+    {
+        // attach every layer, the vertex shader picks one with gl_Layer.
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, colorTexture, 0);
+        glFramebufferTexture(GL_FRAMEBUFFER, depthAttachment, depthBuffer, 0);
+    }
+    else
+    {
+        const bool multisampled = samples > 1 && !renderToTexture;
+        const GLenum textureTarget = multisampled ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+        if (samples > 1 && renderToTexture)
+        {
+            glFramebufferTexture2DMultisampleEXT(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0, samples);
+        }
+        else
+        {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textureTarget, colorTexture, 0);
+        }
+        if (depthIsRenderbuffer)
+        {
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, depthAttachment, GL_RENDERBUFFER, depthBuffer);
+        }
+        else
+        {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, depthAttachment, textureTarget, depthBuffer, 0);
+        }
+    }
+
+    return CheckFrameBuffer(frameBuffer);
+}
+
+// a multisampled color and depth buffer the size of the swapchain, drawn into and then resolved into its images.
+static bool CreateMsaaTarget(StereoMode stereoMode, const Context::SwapchainInfo& swapchain,
+                             const DepthFormatInfo* depthFormat, uint32_t samples,
+                             Context::FrameBufferInfo::MsaaTarget& target)
+{
+    target.width = swapchain.width;
+    target.height = swapchain.height;
+
+    glGenFramebuffers(1, &target.frameBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.frameBuffer);
+    if (swapchain.arraySize > 1)
+    {
+        glGenTextures(1, &target.colorBuffer);
+        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE_ARRAY, target.colorBuffer);
+        glTexImage3DMultisample(GL_TEXTURE_2D_MULTISAMPLE_ARRAY, samples, (GLenum)swapchain.format,
+                                swapchain.width, swapchain.height, swapchain.arraySize, GL_TRUE);
+        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE_ARRAY, 0);
+        target.depthBuffer = CreateDepthTexture(swapchain.width, swapchain.height, swapchain.arraySize, depthFormat, samples);
+
+        if (stereoMode == STEREO_MULTIVIEW)
+        {
+            glFramebufferTextureMultiviewOVR(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target.colorBuffer, 0, 0, swapchain.arraySize);
+            glFramebufferTextureMultiviewOVR(GL_FRAMEBUFFER, depthFormat->attachment, target.depthBuffer, 0, 0, swapchain.arraySize);
+        }
+        else
+        {
+            glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target.colorBuffer, 0);
+            glFramebufferTexture(GL_FRAMEBUFFER, depthFormat->attachment, target.depthBuffer, 0);
+        }
+        if (!CheckFrameBuffer(target.frameBuffer))
+        {
+            target.frameBuffer = 0;
+            return false;
+        }
+
+        for (uint32_t i = 0; i < swapchain.arraySize; i++)
+        {
+            GLuint readFrameBuffer;
+            glGenFramebuffers(1, &readFrameBuffer);
+            glBindFramebuffer(GL_FRAMEBUFFER, readFrameBuffer);
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target.colorBuffer, 0, i);
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, depthFormat->attachment, target.depthBuffer, 0, i);
+            readFrameBuffer = CheckFrameBuffer(readFrameBuffer);
+            if (!readFrameBuffer)
+            {
+                return false;
+            }
+            target.readFrameBuffers.push_back(readFrameBuffer);
+        }
+    }
+    else
+    {
+        glGenRenderbuffers(1, &target.colorBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, target.colorBuffer);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, (GLenum)swapchain.format, swapchain.width, swapchain.height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        target.depthBuffer = CreateDepthRenderbuffer(swapchain.width, swapchain.height, depthFormat, samples);
+
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.colorBuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, depthFormat->attachment, GL_RENDERBUFFER, target.depthBuffer);
+        if (!CheckFrameBuffer(target.frameBuffer))
+        {
+            target.frameBuffer = 0;
+            return false;
+        }
+        target.readFrameBuffers.push_back(target.frameBuffer);
+    }
+
+    return true;
+}
+
+// a framebuffer to blit one layer of an msaa target into, with the swapchain image and, when depth is
+// submitted, the depth swapchain image attached.
+static GLuint CreateResolveFrameBuffer(GLuint colorTexture, GLuint depthTexture, GLenum depthAttachment,
+                                       uint32_t arraySize, uint32_t layer)
+{
+    GLuint frameBuffer;
+    glGenFramebuffers(1, &frameBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+    if (arraySize > 1)
+    {
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, colorTexture, 0, layer);
+        if (depthTexture)
+        {
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, depthAttachment, depthTexture, 0, layer);
+        }
+    }
+    else
+    {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+        if (depthTexture)
+        {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, depthAttachment, GL_TEXTURE_2D, depthTexture, 0);
+        }
+    }
+    return CheckFrameBuffer(frameBuffer);
+}
+
+// builds a complete framebuffer for every swapchain image up front, so rendering only has to bind one.
+// when depth is submitted to the runtime, there is one for every pair of color and depth swapchain images.
+bool CreateFrameBuffers(StereoMode stereoMode, DepthPolicy depthPolicy, const DepthFormatInfo* depthFormat,
+                        uint32_t samples, MsaaMode msaaMode,
+                        const std::vector<Context::SwapchainInfo>& swapchains,
+                        const std::vector<std::vector<XrSwapchainImageOpenGLKHR>>& swapchainImages,
+                        const std::vector<std::vector<XrSwapchainImageOpenGLKHR>>& depthSwapchainImages,
+                        Context::FrameBufferInfo& frameBufferInfo)
+{
+    const bool depthSwapchains = !depthSwapchainImages.empty();
+
+    frameBufferInfo.stride = 0;
+    frameBufferInfo.depthStride = 1;
+    frameBufferInfo.layerCount = 1;
+    for (uint32_t i = 0; i < swapchains.size(); i++)
+    {
+        frameBufferInfo.stride = std::max(frameBufferInfo.stride, (uint32_t)swapchainImages[i].size());
+        if (depthSwapchains)
+        {
+            frameBufferInfo.depthStride = std::max(frameBufferInfo.depthStride, (uint32_t)depthSwapchainImages[i].size());
+        }
+        frameBufferInfo.layerCount = std::max(frameBufferInfo.layerCount, swapchains[i].arraySize);
+    }
+    frameBufferInfo.frameBuffers.assign(swapchains.size() * frameBufferInfo.stride * frameBufferInfo.depthStride, 0);
+    frameBufferInfo.depthTextures.clear();
+    frameBufferInfo.depthRenderbuffers.clear();
+    frameBufferInfo.depthAttachment = depthFormat->attachment;
+
+    // submitted depth is read by the runtime, so it has to be kept.
+    frameBufferInfo.invalidateDepth = !depthSwapchains && (GLEW_VERSION_4_3 || GLEW_ARB_invalidate_subdata);
+
+    // samples of the swapchain images themselves, and of what is drawn before the driver resolves it.
+    const uint32_t imageSamples = msaaMode == MSAA_SWAPCHAIN ? samples : 1;
+    const uint32_t drawSamples = msaaMode == MSAA_BLIT ? 1 : samples;
+    const bool renderToTexture = msaaMode == MSAA_RENDER_TO_TEXTURE;
+
+    frameBufferInfo.resolve = samples > 1 && msaaMode == MSAA_BLIT;
+    frameBufferInfo.resolveDepth = frameBufferInfo.resolve && depthSwapchains;
+    frameBufferInfo.msaaTargets.clear();
+    frameBufferInfo.resolveFrameBuffers.clear();
+    if (frameBufferInfo.resolve)
+    {
+        frameBufferInfo.msaaTargets.resize(swapchains.size());
+        frameBufferInfo.resolveFrameBuffers.assign(frameBufferInfo.frameBuffers.size() * frameBufferInfo.layerCount, 0);
+    }
+
+    // the shared depth buffer has to cover every swapchain.
+    int32_t sharedWidth = 0;
+    int32_t sharedHeight = 0;
+    for (auto& swapchain : swapchains)
+    {
+        sharedWidth = std::max(sharedWidth, swapchain.width);
+        sharedHeight = std::max(sharedHeight, swapchain.height);
+    }
+
+    const bool layered = stereoMode == STEREO_MULTIVIEW || stereoMode == STEREO_LAYERED;
+    uint64_t colorBytes = 0;
+    uint64_t depthBytes = 0;
+    uint64_t msaaBytes = 0;
+    uint32_t imageCount = 0;
+    GLuint depthBuffer = 0;
+    for (uint32_t i = 0; i < swapchains.size(); i++)
+    {
+        const Context::SwapchainInfo& swapchain = swapchains[i];
+        const uint64_t pixels = (uint64_t)swapchain.width * swapchain.height * swapchain.arraySize;
+        colorBytes += pixels * imageSamples * ColorFormatBytesPerPixel(swapchain.format) * swapchainImages[i].size();
+        imageCount += (uint32_t)swapchainImages[i].size();
+        if (depthSwapchains)
+        {
+            depthBytes += pixels * imageSamples * depthFormat->bytesPerPixel * depthSwapchainImages[i].size();
+        }
+
+        if (frameBufferInfo.resolve)
+        {
+            // every image of the swapchain is drawn through the same msaa target, and resolved into the image.
+            Context::FrameBufferInfo::MsaaTarget& target = frameBufferInfo.msaaTargets[i];
+            if (!CreateMsaaTarget(stereoMode, swapchain, depthFormat, samples, target))
+            {
+                return false;
+            }
+            msaaBytes += pixels * samples * (ColorFormatBytesPerPixel(swapchain.format) + depthFormat->bytesPerPixel);
+
+            const uint32_t depthImageCount = depthSwapchains ? (uint32_t)depthSwapchainImages[i].size() : 1;
+            for (uint32_t j = 0; j < swapchainImages[i].size(); j++)
+            {
+                for (uint32_t k = 0; k < depthImageCount; k++)
+                {
+                    const uint32_t index = (i * frameBufferInfo.stride + j) * frameBufferInfo.depthStride + k;
+                    frameBufferInfo.frameBuffers[index] = target.frameBuffer;
+                    for (uint32_t l = 0; l < swapchain.arraySize; l++)
+                    {
+                        const GLuint frameBuffer = CreateResolveFrameBuffer(swapchainImages[i][j].image,
+                                                                            depthSwapchains ? depthSwapchainImages[i][k].image : 0,
+                                                                            depthFormat->attachment, swapchain.arraySize, l);
+                        if (!frameBuffer)
+                        {
+                            return false;
+                        }
+                        frameBufferInfo.resolveFrameBuffers[index * frameBufferInfo.layerCount + l] = frameBuffer;
+                    }
+                }
+            }
+            continue;
+        }
+
+        if (depthSwapchains)
+        {
+            for (uint32_t j = 0; j < swapchainImages[i].size(); j++)
+            {
+                for (uint32_t k = 0; k < depthSwapchainImages[i].size(); k++)
+                {
+                    const GLuint frameBuffer = CreateFrameBuffer(stereoMode, swapchainImages[i][j].image,
+                                                                 depthSwapchainImages[i][k].image, false,
+                                                                 depthFormat->attachment, swapchain.arraySize,
+                                                                 imageSamples, false);
+                    if (!frameBuffer)
+                    {
+                        return false;
+                    }
+                    frameBufferInfo.frameBuffers[(i * frameBufferInfo.stride + j) * frameBufferInfo.depthStride + k] = frameBuffer;
+                }
+            }
+            continue;
+        }
+
+        for (uint32_t j = 0; j < swapchainImages[i].size(); j++)
+        {
+            const bool newDepth = depthPolicy == DEPTH_PER_IMAGE || (depthPolicy == DEPTH_PER_VIEW && j == 0) ||
+                                  (depthPolicy == DEPTH_SHARED && i == 0 && j == 0);
+            if (newDepth)
+            {
+                const int32_t width = depthPolicy == DEPTH_SHARED ? sharedWidth : swapchain.width;
+                const int32_t height = depthPolicy == DEPTH_SHARED ? sharedHeight : swapchain.height;
+                if (layered)
+                {
+                    depthBuffer = CreateDepthTexture(width, height, swapchain.arraySize, depthFormat, drawSamples);
+                    frameBufferInfo.depthTextures.push_back(depthBuffer);
+                }
+                else
+                {
+                    depthBuffer = CreateDepthRenderbuffer(width, height, depthFormat, drawSamples);
+                    frameBufferInfo.depthRenderbuffers.push_back(depthBuffer);
+                }
+                depthBytes += (uint64_t)width * height * swapchain.arraySize * drawSamples * depthFormat->bytesPerPixel;
+            }
+
+            const GLuint frameBuffer = CreateFrameBuffer(stereoMode, swapchainImages[i][j].image, depthBuffer, !layered,
+                                                         depthFormat->attachment, swapchain.arraySize,
+                                                         drawSamples, renderToTexture);
+            if (!frameBuffer)
+            {
+                return false;
+            }
+            frameBufferInfo.frameBuffers[i * frameBufferInfo.stride + j] = frameBuffer;
+        }
+    }
+
+    if (depthSwapchains)
+    {
+        printf("swapchain memory: color %.1f MB in %u images, depth %.1f MB in %s depth swapchains\n",
+               colorBytes / (1024.0 * 1024.0), imageCount, depthBytes / (1024.0 * 1024.0), depthFormat->name);
+    }
+    else if (frameBufferInfo.resolve)
+    {
+        printf("swapchain memory: color %.1f MB in %u images\n", colorBytes / (1024.0 * 1024.0), imageCount);
+    }
+    else
+    {
+        const size_t depthCount = frameBufferInfo.depthTextures.size() + frameBufferInfo.depthRenderbuffers.size();
+        printf("swapchain memory: color %.1f MB in %u images, depth %.1f MB in %u %s buffers (%s)\n",
+               colorBytes / (1024.0 * 1024.0), imageCount,
+               depthBytes / (1024.0 * 1024.0), (uint32_t)depthCount, depthFormat->name, DepthPolicyToString(depthPolicy));
+    }
+    if (frameBufferInfo.resolve)
+    {
+        printf("msaa memory: %.1f MB in %u %ux color and %s targets\n", msaaBytes / (1024.0 * 1024.0),
+               (uint32_t)frameBufferInfo.msaaTargets.size(), samples, depthFormat->name);
+    }
+
+    return true;
+}
+
+// index into frameBuffers for the acquired images, depthImageIndex is 0 when depth is not submitted.
+static uint32_t GetFrameBufferIndex(const Context::FrameBufferInfo& frameBufferInfo, uint32_t swapchain,
+                                    uint32_t swapchainImageIndex, uint32_t depthImageIndex)
+{
+    return (swapchain * frameBufferInfo.stride + swapchainImageIndex) * frameBufferInfo.depthStride + depthImageIndex;
+}
+
+void DestroyFrameBuffers(Context::FrameBufferInfo& frameBufferInfo)
+{
+    // msaa targets are shared by all the images of their swapchain, so they are deleted once below.
+    if (!frameBufferInfo.resolve)
+    {
+        // unused slots are 0, which gl ignores.
+        glDeleteFramebuffers((GLsizei)frameBufferInfo.frameBuffers.size(), frameBufferInfo.frameBuffers.data());
+    }
+    glDeleteTextures((GLsizei)frameBufferInfo.depthTextures.size(), frameBufferInfo.depthTextures.data());
+    glDeleteRenderbuffers((GLsizei)frameBufferInfo.depthRenderbuffers.size(), frameBufferInfo.depthRenderbuffers.data());
+
+    glDeleteFramebuffers((GLsizei)frameBufferInfo.resolveFrameBuffers.size(), frameBufferInfo.resolveFrameBuffers.data());
+    for (auto& target : frameBufferInfo.msaaTargets)
+    {
+        const bool arrayTarget = target.readFrameBuffers.size() > 1;
+        if (arrayTarget)
+        {
+            glDeleteFramebuffers((GLsizei)target.readFrameBuffers.size(), target.readFrameBuffers.data());
+            glDeleteTextures(1, &target.colorBuffer);
+            glDeleteTextures(1, &target.depthBuffer);
+        }
+        else
+        {
+            glDeleteRenderbuffers(1, &target.colorBuffer);
+            glDeleteRenderbuffers(1, &target.depthBuffer);
+        }
+        glDeleteFramebuffers(1, &target.frameBuffer);
+    }
+    frameBufferInfo = Context::FrameBufferInfo();
+}
+
+static bool EnumerateSwapchainImages(XrInstance instance, XrSwapchain swapchain,
+                                     std::vector<XrSwapchainImageOpenGLKHR>& images)
+{
+    uint32_t swapchainLength;
+    XrResult result = xrEnumerateSwapchainImages(swapchain, 0, &swapchainLength, NULL);
+    if (!CheckResult(instance, result, "xrEnumerateSwapchainImages"))
+    {
+        return false;
+    }
+
+    images.resize(swapchainLength);
+    for (uint32_t j = 0; j < swapchainLength; j++)
+    {
+        images[j].type = XR_TYPE_SWAPCHAIN_IMAGE_OPENGL_KHR;
+        images[j].next = NULL;
+    }
+
+    result = xrEnumerateSwapchainImages(swapchain, swapchainLength, &swapchainLength,
+                                        (XrSwapchainImageBaseHeader*)(images.data()));
+    if (!CheckResult(instance, result, "xrEnumerateSwapchainImages"))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+// size of a view in the swapchain, enough for it to be rendered at up to maxScale of its recommended size.
+static uint32_t AllocatedViewSize(uint32_t recommended, float maxScale, uint32_t max)
+{
+    return std::min((uint32_t)ceilf(recommended * maxScale), std::max(max, recommended));
+}
+
+// size of a view rendered at scale of its recommended size, never more than was allocated for it.
+static int32_t ScaledViewSize(uint32_t recommended, float scale, int32_t allocated)
+{
+    const int32_t size = (int32_t)(recommended * scale + 0.5f);
+    return std::min(std::max(size, 1), allocated);
+}
+
+bool CreateSwapchains(XrInstance instance, XrSession session,
+                      const std::vector<XrViewConfigurationView>& viewConfigs, StereoMode stereoMode,
+                      const ColorFormatInfo* colorFormat, DepthPolicy depthPolicy,
+                      const DepthFormatInfo*& depthFormat, bool depthLayerEnabled,
+                      uint32_t& samples, MsaaMode& msaaMode, float maxResolutionScale,
+                      std::vector<Context::SwapchainInfo>& swapchains,
+                      std::vector<std::vector<XrSwapchainImageOpenGLKHR>>& swapchainImages,
+                      std::vector<Context::SwapchainInfo>& depthSwapchains,
+                      std::vector<std::vector<XrSwapchainImageOpenGLKHR>>& depthSwapchainImages,
+                      Context::FrameBufferInfo& frameBufferInfo)
+{
+    XrResult result;
     uint32_t swapchainFormatCount;
     result = xrEnumerateSwapchainFormats(session, 0, &swapchainFormatCount, NULL);
     if (!CheckResult(instance, result, "xrEnumerateSwapchainFormats"))
@@ -742,505 +1988,1945 @@ bool CreateSwapchains(XrInstance instance, XrSession session,
         return false;
     }
 
-    // TODO: pick a format.
-    int64_t swapchainFormatToUse = swapchainFormats[0];
+    // use the requested color format if the runtime supports it, otherwise the first supported one in COLOR_FORMATS.
+    const ColorFormatInfo* colorSwapchainFormat = NULL;
+    if (colorFormat && std::find(swapchainFormats.begin(), swapchainFormats.end(), (int64_t)colorFormat->internalFormat) != swapchainFormats.end())
+    {
+        colorSwapchainFormat = colorFormat;
+    }
+    for (uint32_t i = 0; i < NUM_COLOR_FORMATS && !colorSwapchainFormat; i++)
+    {
+        if (std::find(swapchainFormats.begin(), swapchainFormats.end(), (int64_t)COLOR_FORMATS[i].internalFormat) != swapchainFormats.end())
+        {
+            colorSwapchainFormat = &COLOR_FORMATS[i];
+        }
+    }
+    if (colorFormat && colorSwapchainFormat != colorFormat)
+    {
+        printf("Runtime doesn't support %s color swapchains\n", colorFormat->name);
+    }
 
-    std::vector<uint32_t> swapchainLengths(viewConfigs.size());
+    int64_t swapchainFormatToUse;
+    if (colorSwapchainFormat)
+    {
+        swapchainFormatToUse = colorSwapchainFormat->internalFormat;
+        printf("color format: %s, %u bytes per pixel\n", colorSwapchainFormat->name, colorSwapchainFormat->bytesPerPixel);
+    }
+    else
+    {
+        // none of ours, the runtime lists its preferred format first.
+        swapchainFormatToUse = swapchainFormats[0];
+        printf("color format: 0x%llx, assuming %u bytes per pixel\n", (unsigned long long)swapchainFormatToUse,
+               ColorFormatBytesPerPixel(swapchainFormatToUse));
+    }
 
-    swapchains.resize(viewConfigs.size());
+    // shaders output linear color, have gl encode it when the swapchain images are srgb.
+    glEnable(GL_FRAMEBUFFER_SRGB);
 
-    for (uint32_t i = 0; i < viewConfigs.size(); i++)
+    // depth submitted to the runtime has to come from a depth swapchain in a format it supports,
+    // prefer the requested format, otherwise the first one in DEPTH_FORMATS it has.
+    const DepthFormatInfo* depthSwapchainFormat = NULL;
+    if (depthLayerEnabled)
     {
-        XrSwapchainCreateInfo sci;
-        sci.type = XR_TYPE_SWAPCHAIN_CREATE_INFO;
-        sci.next = NULL;
-        sci.createFlags = 0;
-        sci.usageFlags = XR_SWAPCHAIN_USAGE_SAMPLED_BIT | XR_SWAPCHAIN_USAGE_COLOR_ATTACHMENT_BIT;
-        sci.format = swapchainFormatToUse;
-        sci.sampleCount = 1;
-        sci.width = viewConfigs[i].recommendedImageRectWidth;
-        sci.height = viewConfigs[i].recommendedImageRectHeight;
-        sci.faceCount = 1;
-        sci.arraySize = 1;
-        sci.mipCount = 1;
-
-        XrSwapchain swapchainHandle;
-        result = xrCreateSwapchain(session, &sci, &swapchainHandle);
-        if (!CheckResult(instance, result, "xrCreateSwapchain"))
+        if (std::find(swapchainFormats.begin(), swapchainFormats.end(), (int64_t)depthFormat->internalFormat) != swapchainFormats.end())
         {
-            return false;
+            depthSwapchainFormat = depthFormat;
+        }
+        for (uint32_t i = 0; i < NUM_DEPTH_FORMATS && !depthSwapchainFormat; i++)
+        {
+            if (std::find(swapchainFormats.begin(), swapchainFormats.end(), (int64_t)DEPTH_FORMATS[i].internalFormat) != swapchainFormats.end())
+            {
+                depthSwapchainFormat = &DEPTH_FORMATS[i];
+            }
+        }
+        if (!depthSwapchainFormat)
+        {
+            printf("Runtime has no depth swapchain formats, depth will not be submitted\n");
+        }
+        else if (depthSwapchainFormat != depthFormat)
+        {
+            printf("Runtime doesn't support %s depth swapchains, using %s\n", depthFormat->name, depthSwapchainFormat->name);
+            depthFormat = depthSwapchainFormat;
         }
+    }
 
-        swapchains[i].handle = swapchainHandle;
-        swapchains[i].width = sci.width;
+    // msaa, 0 samples asks for the runtime's recommended count.
+    uint32_t maxSwapchainSamples = viewConfigs[0].maxSwapchainSampleCount;
+    for (auto& viewConfig : viewConfigs)
+    {
+        maxSwapchainSamples = std::min(maxSwapchainSamples, viewConfig.maxSwapchainSampleCount);
+    }
+    if (samples == 0)
+    {
+        samples = std::max(viewConfigs[0].recommendedSwapchainSampleCount, 1u);
+    }
+    GLint maxSamples = 1;
+    glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+    if (samples > (uint32_t)std::max(maxSamples, 1))
+    {
+        printf("%u samples requested, gl supports at most %d\n", samples, maxSamples);
+        samples = (uint32_t)std::max(maxSamples, 1);
+    }
+
+    if (samples > 1)
+    {
+        // prefer multisampled swapchains, so the runtime resolves, then an implicit resolve by the driver,
+        // which only works for 2d textures and never resolves depth, and then blitting ourselves.
+        const bool swapchainAllowed = samples <= maxSwapchainSamples;
+        const bool renderToTextureAllowed = GLEW_EXT_multisampled_render_to_texture && !depthSwapchainFormat &&
+                                            (stereoMode == STEREO_TWO_PASS || stereoMode == STEREO_DOUBLE_WIDE);
+        if ((msaaMode == MSAA_SWAPCHAIN && !swapchainAllowed) || (msaaMode == MSAA_RENDER_TO_TEXTURE && !renderToTextureAllowed))
+        {
+            printf("msaa mode %s can't be used with %u samples\n", MsaaModeToString(msaaMode), samples);
+            msaaMode = MSAA_AUTO;
+        }
+        if (msaaMode == MSAA_AUTO)
+        {
+            msaaMode = swapchainAllowed ? MSAA_SWAPCHAIN : renderToTextureAllowed ? MSAA_RENDER_TO_TEXTURE : MSAA_BLIT;
+        }
+        printf("msaa: %ux, resolved with %s\n", samples, MsaaModeToString(msaaMode));
+    }
+    else
+    {
+        msaaMode = MSAA_SWAPCHAIN;
+        printf("msaa: off\n");
+    }
+
+    // in the other modes, all views share one swapchain, side by side or with an array layer per view.
+    const uint32_t swapchainCount = stereoMode == STEREO_TWO_PASS ? (uint32_t)viewConfigs.size() : 1;
+
+    swapchains.resize(swapchainCount);
+    swapchainImages.resize(swapchainCount);
+    depthSwapchains.resize(depthSwapchainFormat ? swapchainCount : 0);
+    depthSwapchainImages.resize(depthSwapchainFormat ? swapchainCount : 0);
+
+    for (uint32_t i = 0; i < swapchainCount; i++)
+    {
+        XrSwapchainCreateInfo sci;
+        sci.type = XR_TYPE_SWAPCHAIN_CREATE_INFO;
+        sci.next = NULL;
+        sci.createFlags = 0;
+        sci.usageFlags = XR_SWAPCHAIN_USAGE_SAMPLED_BIT | XR_SWAPCHAIN_USAGE_COLOR_ATTACHMENT_BIT;
+        sci.format = swapchainFormatToUse;
+        sci.sampleCount = msaaMode == MSAA_SWAPCHAIN ? samples : 1;
+        sci.width = AllocatedViewSize(viewConfigs[i].recommendedImageRectWidth, maxResolutionScale,
+                                      viewConfigs[i].maxImageRectWidth);
+        sci.height = AllocatedViewSize(viewConfigs[i].recommendedImageRectHeight, maxResolutionScale,
+                                       viewConfigs[i].maxImageRectHeight);
+        sci.faceCount = 1;
+        sci.arraySize = 1;
+        sci.mipCount = 1;
+        if (stereoMode == STEREO_DOUBLE_WIDE)
+        {
+            // views are placed left to right, in the same order as their imageRects in RenderLayer.
+            for (uint32_t j = 1; j < viewConfigs.size(); j++)
+            {
+                sci.width += AllocatedViewSize(viewConfigs[j].recommendedImageRectWidth, maxResolutionScale,
+                                               viewConfigs[j].maxImageRectWidth);
+                sci.height = std::max(sci.height, AllocatedViewSize(viewConfigs[j].recommendedImageRectHeight,
+                                                                    maxResolutionScale, viewConfigs[j].maxImageRectHeight));
+            }
+        }
+        else if (stereoMode != STEREO_TWO_PASS)
+        {
+            // every layer has the same size, so use the largest recommended view.
+            for (uint32_t j = 1; j < viewConfigs.size(); j++)
+            {
+                sci.width = std::max(sci.width, AllocatedViewSize(viewConfigs[j].recommendedImageRectWidth,
+                                                                  maxResolutionScale, viewConfigs[j].maxImageRectWidth));
+                sci.height = std::max(sci.height, AllocatedViewSize(viewConfigs[j].recommendedImageRectHeight,
+                                                                    maxResolutionScale, viewConfigs[j].maxImageRectHeight));
+            }
+            sci.arraySize = (uint32_t)viewConfigs.size();
+        }
+
+        XrSwapchain swapchainHandle;
+        result = xrCreateSwapchain(session, &sci, &swapchainHandle);
+        if (!CheckResult(instance, result, "xrCreateSwapchain"))
+        {
+            return false;
+        }
+
+        swapchains[i].handle = swapchainHandle;
+        swapchains[i].format = sci.format;
+        swapchains[i].width = sci.width;
         swapchains[i].height = sci.height;
+        swapchains[i].arraySize = sci.arraySize;
+
+        if (!EnumerateSwapchainImages(instance, swapchains[i].handle, swapchainImages[i]))
+        {
+            return false;
+        }
+
+        if (depthSwapchainFormat)
+        {
+            // a matching depth swapchain, so every color subImage has a depth subImage at the same rect.
+            sci.usageFlags = XR_SWAPCHAIN_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+            sci.format = depthSwapchainFormat->internalFormat;
+            result = xrCreateSwapchain(session, &sci, &swapchainHandle);
+            if (!CheckResult(instance, result, "xrCreateSwapchain"))
+            {
+                return false;
+            }
+
+            depthSwapchains[i].handle = swapchainHandle;
+            depthSwapchains[i].format = sci.format;
+            depthSwapchains[i].width = sci.width;
+            depthSwapchains[i].height = sci.height;
+            depthSwapchains[i].arraySize = sci.arraySize;
+
+            if (!EnumerateSwapchainImages(instance, depthSwapchains[i].handle, depthSwapchainImages[i]))
+            {
+                return false;
+            }
+        }
+    }
+
+    if (!CreateFrameBuffers(stereoMode, depthPolicy, depthFormat, samples, msaaMode, swapchains, swapchainImages,
+                            depthSwapchainImages, frameBufferInfo))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+// allocates the target the foveation rings below full rate are drawn into, for views of up to viewWidth x viewHeight.
+// colorFormat and depthFormat match the swapchains, so rings can be blitted into their images.
+bool CreateFoveation(Context::FoveationInfo& foveationInfo, const FoveationRing* rings, uint32_t ringCount,
+                     int64_t colorFormat, const DepthFormatInfo* depthFormat, int32_t viewWidth, int32_t viewHeight,
+                     bool blitDepth)
+{
+    foveationInfo.ringCount = ringCount;
+    std::copy(rings, rings + ringCount, foveationInfo.rings);
+    foveationInfo.blitDepth = blitDepth;
+
+    // fraction of a full resolution view's pixels shaded, each ring only shades what the rings inside it don't cover.
+    float shaded = 0.0f;
+    float innerSize = 0.0f;
+    for (uint32_t i = 0; i < ringCount; i++)
+    {
+        shaded += (rings[i].size * rings[i].size - innerSize * innerSize) * rings[i].scale * rings[i].scale;
+        innerSize = rings[i].size;
+        if (rings[i].scale < 1.0f)
+        {
+            foveationInfo.width = std::max(foveationInfo.width, (int32_t)ceilf(viewWidth * rings[i].size * rings[i].scale));
+            foveationInfo.height = std::max(foveationInfo.height, (int32_t)ceilf(viewHeight * rings[i].size * rings[i].scale));
+        }
+    }
+    printf("foveation: %u rings, %.1f%% of each view's pixels shaded\n", ringCount, shaded * 100.0f);
+
+    // every ring at full rate, nothing to stretch.
+    if (foveationInfo.width == 0)
+    {
+        return true;
+    }
+
+    glGenRenderbuffers(1, &foveationInfo.colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, foveationInfo.colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, (GLenum)colorFormat, foveationInfo.width, foveationInfo.height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    foveationInfo.depthBuffer = CreateDepthRenderbuffer(foveationInfo.width, foveationInfo.height, depthFormat, 1);
+
+    GLuint frameBuffer;
+    glGenFramebuffers(1, &frameBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, foveationInfo.colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, depthFormat->attachment, GL_RENDERBUFFER, foveationInfo.depthBuffer);
+    foveationInfo.frameBuffer = CheckFrameBuffer(frameBuffer);
+    if (!foveationInfo.frameBuffer)
+    {
+        printf("Failed to create foveation target\n");
+        return false;
+    }
+
+    return true;
+}
+
+void DestroyFoveation(Context::FoveationInfo& foveationInfo)
+{
+    glDeleteFramebuffers(1, &foveationInfo.frameBuffer);
+    glDeleteRenderbuffers(1, &foveationInfo.colorBuffer);
+    glDeleteRenderbuffers(1, &foveationInfo.depthBuffer);
+    foveationInfo = Context::FoveationInfo();
+}
+
+bool BeginSession(XrInstance instance, XrSystemId systemId, XrSession session)
+{
+    XrResult result;
+    XrViewConfigurationType stereoViewConfigType = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO;
+    XrSessionBeginInfo sbi;
+    sbi.type = XR_TYPE_SESSION_BEGIN_INFO;
+    sbi.next = NULL;
+    sbi.primaryViewConfigurationType = stereoViewConfigType;
+
+    result = xrBeginSession(session, &sbi);
+    if (!CheckResult(instance, result, "xrBeginSession"))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+// where program binaries are kept unless --program-cache says otherwise, NULL if there is nowhere obvious.
+static std::string DefaultProgramCacheDir()
+{
+#if defined(WIN32)
+    const char* localAppData = getenv("LOCALAPPDATA");
+    return localAppData ? std::string(localAppData) + "\\openxrstub\\programs" : std::string();
+#else
+    const char* cacheHome = getenv("XDG_CACHE_HOME");
+    if (cacheHome && cacheHome[0])
+    {
+        return std::string(cacheHome) + "/openxrstub";
+    }
+    const char* home = getenv("HOME");
+    return home ? std::string(home) + "/.cache/openxrstub" : std::string();
+#endif
+}
+
+// makes the worker context current on the program cache's worker thread, or releases it.
+static void MakeWorkerContextCurrent(bool current, void* userData)
+{
+    SDL_GL_MakeCurrent(window, current ? workerContext : NULL);
+}
 
-        result = xrEnumerateSwapchainImages(swapchains[i].handle, 0, swapchainLengths.data() + i, NULL);
-        if (!CheckResult(instance, result, "xrEnumerateSwapchainImages"))
+// picks the requested stereo mode, or the next best one the gl implementation supports.
+StereoMode ChooseStereoMode(StereoMode requested)
+{
+    StereoMode stereoMode = requested;
+    if (stereoMode == STEREO_MULTIVIEW && !GLEW_OVR_multiview2)
+    {
+        printf("GL_OVR_multiview2 not supported, trying layered single pass\n");
+        stereoMode = STEREO_LAYERED;
+    }
+    if (stereoMode == STEREO_LAYERED && !GLEW_ARB_shader_viewport_layer_array && !GLEW_AMD_vertex_shader_layer)
+    {
+        printf("gl_Layer can't be written from a vertex shader, using two pass stereo\n");
+        stereoMode = STEREO_TWO_PASS;
+    }
+    printf("stereo mode: %s\n", StereoModeToString(stereoMode));
+    return stereoMode;
+}
+
+// picks the requested submit mode, or the next best one the gl implementation supports.  storageBuffer is set
+// when batched instance data can be in a shader storage buffer.
+SubmitMode ChooseSubmitMode(SubmitMode requested, bool& storageBuffer)
+{
+    SubmitMode submitMode = requested;
+    storageBuffer = GLEW_VERSION_4_3 || GLEW_ARB_shader_storage_buffer_object;
+    if (submitMode == SUBMIT_INDIRECT && !(storageBuffer && (GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect &&
+                                                                                   GLEW_ARB_base_instance))))
+    {
+        printf("glMultiDrawElementsIndirect with baseInstance not supported, using instanced draws\n");
+        submitMode = SUBMIT_INSTANCED;
+    }
+    if (submitMode == SUBMIT_INSTANCED && !GLEW_VERSION_3_3)
+    {
+        printf("instanced draws need gl 3.3, using direct draws\n");
+        submitMode = SUBMIT_DIRECT;
+    }
+    if (submitMode == SUBMIT_DIRECT)
+    {
+        printf("submit mode: direct\n");
+    }
+    else
+    {
+        printf("submit mode: %s, instances in a %s buffer\n", SubmitModeToString(submitMode),
+               storageBuffer ? "storage" : "uniform");
+    }
+    return submitMode;
+}
+
+// the sources of the scene program variant for the modes given.
+static void GetProgramSources(std::string& vertString, const char*& fragSource, StereoMode stereoMode,
+                              bool viewUniformBlock, SubmitMode submitMode, bool storageBuffer)
+{
+    const char* vertSource = R"_(
+uniform mat4 modelViewProjMat;
+uniform mat4 modelMat;
+attribute vec3 position;
+
+void main(void)
+{
+    gl_Position = modelViewProjMat * (modelMat * vec4(position, 1));
+}
+)_";
+
+    fragSource = R"_(
+uniform vec4 color;
+void main()
+{
+    gl_FragColor = color;
+}
+)_";
+
+    // single pass variants, VIEW_ID selects the view's matrix and, when layered, the array layer to draw into.
+    // also used for two pass rendering, with VIEW_ID 0, when the matrices are in a uniform block or objects are
+    // batched.
+    static const char* singlePassVertSource = R"_(
+#ifdef VIEW_UNIFORM_BLOCK
+layout(std140) uniform ViewBlock
+{
+    mat4 modelViewProjMat[2];
+    vec4 tanAngles[2];
+};
+#else
+uniform mat4 modelViewProjMat[2];
+#endif
+in vec3 position;
+
+#if defined(INSTANCE_STORAGE_BUFFER) || defined(INSTANCE_UNIFORM_BUFFER)
+struct Instance
+{
+    mat4 modelMat;
+    vec4 color;
+};
+#ifdef INSTANCE_STORAGE_BUFFER
+layout(std430) buffer InstanceBlock
+{
+    Instance instances[];
+};
+#else
+layout(std140) uniform InstanceBlock
+{
+    Instance instances[INSTANCE_CHUNK_SIZE];
+};
+#endif
+#ifdef INSTANCE_SLOT_ATTRIB
+in uint instanceSlot;
+#define INSTANCE_SLOT int(instanceSlot)
+#else
+uniform int instanceOffset;
+#define INSTANCE_SLOT (instanceOffset + gl_InstanceID / VIEW_INSTANCES)
+#endif
+flat out vec4 instanceColor;
+#else
+uniform mat4 modelMat;
+#endif
+
+void main(void)
+{
+#if defined(INSTANCE_STORAGE_BUFFER) || defined(INSTANCE_UNIFORM_BUFFER)
+    mat4 modelMat = instances[INSTANCE_SLOT].modelMat;
+    instanceColor = instances[INSTANCE_SLOT].color;
+#endif
+    gl_Position = modelViewProjMat[VIEW_ID] * (modelMat * vec4(position, 1));
+#ifdef WRITE_LAYER
+    gl_Layer = VIEW_ID;
+#endif
+}
+)_";
+
+    static const char* singlePassFragSource = R"_(#version 330
+uniform vec4 color;
+out vec4 fragColor;
+void main()
+{
+    fragColor = color;
+}
+)_";
+
+    static const char* instanceFragSource = R"_(#version 330
+flat in vec4 instanceColor;
+out vec4 fragColor;
+void main()
+{
+    fragColor = instanceColor;
+}
+)_";
+
+    vertString.clear();
+    if (stereoMode == STEREO_MULTIVIEW)
+    {
+        vertString = "#version 330\n"
+                     "#extension GL_OVR_multiview2 : require\n"
+                     "layout(num_views = 2) in;\n"
+                     "#define VIEW_ID int(gl_ViewID_OVR)\n";
+    }
+    else if (stereoMode == STEREO_LAYERED)
+    {
+        vertString = "#version 330\n";
+        vertString += GLEW_ARB_shader_viewport_layer_array ? "#extension GL_ARB_shader_viewport_layer_array : require\n" :
+                                                             "#extension GL_AMD_vertex_shader_layer : require\n";
+        vertString += "#define VIEW_INSTANCES 2\n"
+                      "#define VIEW_ID (gl_InstanceID % VIEW_INSTANCES)\n"
+                      "#define WRITE_LAYER\n";
+    }
+    else if (viewUniformBlock || submitMode != SUBMIT_DIRECT)
+    {
+        vertString = "#version 330\n"
+                     "#define VIEW_ID 0\n";
+    }
+
+    if (!vertString.empty())
+    {
+        if (viewUniformBlock)
+        {
+            vertString += "#define VIEW_UNIFORM_BLOCK\n";
+        }
+        if (submitMode != SUBMIT_DIRECT)
+        {
+            if (storageBuffer)
+            {
+                // extensions go before the multiview layout declaration, right after #version.
+                if (!GLEW_VERSION_4_3)
+                {
+                    vertString.insert(vertString.find('\n') + 1, "#extension GL_ARB_shader_storage_buffer_object : require\n");
+                }
+                vertString += "#define INSTANCE_STORAGE_BUFFER\n";
+            }
+            else
+            {
+                vertString += "#define INSTANCE_UNIFORM_BUFFER\n"
+                              "#define INSTANCE_CHUNK_SIZE " + std::to_string(INSTANCE_CHUNK_SIZE) + "\n";
+            }
+            if (submitMode == SUBMIT_INDIRECT)
+            {
+                vertString += "#define INSTANCE_SLOT_ATTRIB\n";
+            }
+            if (stereoMode != STEREO_LAYERED)
+            {
+                vertString += "#define VIEW_INSTANCES 1\n";
+            }
+        }
+        vertString += singlePassVertSource;
+        fragSource = submitMode != SUBMIT_DIRECT ? instanceFragSource : singlePassFragSource;
+    }
+    else
+    {
+        vertString = vertSource;
+    }
+}
+
+static const char* const SCENE_ATTRIB_NAMES[] = {"position", "instanceSlot"};
+
+// looks up the uniforms of a linked scene program and binds its blocks.
+static bool InitProgramInfo(Context::ProgramInfo& programInfo, GLuint program, bool viewUniformBlock,
+                            SubmitMode submitMode, bool storageBuffer)
+{
+    programInfo.program = (GLint)program;
+    programInfo.modelViewProjMatUniformLoc = glGetUniformLocation(programInfo.program, "modelViewProjMat");
+    programInfo.colorUniformLoc = glGetUniformLocation(programInfo.program, "color");
+
+    programInfo.viewUniformBlock = viewUniformBlock;
+    if (viewUniformBlock)
+    {
+        const GLuint blockIndex = glGetUniformBlockIndex(programInfo.program, "ViewBlock");
+        if (blockIndex == GL_INVALID_INDEX)
+        {
+            printf("Failed to find ViewBlock uniform block\n");
+            return false;
+        }
+        glUniformBlockBinding(programInfo.program, blockIndex, VIEW_UNIFORM_BINDING);
+    }
+
+    programInfo.submitMode = submitMode;
+    programInfo.modelMatUniformLoc = glGetUniformLocation(programInfo.program, "modelMat");
+    if (submitMode != SUBMIT_DIRECT)
+    {
+        const GLuint blockIndex = storageBuffer ?
+            glGetProgramResourceIndex(programInfo.program, GL_SHADER_STORAGE_BLOCK, "InstanceBlock") :
+            glGetUniformBlockIndex(programInfo.program, "InstanceBlock");
+        if (blockIndex == GL_INVALID_INDEX)
+        {
+            printf("Failed to find InstanceBlock\n");
+            return false;
+        }
+        if (storageBuffer)
+        {
+            glShaderStorageBlockBinding(programInfo.program, blockIndex, INSTANCE_BINDING);
+        }
+        else
+        {
+            glUniformBlockBinding(programInfo.program, blockIndex, INSTANCE_BINDING);
+        }
+        programInfo.instanceOffsetUniformLoc = glGetUniformLocation(programInfo.program, "instanceOffset");
+    }
+
+    return true;
+}
+
+static void BeginProgramLink(Context::PendingProgramInfo& linkInfo, StereoMode stereoMode, bool viewUniformBlock,
+                             SubmitMode submitMode, bool storageBuffer)
+{
+    std::string vertString;
+    const char* fragSource = NULL;
+    GetProgramSources(vertString, fragSource, stereoMode, viewUniformBlock, submitMode, storageBuffer);
+    linkInfo.viewUniformBlock = viewUniformBlock;
+    linkInfo.submitMode = submitMode;
+    linkInfo.storageBuffer = storageBuffer;
+    linkInfo.start = FrameStatsClock();
+    linkInfo.link = ProgramCacheLinkAsync(vertString.c_str(), fragSource, SCENE_ATTRIB_NAMES, 2);
+}
+
+// starts linking the program variant asked for, and the plain variant to draw with until it is ready, so both
+// link while the session is created.  WaitForProgram finishes the first before anything is drawn, and
+// UpdatePendingProgram swaps in the other once it is ready.  Only the one asked for is linked when they are the same
+// or nothing can be linked in the background, as the first.
+void BeginPrograms(Context::PendingProgramInfo& firstProgramInfo, Context::PendingProgramInfo& pendingProgramInfo,
+                   StereoMode stereoMode, bool viewUniformBlock, SubmitMode submitMode, bool storageBuffer)
+{
+    if ((!viewUniformBlock && submitMode == SUBMIT_DIRECT) || !ProgramCacheAsync())
+    {
+        BeginProgramLink(firstProgramInfo, stereoMode, viewUniformBlock, submitMode, storageBuffer);
+        return;
+    }
+    BeginProgramLink(firstProgramInfo, stereoMode, false, SUBMIT_DIRECT, false);
+    BeginProgramLink(pendingProgramInfo, stereoMode, viewUniformBlock, submitMode, storageBuffer);
+}
+
+// waits for the first program started by BeginPrograms.
+bool WaitForProgram(Context::ProgramInfo& programInfo, Context::PendingProgramInfo& firstProgramInfo)
+{
+    GLuint program = 0;
+    return ProgramCacheWait(firstProgramInfo.link, program) == PROGRAM_LINK_READY &&
+           InitProgramInfo(programInfo, program, firstProgramInfo.viewUniformBlock, firstProgramInfo.submitMode,
+                           firstProgramInfo.storageBuffer);
+}
+
+// swaps in the pending program once it is ready, call once per frame before drawing.  Returns false if it failed.
+bool UpdatePendingProgram(Context::ProgramInfo& programInfo, Context::PendingProgramInfo& pendingProgramInfo)
+{
+    if (!pendingProgramInfo.link)
+    {
+        return true;
+    }
+
+    GLuint program = 0;
+    const ProgramLinkStatus status = ProgramCachePoll(pendingProgramInfo.link, program);
+    if (status == PROGRAM_LINK_PENDING)
+    {
+        pendingProgramInfo.fallbackFrames++;
+        return true;
+    }
+
+    Context::ProgramInfo readyProgramInfo;
+    if (status == PROGRAM_LINK_FAILED ||
+        !InitProgramInfo(readyProgramInfo, program, pendingProgramInfo.viewUniformBlock, pendingProgramInfo.submitMode,
+                         pendingProgramInfo.storageBuffer))
+    {
+        printf("Failed to link the %s program in the background\n", SubmitModeToString(pendingProgramInfo.submitMode));
+        return false;
+    }
+    glDeleteProgram(programInfo.program);
+    programInfo = readyProgramInfo;
+    printf("%s program ready after %.2f ms, %u frames drawn with the fallback\n",
+           SubmitModeToString(pendingProgramInfo.submitMode),
+           (double)(FrameStatsClock() - pendingProgramInfo.start) / 1e6, pendingProgramInfo.fallbackFrames);
+    return true;
+}
+
+// a persistently mapped uniform buffer with NUM_UNIFORM_RING_SLOTS slots, each holding a ViewBlock of every view
+// followed by a ViewBlock per view.
+bool CreateUniformRing(Context::UniformRingInfo& uniformRingInfo)
+{
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    alignment = std::max(alignment, 1);
+    uniformRingInfo.blockSize = ((sizeof(ViewBlock) + alignment - 1) / alignment) * alignment;
+    uniformRingInfo.slotSize = uniformRingInfo.blockSize * (1 + MAX_STEREO_VIEWS);
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    const GLsizeiptr size = uniformRingInfo.slotSize * NUM_UNIFORM_RING_SLOTS;
+    glGenBuffers(1, &uniformRingInfo.buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, uniformRingInfo.buffer);
+    glBufferStorage(GL_UNIFORM_BUFFER, size, NULL, flags);
+    uniformRingInfo.mapped = (uint8_t*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, flags);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    if (!uniformRingInfo.mapped || glGetError() != GL_NO_ERROR)
+    {
+        printf("Failed to create uniform ring buffer\n");
+        return false;
+    }
+
+    return true;
+}
+
+void DestroyUniformRing(Context::UniformRingInfo& uniformRingInfo)
+{
+    for (uint32_t i = 0; i < NUM_UNIFORM_RING_SLOTS; i++)
+    {
+        if (uniformRingInfo.fences[i])
+        {
+            glDeleteSync(uniformRingInfo.fences[i]);
+        }
+    }
+    if (uniformRingInfo.buffer)
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, uniformRingInfo.buffer);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glDeleteBuffers(1, &uniformRingInfo.buffer);
+    }
+    uniformRingInfo = Context::UniformRingInfo();
+}
+
+// Original 1968 "Sword of Damocles" Room
+// https://youtu.be/LZCx0yH9gLM?t=4711
+static const float radius = 1.5f;
+static const float portalRadius = radius / 3.0f;
+static const int NUM_ROOM_VERTICES = 54;
+static const float roomPositions[NUM_ROOM_VERTICES * 3] = {
+    // room bounds
+    radius, 0.0f, radius,
+    radius, 0.0f, -radius,
+    -radius, 0.0f, -radius,
+    -radius, 0.0f, radius,
+
+    radius, 2.0f * radius, radius,
+    radius, 2.0f * radius, -radius,
+    -radius, 2.0f * radius, -radius,
+    -radius, 2.0f * radius, radius,
+
+    // north protal
+    portalRadius, radius + portalRadius, -radius,
+    -portalRadius, radius + portalRadius, -radius,
+    -portalRadius, radius - portalRadius, -radius,
+    portalRadius, radius - portalRadius, -radius,
+
+    // south protal
+    portalRadius, radius + portalRadius, radius,
+    -portalRadius, radius + portalRadius, radius,
+    -portalRadius, radius - portalRadius, radius,
+    portalRadius, radius - portalRadius, radius,
+
+    // east portal
+    radius, radius + portalRadius, portalRadius,
+    radius, radius + portalRadius, -portalRadius,
+    radius, radius - portalRadius, -portalRadius,
+    radius, radius - portalRadius, portalRadius,
+
+    // west door
+    -radius, radius + portalRadius, portalRadius,
+    -radius, radius + portalRadius, -portalRadius,
+    -radius, 0.0f, -portalRadius,
+    -radius, 0.0f, portalRadius,
+
+    // letter n
+    portalRadius / 4.0f, radius + (portalRadius / 2.0f), -radius * 0.9f,
+    -portalRadius / 4.0f, radius + (portalRadius / 2.0f), -radius * 0.9f,
+    -portalRadius / 4.0f, radius - (portalRadius / 2.0f), -radius * 0.9f,
+    portalRadius / 4.0f, radius - (portalRadius / 2.0f), -radius * 0.9f,
+
+    // letter s
+    -portalRadius / 4.0f, radius + (portalRadius / 2.0f), radius * 0.9f,
+    portalRadius / 4.0f, radius + (portalRadius / 2.0f), radius * 0.9f,
+    portalRadius / 4.0f, radius, radius * 0.9f,
+    -portalRadius / 4.0f, radius, radius * 0.9f,
+    -portalRadius / 4.0f, radius - (portalRadius / 2.0f), radius * 0.9f,
+    portalRadius / 4.0f, radius - (portalRadius / 2.0f), radius * 0.9f,
+
+    // letter e
+    radius * 0.9f, radius + (portalRadius / 2.0f), portalRadius / 4.0f,
+    radius * 0.9f, radius + (portalRadius / 2.0f), -portalRadius / 4.0f,
+    radius * 0.9f, radius, portalRadius / 4.0f,
+    radius * 0.9f, radius, -portalRadius / 4.0f,
+    radius * 0.9f, radius - (portalRadius / 2.0f), portalRadius / 4.0f,
+    radius * 0.9f, radius - (portalRadius / 2.0f), -portalRadius / 4.0f,
+
+    // letter w
+    -radius * 0.9f, radius + (portalRadius / 2.0f), -portalRadius / 3.0f,
+    -radius * 0.9f, radius + (portalRadius / 2.0f), portalRadius / 3.0f,
+    -radius * 0.9f, radius, 0.0f,
+    -radius * 0.9f, radius - (portalRadius / 2.0f), -portalRadius / 6.0f,
+    -radius * 0.9f, radius - (portalRadius / 2.0f), portalRadius / 6.0f,
+
+    // letter f
+    portalRadius / 6.0f, 0.0f, -radius * 0.9f,
+    -portalRadius / 6.0f, 0.0f, -radius * 0.9f,
+    portalRadius / 6.0f, 0.0f, -radius * 0.8f,
+    -portalRadius / 6.0f, 0.0f, -radius * 0.8f,
+    -portalRadius / 6.0f, 0.0f, -radius * 0.7f,
+
+    // letter c
+    portalRadius / 6.0f, 2.0f * radius, -radius * 0.9f,
+    -portalRadius / 6.0f, 2.0f * radius, -radius * 0.9f,
+    portalRadius / 6.0f, 2.0f * radius, -radius * 0.7f,
+    -portalRadius / 6.0f, 2.0f * radius, -radius * 0.7f,
+};
+
+static const int NUM_ROOM_INDICES = 104;
+static const uint16_t roomIndices[NUM_ROOM_INDICES] = {
+    0, 1, 1, 2, 2, 3, 3, 0,  // room
+    0, 4, 1, 5, 2, 6, 3, 7,
+    4, 5, 5, 6, 6, 7, 7, 4,
+    8, 9, 9, 10, 10, 11, 11, 8, // north portal
+    12, 13, 13, 14, 14, 15, 15, 12, // south portal
+    16, 17, 17, 18, 18, 19, 19, 16, // east portal
+    20, 21, 21, 22, 22, 23, 23, 20, // west door
+    24, 27, 27, 25, 25, 26,  // letter n
+    28, 29, 29, 30, 30, 31, 31, 32, 32, 33, // letter s
+    34, 35, 36, 37, 38, 39, 35, 37, 37, 39, // letter e
+    40, 43, 43, 42, 42, 44, 44, 41, // letter w
+    45, 46, 47, 48, 46, 48, 48, 49, // letter f
+    50, 51, 51, 53, 53, 52 // letter c
+};
+
+// the room as a scene of one green wireframe mesh, pointing at the arrays above.
+static void InitRoomScene(Scene& scene)
+{
+    static SceneFileMesh roomMesh;
+    roomMesh.primitive = SCENE_LINES;
+    roomMesh.baseVertex = 0;
+    roomMesh.vertexCount = NUM_ROOM_VERTICES;
+    roomMesh.firstIndex = 0;
+    roomMesh.indexCount = NUM_ROOM_INDICES;
+    const float green[4] = {0.0f, 1.0f, 0.0f, 1.0f};
+    memcpy(roomMesh.color, green, sizeof(green));
+    SceneComputeBounds(roomPositions, NUM_ROOM_VERTICES, roomMesh.boundsMin, roomMesh.boundsMax);
+
+    scene = Scene();
+    scene.meshes = &roomMesh;
+    scene.meshCount = 1;
+    scene.positions = roomPositions;
+    scene.vertexCount = NUM_ROOM_VERTICES;
+    scene.indices = roomIndices;
+    scene.indexCount = NUM_ROOM_INDICES;
+    scene.indexSize = sizeof(roomIndices[0]);
+}
+
+bool CreateGeometry(Context::GeometryInfo& geometryInfo, const Scene& scene)
+{
+    // upload the scene once, straight from its arrays, RenderView only binds the vao and draws.
+    glGenVertexArrays(1, &geometryInfo.vao);
+    glBindVertexArray(geometryInfo.vao);
+
+    glGenBuffers(1, &geometryInfo.vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, geometryInfo.vbo);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(scene.vertexCount * 3 * sizeof(float)), scene.positions, GL_STATIC_DRAW);
+    glVertexAttribPointer(POSITION_ATTRIB_LOC, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(POSITION_ATTRIB_LOC);
+
+    glGenBuffers(1, &geometryInfo.ibo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometryInfo.ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)(scene.indexCount * scene.indexSize), scene.indices, GL_STATIC_DRAW);
+    geometryInfo.indexType = scene.indexSize == 4 ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+
+    // unbind the vao first, so the element buffer binding stays with it.
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    if (glGetError() != GL_NO_ERROR)
+    {
+        printf("Failed to create geometry buffers\n");
+        return false;
+    }
+
+    geometryInfo.draws.resize(scene.meshCount);
+    for (uint32_t i = 0; i < scene.meshCount; i++)
+    {
+        const SceneFileMesh& mesh = scene.meshes[i];
+        Context::GeometryInfo::MeshDraw& draw = geometryInfo.draws[i];
+        draw.mode = mesh.primitive == SCENE_TRIANGLES ? GL_TRIANGLES : GL_LINES;
+        draw.indexCount = (GLsizei)mesh.indexCount;
+        draw.firstIndex = (GLuint)mesh.firstIndex;
+        draw.indexOffset = (const void*)((uintptr_t)mesh.firstIndex * scene.indexSize);
+        draw.baseVertex = (GLint)mesh.baseVertex;
+        memcpy(draw.color, mesh.color, sizeof(draw.color));
+    }
+
+    return true;
+}
+
+// places the scene's meshes, each once where the scene put it, or for a stress test, stressInstances objects on a
+// grid around the viewer, each a scaled down mesh of the scene in turn.
+void CreateObjects(Context::GeometryInfo& geometryInfo, const Scene& scene, uint32_t stressInstances)
+{
+    static const float identity[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+    geometryInfo.objects.clear();
+    if (stressInstances == 0)
+    {
+        geometryInfo.objects.resize(scene.meshCount);
+        for (uint32_t i = 0; i < scene.meshCount; i++)
+        {
+            Context::GeometryInfo::Object& object = geometryInfo.objects[i];
+            object.mesh = i;
+            memcpy(object.modelMat, identity, sizeof(identity));
+            memcpy(object.color, scene.meshes[i].color, sizeof(object.color));
+        }
+        return;
+    }
+
+    // one scale for every mesh, so they keep their sizes relative to each other.
+    float extent = 0.0f;
+    for (uint32_t i = 0; i < scene.meshCount; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            extent = std::max(extent, scene.meshes[i].boundsMax[j] - scene.meshes[i].boundsMin[j]);
+        }
+    }
+    const float scale = extent > 0.0f ? STRESS_INSTANCE_SIZE / extent : 1.0f;
+    const uint32_t gridSize = (uint32_t)ceilf(sqrtf((float)stressInstances));
+
+    geometryInfo.objects.resize(stressInstances);
+    for (uint32_t i = 0; i < stressInstances; i++)
+    {
+        Context::GeometryInfo::Object& object = geometryInfo.objects[i];
+        object.mesh = i % scene.meshCount;
+        const SceneFileMesh& mesh = scene.meshes[object.mesh];
+
+        // centered on its cell, standing on the floor.
+        const float x = ((float)(i % gridSize) - 0.5f * (float)(gridSize - 1)) * STRESS_INSTANCE_SPACING;
+        const float z = ((float)(i / gridSize) - 0.5f * (float)(gridSize - 1)) * STRESS_INSTANCE_SPACING;
+        memcpy(object.modelMat, identity, sizeof(identity));
+        object.modelMat[0] = object.modelMat[5] = object.modelMat[10] = scale;
+        object.modelMat[12] = x - 0.5f * (mesh.boundsMin[0] + mesh.boundsMax[0]) * scale;
+        object.modelMat[13] = -mesh.boundsMin[1] * scale;
+        object.modelMat[14] = z - 0.5f * (mesh.boundsMin[2] + mesh.boundsMax[2]) * scale;
+
+        // a hue per object, so neighbours can be told apart.
+        const float hue = (float)(i % 7) / 7.0f * 6.0f;
+        object.color[0] = std::min(std::max(fabsf(hue - 3.0f) - 1.0f, 0.0f), 1.0f);
+        object.color[1] = std::min(std::max(2.0f - fabsf(hue - 2.0f), 0.0f), 1.0f);
+        object.color[2] = std::min(std::max(2.0f - fabsf(hue - 4.0f), 0.0f), 1.0f);
+        object.color[3] = 1.0f;
+    }
+}
+
+// buffers for batched submission of up to every object at once, and the order meshes are drawn in.
+bool CreateBatch(Context::GeometryInfo& geometryInfo, SubmitMode submitMode, bool storageBuffer,
+                 uint32_t viewInstances)
+{
+    Context::GeometryInfo::BatchInfo& batchInfo = geometryInfo.batchInfo;
+    geometryInfo.submitMode = submitMode;
+    if (submitMode == SUBMIT_DIRECT)
+    {
+        return true;
+    }
+    batchInfo.storageBuffer = storageBuffer;
+    batchInfo.viewInstances = viewInstances;
+
+    // uniform buffer chunks are bound at offsets that are multiples of both the instance size and the alignment,
+    // and hold a chunk more, so a chunk bound at the last instance still fits.
+    const uint32_t objectCount = (uint32_t)geometryInfo.objects.size();
+    const GLenum target = storageBuffer ? GL_SHADER_STORAGE_BUFFER : GL_UNIFORM_BUFFER;
+    uint32_t capacity = objectCount;
+    if (!storageBuffer)
+    {
+        GLint alignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        alignment = std::max(alignment, 1);
+        GLint a = alignment, b = (GLint)sizeof(Context::GeometryInfo::Instance);
+        while (b != 0)
+        {
+            const GLint r = a % b;
+            a = b;
+            b = r;
+        }
+        batchInfo.chunkAlignment = (uint32_t)(alignment / a);
+        if (batchInfo.chunkAlignment >= INSTANCE_CHUNK_SIZE)
+        {
+            printf("GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT of %d is too large for instance chunks\n", alignment);
+            return false;
+        }
+        capacity += INSTANCE_CHUNK_SIZE;
+    }
+    batchInfo.instanceBufferSize = (GLsizeiptr)capacity * sizeof(Context::GeometryInfo::Instance);
+    glGenBuffers(1, &batchInfo.instanceBuffer);
+    glBindBuffer(target, batchInfo.instanceBuffer);
+    glBufferData(target, batchInfo.instanceBufferSize, NULL, GL_STREAM_DRAW);
+    glBindBuffer(target, 0);
+
+    if (submitMode == SUBMIT_INDIRECT)
+    {
+        glGenBuffers(1, &batchInfo.commandBuffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batchInfo.commandBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, geometryInfo.draws.size() * sizeof(DrawElementsIndirectCommand), NULL,
+                     GL_STREAM_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+        // a command's instances read slots from its baseInstance on, each slot once per view instance.
+        std::vector<GLuint> slots(objectCount);
+        for (uint32_t i = 0; i < objectCount; i++)
+        {
+            slots[i] = i;
+        }
+        glBindVertexArray(geometryInfo.vao);
+        glGenBuffers(1, &batchInfo.slotBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, batchInfo.slotBuffer);
+        glBufferData(GL_ARRAY_BUFFER, slots.size() * sizeof(GLuint), slots.data(), GL_STATIC_DRAW);
+        glVertexAttribIPointer(INSTANCE_SLOT_ATTRIB_LOC, 1, GL_UNSIGNED_INT, 0, 0);
+        glVertexAttribDivisor(INSTANCE_SLOT_ATTRIB_LOC, viewInstances);
+        glEnableVertexAttribArray(INSTANCE_SLOT_ATTRIB_LOC);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    batchInfo.meshOrder.clear();
+    for (int lines = 1; lines >= 0; lines--)
+    {
+        for (uint32_t i = 0; i < (uint32_t)geometryInfo.draws.size(); i++)
+        {
+            if ((geometryInfo.draws[i].mode == GL_LINES) == (lines == 1))
+            {
+                batchInfo.meshOrder.push_back(i);
+            }
+        }
+    }
+    batchInfo.meshFirst.resize(geometryInfo.draws.size());
+    batchInfo.instances.reserve(objectCount);
+    batchInfo.groups.reserve(geometryInfo.draws.size());
+    batchInfo.commands.reserve(geometryInfo.draws.size());
+
+    if (glGetError() != GL_NO_ERROR)
+    {
+        printf("Failed to create batch buffers\n");
+        return false;
+    }
+    return true;
+}
+
+// gathers the objects in drawList, or all of them if it is NULL, into instances grouped by mesh, and uploads them
+// along with a draw command per group.  Called once per frame, every view draws the same batch.
+static void BuildBatch(Context::GeometryInfo& geometryInfo, const std::vector<uint32_t>* drawList)
+{
+    Context::GeometryInfo::BatchInfo& batchInfo = geometryInfo.batchInfo;
+    const uint32_t objectCount = drawList ? (uint32_t)drawList->size() : (uint32_t)geometryInfo.objects.size();
+
+    // a counting sort by mesh, meshFirst ends up at the first instance after each mesh's group.
+    std::fill(batchInfo.meshFirst.begin(), batchInfo.meshFirst.end(), 0);
+    for (uint32_t i = 0; i < objectCount; i++)
+    {
+        batchInfo.meshFirst[geometryInfo.objects[drawList ? (*drawList)[i] : i].mesh]++;
+    }
+    batchInfo.groups.clear();
+    batchInfo.lineGroupCount = 0;
+    uint32_t first = 0;
+    for (uint32_t mesh : batchInfo.meshOrder)
+    {
+        const uint32_t count = batchInfo.meshFirst[mesh];
+        batchInfo.meshFirst[mesh] = first;
+        if (count > 0)
+        {
+            batchInfo.groups.push_back({mesh, first, count});
+            batchInfo.lineGroupCount += geometryInfo.draws[mesh].mode == GL_LINES ? 1 : 0;
+        }
+        first += count;
+    }
+    batchInfo.instances.resize(objectCount);
+    for (uint32_t i = 0; i < objectCount; i++)
+    {
+        const Context::GeometryInfo::Object& object = geometryInfo.objects[drawList ? (*drawList)[i] : i];
+        Context::GeometryInfo::Instance& instance = batchInfo.instances[batchInfo.meshFirst[object.mesh]++];
+        memcpy(instance.modelMat, object.modelMat, sizeof(instance.modelMat));
+        memcpy(instance.color, object.color, sizeof(instance.color));
+    }
+
+    // orphaned each frame, so the driver hands out new storage rather than wait for last frame's draws.
+    const GLenum target = batchInfo.storageBuffer ? GL_SHADER_STORAGE_BUFFER : GL_UNIFORM_BUFFER;
+    glBindBuffer(target, batchInfo.instanceBuffer);
+    glBufferData(target, batchInfo.instanceBufferSize, NULL, GL_STREAM_DRAW);
+    glBufferSubData(target, 0, objectCount * sizeof(Context::GeometryInfo::Instance), batchInfo.instances.data());
+    glBindBuffer(target, 0);
+
+    if (geometryInfo.submitMode == SUBMIT_INDIRECT)
+    {
+        batchInfo.commands.clear();
+        for (const Context::GeometryInfo::BatchInfo::Group& group : batchInfo.groups)
+        {
+            const Context::GeometryInfo::MeshDraw& draw = geometryInfo.draws[group.mesh];
+            batchInfo.commands.push_back({(GLuint)draw.indexCount, group.instanceCount * batchInfo.viewInstances,
+                                          draw.firstIndex, draw.baseVertex, group.firstInstance});
+        }
+        const GLsizeiptr size = (GLsizeiptr)(batchInfo.commands.size() * sizeof(DrawElementsIndirectCommand));
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batchInfo.commandBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, geometryInfo.draws.size() * sizeof(DrawElementsIndirectCommand), NULL,
+                     GL_STREAM_DRAW);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, size, batchInfo.commands.data());
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+}
+
+// draws this frame's batch, with a multi draw per primitive type, or an instanced draw per mesh, or more when the
+// instances are in a uniform buffer and a mesh has more of them than a chunk holds.
+static void DrawBatch(const Context::ProgramInfo& programInfo, const Context::GeometryInfo& geometryInfo)
+{
+    const Context::GeometryInfo::BatchInfo& batchInfo = geometryInfo.batchInfo;
+    uint32_t drawCalls = 0;
+    glBindVertexArray(geometryInfo.vao);
+    if (batchInfo.storageBuffer)
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, batchInfo.instanceBuffer);
+    }
+
+    if (programInfo.submitMode == SUBMIT_INDIRECT)
+    {
+        const GLsizei lineCount = (GLsizei)batchInfo.lineGroupCount;
+        const GLsizei triangleCount = (GLsizei)batchInfo.groups.size() - lineCount;
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batchInfo.commandBuffer);
+        if (lineCount > 0)
+        {
+            glMultiDrawElementsIndirect(GL_LINES, geometryInfo.indexType, 0, lineCount, 0);
+            drawCalls++;
+        }
+        if (triangleCount > 0)
+        {
+            glMultiDrawElementsIndirect(GL_TRIANGLES, geometryInfo.indexType,
+                                        (const void*)(lineCount * sizeof(DrawElementsIndirectCommand)), triangleCount, 0);
+            drawCalls++;
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+    else
+    {
+        const uint32_t chunkCount = INSTANCE_CHUNK_SIZE - (batchInfo.chunkAlignment - 1);
+        for (const Context::GeometryInfo::BatchInfo::Group& group : batchInfo.groups)
+        {
+            const Context::GeometryInfo::MeshDraw& draw = geometryInfo.draws[group.mesh];
+            uint32_t first = group.firstInstance;
+            const uint32_t end = group.firstInstance + group.instanceCount;
+            while (first < end)
+            {
+                uint32_t count = end - first;
+                GLint offset = (GLint)first;
+                if (!batchInfo.storageBuffer)
+                {
+                    const uint32_t chunkFirst = first - first % batchInfo.chunkAlignment;
+                    count = std::min(count, chunkCount);
+                    offset = (GLint)(first - chunkFirst);
+                    glBindBufferRange(GL_UNIFORM_BUFFER, INSTANCE_BINDING, batchInfo.instanceBuffer,
+                                      chunkFirst * sizeof(Context::GeometryInfo::Instance),
+                                      INSTANCE_CHUNK_SIZE * sizeof(Context::GeometryInfo::Instance));
+                }
+                glUniform1i(programInfo.instanceOffsetUniformLoc, offset);
+                glDrawElementsInstancedBaseVertex(draw.mode, draw.indexCount, geometryInfo.indexType, draw.indexOffset,
+                                                  (GLsizei)(count * batchInfo.viewInstances), draw.baseVertex);
+                drawCalls++;
+                first += count;
+            }
+        }
+    }
+    glBindVertexArray(0);
+    FrameStatsAddCount(COUNTER_DRAW_CALLS, drawCalls);
+}
+
+// draws the objects in drawList, or all of them if it is NULL, with the bound program.
+// instanceCount > 0 draws them instanced for layered stereo.  The batched submit modes draw this frame's batch
+// instead, whatever the list.
+static void DrawGeometry(const Context::ProgramInfo& programInfo, const Context::GeometryInfo& geometryInfo,
+                         const std::vector<uint32_t>* drawList, GLsizei instanceCount)
+{
+    if (programInfo.submitMode != SUBMIT_DIRECT)
+    {
+        DrawBatch(programInfo, geometryInfo);
+        return;
+    }
+
+    glBindVertexArray(geometryInfo.vao);
+    const uint32_t objectCount = drawList ? (uint32_t)drawList->size() : (uint32_t)geometryInfo.objects.size();
+    for (uint32_t i = 0; i < objectCount; i++)
+    {
+        const Context::GeometryInfo::Object& object = geometryInfo.objects[drawList ? (*drawList)[i] : i];
+        const Context::GeometryInfo::MeshDraw& draw = geometryInfo.draws[object.mesh];
+        glUniformMatrix4fv(programInfo.modelMatUniformLoc, 1, GL_FALSE, object.modelMat);
+        glUniform4fv(programInfo.colorUniformLoc, 1, object.color);
+        if (instanceCount > 0)
+        {
+            glDrawElementsInstancedBaseVertex(draw.mode, draw.indexCount, geometryInfo.indexType, draw.indexOffset,
+                                              instanceCount, draw.baseVertex);
+        }
+        else
+        {
+            glDrawElementsBaseVertex(draw.mode, draw.indexCount, geometryInfo.indexType, draw.indexOffset,
+                                     draw.baseVertex);
+        }
+    }
+    glBindVertexArray(0);
+    FrameStatsAddCount(COUNTER_DRAW_CALLS, objectCount);
+}
+
+void DestroyGeometry(Context::GeometryInfo& geometryInfo)
+{
+    glDeleteVertexArrays(1, &geometryInfo.vao);
+    glDeleteBuffers(1, &geometryInfo.vbo);
+    glDeleteBuffers(1, &geometryInfo.ibo);
+    glDeleteBuffers(1, &geometryInfo.batchInfo.instanceBuffer);
+    glDeleteBuffers(1, &geometryInfo.batchInfo.commandBuffer);
+    glDeleteBuffers(1, &geometryInfo.batchInfo.slotBuffer);
+    geometryInfo = Context::GeometryInfo();
+}
+
+// builds the hierarchy over the world bounds of the objects, once, they don't move.
+void CreateCulling(Context::CullInfo& cullInfo, const Context::GeometryInfo& geometryInfo, const Scene& scene)
+{
+    const uint32_t objectCount = (uint32_t)geometryInfo.objects.size();
+    std::vector<CullBox> boxes(objectCount);
+    for (uint32_t i = 0; i < objectCount; i++)
+    {
+        const Context::GeometryInfo::Object& object = geometryInfo.objects[i];
+        CullBox meshBox;
+        memcpy(meshBox.min, scene.meshes[object.mesh].boundsMin, sizeof(meshBox.min));
+        memcpy(meshBox.max, scene.meshes[object.mesh].boundsMax, sizeof(meshBox.max));
+        CullTransformBox(boxes[i], meshBox, object.modelMat);
+    }
+    CullBuildBvh(cullInfo.bvh, boxes.data(), objectCount);
+    cullInfo.candidates.reserve(objectCount);
+    for (auto& visible : cullInfo.visible)
+    {
+        visible.reserve(objectCount);
+    }
+}
+
+// culls the scene against all views at once, through the hierarchy, then the objects left against each view
+// when perView is set, for the modes that draw one view at a time.  Otherwise every pass draws what is inside
+// any view.
+static void CullViews(Context::CullInfo& cullInfo, StereoMode stereoMode, bool perView,
+                      const XrCompositionLayerProjectionView* layerViews, uint32_t viewCount)
+{
+    assert(viewCount <= MAX_STEREO_VIEWS);
+    CullFrustum frusta[MAX_STEREO_VIEWS];
+    for (uint32_t i = 0; i < viewCount; i++)
+    {
+        CullFrustumFromView(frusta[i], layerViews[i].pose, layerViews[i].fov, NEAR_Z, FAR_Z);
+    }
+    CullFrustum unionFrustum;
+    CullFrustumUnion(unionFrustum, frusta, viewCount);
+
+    uint32_t tested = 0;
+    cullInfo.candidates.clear();
+    CullBvhObjects(cullInfo.bvh, unionFrustum, cullInfo.candidates, tested);
+
+    const uint32_t objectCount = (uint32_t)cullInfo.bvh.boxes.size();
+    const uint32_t passes = stereoMode == STEREO_TWO_PASS || stereoMode == STEREO_DOUBLE_WIDE ? viewCount : 1;
+    uint32_t visible = 0;
+    uint32_t saved = 0;
+    if (passes > 1 && perView)
+    {
+        for (uint32_t i = 0; i < viewCount; i++)
+        {
+            cullInfo.visible[i].clear();
+            CullObjects(cullInfo.bvh, frusta[i], cullInfo.candidates, cullInfo.visible[i], tested);
+            visible += (uint32_t)cullInfo.visible[i].size();
+            saved += objectCount - (uint32_t)cullInfo.visible[i].size();
+        }
+    }
+    else
+    {
+        visible = (uint32_t)cullInfo.candidates.size() * passes;
+        saved = (objectCount - (uint32_t)cullInfo.candidates.size()) * passes;
+    }
+
+    FrameStatsAddCount(COUNTER_CULL_TESTED, tested);
+    FrameStatsAddCount(COUNTER_CULL_VISIBLE, visible);
+    FrameStatsAddCount(COUNTER_DRAWS_SAVED, saved);
+}
+
+bool CreateVisibilityMask(XrInstance instance, Context::VisibilityMaskInfo& visibilityMaskInfo, StereoMode stereoMode,
+                          bool viewUniformBlock)
+{
+    XrResult result = xrGetInstanceProcAddr(instance, "xrGetVisibilityMaskKHR",
+                                            (PFN_xrVoidFunction*)&visibilityMaskInfo.getVisibilityMask);
+    if (!CheckResult(instance, result, "xrGetInstanceProcAddr(xrGetVisibilityMaskKHR)"))
+    {
+        return false;
+    }
+
+    // every triangle is put on the near plane, so anything drawn after it fails the depth test.
+    // VIEW_ID is the view being drawn when all views are drawn at once, other views' triangles are moved out of clip space.
+    // views drawn one at a time only draw their own triangles, with their tangents in tanAngles[0].
+    static const char* maskVertSource = R"_(
+#ifdef VIEW_UNIFORM_BLOCK
+layout(std140) uniform ViewBlock
+{
+    mat4 modelViewProjMat[2];
+    vec4 tanAngles[2];
+};
+#else
+uniform vec4 tanAngles[2];  // left, right, down, up
+#endif
+in vec3 position;
+
+void main(void)
+{
+#ifdef VIEW_ID
+    int view = VIEW_ID;
+    if (int(position.z) != view)
+    {
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        return;
+    }
+#ifdef WRITE_LAYER
+    gl_Layer = view;
+#endif
+#else
+    int view = 0;
+#endif
+    vec4 t = tanAngles[view];
+    vec2 ndc = (2.0 * position.xy - (t.xz + t.yw)) / (t.yw - t.xz);
+    gl_Position = vec4(ndc, -1.0, 1.0);
+}
+)_";
+
+    // only depth is written.
+    static const char* maskFragSource = R"_(#version 330
+void main()
+{
+}
+)_";
+
+    std::string vertString = "#version 330\n";
+    if (stereoMode == STEREO_MULTIVIEW)
+    {
+        vertString += "#extension GL_OVR_multiview2 : require\n"
+                      "layout(num_views = 2) in;\n"
+                      "#define VIEW_ID int(gl_ViewID_OVR)\n";
+    }
+    else if (stereoMode == STEREO_LAYERED)
+    {
+        vertString += GLEW_ARB_shader_viewport_layer_array ? "#extension GL_ARB_shader_viewport_layer_array : require\n" :
+                                                             "#extension GL_AMD_vertex_shader_layer : require\n";
+        vertString += "#define VIEW_ID gl_InstanceID\n"
+                      "#define WRITE_LAYER\n";
+    }
+    if (viewUniformBlock)
+    {
+        vertString += "#define VIEW_UNIFORM_BLOCK\n";
+    }
+    vertString += maskVertSource;
+
+    const char* attribNames[] = {"position"};
+    visibilityMaskInfo.program = ProgramCacheLink(vertString.c_str(), maskFragSource, attribNames, 1);
+    if (!visibilityMaskInfo.program)
+    {
+        printf("Failed to create visibility mask program\n");
+        return false;
+    }
+    visibilityMaskInfo.viewUniformBlock = viewUniformBlock;
+    if (viewUniformBlock)
+    {
+        glUniformBlockBinding(visibilityMaskInfo.program,
+                              glGetUniformBlockIndex(visibilityMaskInfo.program, "ViewBlock"), VIEW_UNIFORM_BINDING);
+    }
+    else
+    {
+        visibilityMaskInfo.tanAnglesUniformLoc = glGetUniformLocation(visibilityMaskInfo.program, "tanAngles");
+    }
+
+    glGenVertexArrays(1, &visibilityMaskInfo.vao);
+    glBindVertexArray(visibilityMaskInfo.vao);
+    glGenBuffers(1, &visibilityMaskInfo.vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, visibilityMaskInfo.vbo);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(0);
+    glGenBuffers(1, &visibilityMaskInfo.ibo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, visibilityMaskInfo.ibo);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    if (glGetError() != GL_NO_ERROR)
+    {
+        printf("Failed to create visibility mask buffers\n");
+        return false;
+    }
+
+    return true;
+}
+
+// fetches the hidden triangle mesh of every view and uploads them, at startup and whenever the runtime says they changed.
+bool UpdateVisibilityMask(XrInstance instance, XrSession session, uint32_t viewCount,
+                          Context::VisibilityMaskInfo& visibilityMaskInfo)
+{
+    assert(viewCount <= MAX_STEREO_VIEWS);
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+    for (uint32_t i = 0; i < viewCount; i++)
+    {
+        XrVisibilityMaskKHR mask;
+        mask.type = XR_TYPE_VISIBILITY_MASK_KHR;
+        mask.next = NULL;
+        mask.vertexCapacityInput = 0;
+        mask.vertices = NULL;
+        mask.indexCapacityInput = 0;
+        mask.indices = NULL;
+        XrResult result = visibilityMaskInfo.getVisibilityMask(session, XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO, i,
+                                                               XR_VISIBILITY_MASK_TYPE_HIDDEN_TRIANGLE_MESH_KHR, &mask);
+        if (!CheckResult(instance, result, "xrGetVisibilityMaskKHR"))
+        {
+            return false;
+        }
+
+        std::vector<XrVector2f> maskVertices(mask.vertexCountOutput);
+        std::vector<uint32_t> maskIndices(mask.indexCountOutput);
+        if (!maskVertices.empty() && !maskIndices.empty())
+        {
+            mask.vertexCapacityInput = mask.vertexCountOutput;
+            mask.vertices = maskVertices.data();
+            mask.indexCapacityInput = mask.indexCountOutput;
+            mask.indices = maskIndices.data();
+            result = visibilityMaskInfo.getVisibilityMask(session, XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO, i,
+                                                          XR_VISIBILITY_MASK_TYPE_HIDDEN_TRIANGLE_MESH_KHR, &mask);
+            if (!CheckResult(instance, result, "xrGetVisibilityMaskKHR"))
+            {
+                return false;
+            }
+        }
+        else
         {
-            return false;
+            // no hidden area, this view is drawn in full.
+            maskIndices.clear();
         }
-    }
 
-    swapchainImages.resize(viewConfigs.size());
-    for (uint32_t i = 0; i < viewConfigs.size(); i++)
-    {
-        swapchainImages[i].resize(swapchainLengths[i]);
-        for (uint32_t j = 0; j < swapchainLengths[i]; j++)
+        const uint32_t baseVertex = (uint32_t)(vertices.size() / 3);
+        for (auto& v : maskVertices)
         {
-            swapchainImages[i][j].type = XR_TYPE_SWAPCHAIN_IMAGE_OPENGL_KHR;
-            swapchainImages[i][j].next = NULL;
+            vertices.push_back(v.x);
+            vertices.push_back(v.y);
+            vertices.push_back((float)i);
         }
-
-        result = xrEnumerateSwapchainImages(swapchains[i].handle, swapchainLengths[i], &swapchainLengths[i],
-                                            (XrSwapchainImageBaseHeader*)(swapchainImages[i].data()));
-        if (!CheckResult(instance, result, "xrEnumerateSwapchainImages"))
+        visibilityMaskInfo.firstIndex[i] = (GLsizei)indices.size();
+        visibilityMaskInfo.indexCount[i] = (GLsizei)maskIndices.size();
+        for (auto index : maskIndices)
         {
-            return false;
+            indices.push_back(baseVertex + index);
         }
     }
+    visibilityMaskInfo.totalIndexCount = (GLsizei)indices.size();
+
+    glBindBuffer(GL_ARRAY_BUFFER, visibilityMaskInfo.vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(visibilityMaskInfo.vao);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+
+    if (glGetError() != GL_NO_ERROR)
+    {
+        printf("Failed to upload visibility mask\n");
+        return false;
+    }
 
+    printf("visibility mask: %u hidden triangles\n", (uint32_t)indices.size() / 3);
     return true;
 }
 
-bool BeginSession(XrInstance instance, XrSystemId systemId, XrSession session)
+void DestroyVisibilityMask(Context::VisibilityMaskInfo& visibilityMaskInfo)
+{
+    if (visibilityMaskInfo.program)
+    {
+        glDeleteProgram(visibilityMaskInfo.program);
+    }
+    glDeleteVertexArrays(1, &visibilityMaskInfo.vao);
+    glDeleteBuffers(1, &visibilityMaskInfo.vbo);
+    glDeleteBuffers(1, &visibilityMaskInfo.ibo);
+    visibilityMaskInfo = Context::VisibilityMaskInfo();
+}
+
+bool SyncInput(XrInstance instance, XrSession session, XrActionSet actionSet)
 {
     XrResult result;
-    XrViewConfigurationType stereoViewConfigType = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO;
-    XrSessionBeginInfo sbi;
-    sbi.type = XR_TYPE_SESSION_BEGIN_INFO;
-    sbi.next = NULL;
-    sbi.primaryViewConfigurationType = stereoViewConfigType;
 
-    result = xrBeginSession(session, &sbi);
-    if (!CheckResult(instance, result, "xrBeginSession"))
+    // syncInput
+    XrActiveActionSet aas;
+    aas.actionSet = actionSet;
+    aas.subactionPath = XR_NULL_PATH;
+    XrActionsSyncInfo asi;
+    asi.type = XR_TYPE_ACTIONS_SYNC_INFO;
+    asi.next = NULL;
+    asi.countActiveActionSets = 1;
+    asi.activeActionSets = &aas;
+    result = xrSyncActions(session, &asi);
+    if (!CheckResult(instance, result, "xrSyncActions"))
     {
         return false;
     }
 
+    // AJT: TODO: xrGetActionStateFloat()
+    // AJT: TODO: xrGetActionStatePose()
+
     return true;
 }
 
-bool CreateFrameBuffer(GLuint& frameBuffer)
+// projections of each view, rebuilt only when the runtime changes the view's fov.
+static XrMathProjectionCache s_projectionCaches[MAX_STEREO_VIEWS];
+
+// computes the matrix that takes room space into clip space for the given view.
+static void ComputeModelViewProjMat(float* result, const XrCompositionLayerProjectionView& layerView, uint32_t viewIndex)
 {
-    glGenFramebuffers(1, &frameBuffer);
-    return true;
+    assert(viewIndex < MAX_STEREO_VIEWS);
+    const float* projMat = XrMathGetProjectionMat(s_projectionCaches[viewIndex], layerView.fov, NEAR_Z, FAR_Z);
+    float viewMat[16];
+    XrMathInitViewMat(viewMat, layerView.pose);
+    XrMathMultiplyMat(result, projMat, viewMat);
+}
+
+static void InitViewConstants(ViewBlock& block, uint32_t blockView, const XrCompositionLayerProjectionView& layerView,
+                              uint32_t viewIndex)
+{
+    ComputeModelViewProjMat(block.modelViewProjMat[blockView], layerView, viewIndex);
+    block.tanAngles[blockView][0] = tanf(layerView.fov.angleLeft);
+    block.tanAngles[blockView][1] = tanf(layerView.fov.angleRight);
+    block.tanAngles[blockView][2] = tanf(layerView.fov.angleDown);
+    block.tanAngles[blockView][3] = tanf(layerView.fov.angleUp);
 }
 
-bool CompileShader(GLint& shader, GLenum type, const char* source)
+// writes this frame's constants into the next slot, once the gpu is done with what was last written to it, and
+// binds the block of all views to ViewBlock.  Waits that would block are counted as fenceWaits.
+static void WriteUniformRing(Context::UniformRingInfo& uniformRingInfo,
+                             const XrCompositionLayerProjectionView* layerViews, uint32_t viewCount)
 {
-    shader = glCreateShader(type);
-    int size = (int)strlen(source);
-    glShaderSource(shader, 1, (const GLchar**)&source, &size);
-    glCompileShader(shader);
+    assert(viewCount <= MAX_STEREO_VIEWS);
+    GLsync& fence = uniformRingInfo.fences[uniformRingInfo.slot];
+    if (fence)
+    {
+        // the slot was written NUM_UNIFORM_RING_SLOTS frames ago, so this should almost never block.
+        GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (status == GL_TIMEOUT_EXPIRED)
+        {
+            FrameStatsAddCount(COUNTER_FENCE_WAITS, 1);
+            while (status == GL_TIMEOUT_EXPIRED)
+            {
+                status = glClientWaitSync(fence, 0, 1000000);
+            }
+        }
+        glDeleteSync(fence);
+        fence = 0;
+    }
+
+    // built on the stack and copied in whole, the mapping is write combined and never read back.
+    ViewBlock blocks[1 + MAX_STEREO_VIEWS] = {};
+    for (uint32_t i = 0; i < viewCount; i++)
+    {
+        InitViewConstants(blocks[0], i, layerViews[i], i);
+        InitViewConstants(blocks[1 + i], 0, layerViews[i], i);
+    }
+    uint8_t* slot = uniformRingInfo.mapped + uniformRingInfo.slot * uniformRingInfo.slotSize;
+    for (uint32_t i = 0; i < 1 + viewCount; i++)
+    {
+        memcpy(slot + i * uniformRingInfo.blockSize, &blocks[i], sizeof(ViewBlock));
+    }
 
-    GLint compiled;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
-    return (bool)compiled;
+    glBindBufferRange(GL_UNIFORM_BUFFER, VIEW_UNIFORM_BINDING, uniformRingInfo.buffer,
+                      uniformRingInfo.slot * uniformRingInfo.slotSize, sizeof(ViewBlock));
 }
 
-bool CompileProgram(Context::ProgramInfo& programInfo)
+// binds the block of one view to ViewBlock, for drawing the views one at a time.
+static void BindViewUniforms(const Context::UniformRingInfo& uniformRingInfo, uint32_t viewIndex)
 {
-    static const char* vertSource = R"_(
-uniform mat4 modelViewProjMat;
-attribute vec3 position;
+    const GLintptr offset = uniformRingInfo.slot * uniformRingInfo.slotSize + (1 + viewIndex) * uniformRingInfo.blockSize;
+    glBindBufferRange(GL_UNIFORM_BUFFER, VIEW_UNIFORM_BINDING, uniformRingInfo.buffer, offset, sizeof(ViewBlock));
+}
 
-void main(void)
+// fences the slot after the draws that read it, and moves on to the next one.
+static void EndUniformRing(Context::UniformRingInfo& uniformRingInfo)
 {
-    gl_Position = modelViewProjMat * vec4(position, 1);
+    uniformRingInfo.fences[uniformRingInfo.slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    uniformRingInfo.slot = (uniformRingInfo.slot + 1) % NUM_UNIFORM_RING_SLOTS;
 }
-)_";
 
-    static const char* fragSource = R"_(
-uniform vec4 color;
-void main()
+// binds the framebuffer and clears all of it, every layer for array framebuffers.
+static void BeginRenderTarget(const Context::FrameBufferInfo& frameBufferInfo, uint32_t frameBufferIndex)
 {
-    gl_FragColor = color;
+    glBindFramebuffer(GL_FRAMEBUFFER, frameBufferInfo.frameBuffers[frameBufferIndex]);
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClearDepth(1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+    // the visibility mask relies on the depth test, and depth submitted to the runtime should be the scene's.
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
 }
-)_";
 
-    GLint vertShader = 0;
-    GLint fragShader = 0;
+// resolves the msaa target into the acquired images, when that isn't left to the runtime or driver,
+// and drops whatever doesn't need to be kept.  layerViews are the views drawn, only their imageRects are resolved.
+static void EndRenderTarget(const Context::FrameBufferInfo& frameBufferInfo, uint32_t frameBufferIndex,
+                            const XrCompositionLayerProjectionView* layerViews, uint32_t viewCount)
+{
+    if (frameBufferInfo.resolve)
+    {
+        const uint32_t swapchain = frameBufferIndex / (frameBufferInfo.stride * frameBufferInfo.depthStride);
+        const Context::FrameBufferInfo::MsaaTarget& target = frameBufferInfo.msaaTargets[swapchain];
+
+        int32_t width = 0;
+        int32_t height = 0;
+        for (uint32_t i = 0; i < viewCount; i++)
+        {
+            const XrRect2Di& rect = layerViews[i].subImage.imageRect;
+            width = std::max(width, std::min(rect.offset.x + rect.extent.width, target.width));
+            height = std::max(height, std::min(rect.offset.y + rect.extent.height, target.height));
+        }
+
+        const GLbitfield mask = GL_COLOR_BUFFER_BIT | (frameBufferInfo.resolveDepth ? GL_DEPTH_BUFFER_BIT : 0);
+        for (uint32_t i = 0; i < target.readFrameBuffers.size(); i++)
+        {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, target.readFrameBuffers[i]);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, frameBufferInfo.resolveFrameBuffers[frameBufferIndex * frameBufferInfo.layerCount + i]);
+            glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, mask, GL_NEAREST);
+        }
 
-    if (!CompileShader(vertShader, GL_VERTEX_SHADER, vertSource))
+        // the multisampled buffers are only needed until they are resolved.
+        if (GLEW_VERSION_4_3 || GLEW_ARB_invalidate_subdata)
+        {
+            const GLenum attachments[2] = {GL_COLOR_ATTACHMENT0, frameBufferInfo.depthAttachment};
+            glBindFramebuffer(GL_FRAMEBUFFER, target.frameBuffer);
+            glInvalidateFramebuffer(GL_FRAMEBUFFER, 2, attachments);
+        }
+    }
+    else if (frameBufferInfo.invalidateDepth)
     {
-        printf("Failed to compile vertex shader\n");
-        return false;
+        glInvalidateFramebuffer(GL_FRAMEBUFFER, 1, &frameBufferInfo.depthAttachment);
     }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
 
-    if (!CompileShader(fragShader, GL_FRAGMENT_SHADER, fragSource))
+// lays the hidden area of the views into depth, in the current viewport, with color writes off.
+// two pass and double wide draw one view at a time, viewIndex, the single pass modes all viewCount views at once.
+static void DrawVisibilityMask(const Context::VisibilityMaskInfo& visibilityMaskInfo, StereoMode stereoMode,
+                               const XrCompositionLayerProjectionView* layerViews, uint32_t viewCount, uint32_t viewIndex)
+{
+    const bool singlePass = stereoMode == STEREO_MULTIVIEW || stereoMode == STEREO_LAYERED;
+    if (visibilityMaskInfo.totalIndexCount == 0 || (!singlePass && visibilityMaskInfo.indexCount[viewIndex] == 0))
     {
-        printf("Failed to compile fragment shader\n");
-        return false;
+        return;
     }
 
-    programInfo.program = glCreateProgram();
-    glAttachShader(programInfo.program, vertShader);
-    glAttachShader(programInfo.program, fragShader);
-    glLinkProgram(programInfo.program);
+    glUseProgram(visibilityMaskInfo.program);
+    if (!visibilityMaskInfo.viewUniformBlock)
+    {
+        float tanAngles[MAX_STEREO_VIEWS * 4];
+        for (uint32_t i = 0; i < viewCount; i++)
+        {
+            tanAngles[i * 4 + 0] = tanf(layerViews[i].fov.angleLeft);
+            tanAngles[i * 4 + 1] = tanf(layerViews[i].fov.angleRight);
+            tanAngles[i * 4 + 2] = tanf(layerViews[i].fov.angleDown);
+            tanAngles[i * 4 + 3] = tanf(layerViews[i].fov.angleUp);
+        }
+        glUniform4fv(visibilityMaskInfo.tanAnglesUniformLoc, viewCount, tanAngles);
+    }
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glBindVertexArray(visibilityMaskInfo.vao);
+    if (stereoMode == STEREO_MULTIVIEW)
+    {
+        glDrawElements(GL_TRIANGLES, visibilityMaskInfo.totalIndexCount, GL_UNSIGNED_INT, 0);
+    }
+    else if (stereoMode == STEREO_LAYERED)
+    {
+        glDrawElementsInstanced(GL_TRIANGLES, visibilityMaskInfo.totalIndexCount, GL_UNSIGNED_INT, 0, viewCount);
+    }
+    else
+    {
+        glDrawElements(GL_TRIANGLES, visibilityMaskInfo.indexCount[viewIndex], GL_UNSIGNED_INT,
+                       (const void*)(visibilityMaskInfo.firstIndex[viewIndex] * sizeof(uint32_t)));
+    }
+    glBindVertexArray(0);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
 
-    glDeleteShader(vertShader);
-    glDeleteShader(fragShader);
+// draws the scene into the view's imageRect of the bound framebuffer, after its visibility mask if there is one.
+static void DrawView(const Context::ProgramInfo& programInfo, const Context::GeometryInfo& geometryInfo,
+                     const std::vector<uint32_t>* drawList, const Context::VisibilityMaskInfo* visibilityMaskInfo,
+                     const XrCompositionLayerProjectionView& layerView, uint32_t viewIndex)
+{
+    glViewport(static_cast<GLint>(layerView.subImage.imageRect.offset.x),
+               static_cast<GLint>(layerView.subImage.imageRect.offset.y),
+               static_cast<GLsizei>(layerView.subImage.imageRect.extent.width),
+               static_cast<GLsizei>(layerView.subImage.imageRect.extent.height));
 
-    GLint linked;
-    glGetProgramiv(programInfo.program, GL_LINK_STATUS, &linked);
-    if (!linked)
+    if (visibilityMaskInfo)
     {
-        return false;
+        DrawVisibilityMask(*visibilityMaskInfo, STEREO_TWO_PASS, &layerView, 1, viewIndex);
     }
 
-    programInfo.modelViewProjMatUniformLoc = glGetUniformLocation(programInfo.program, "modelViewProjMat");
-    programInfo.colorUniformLoc = glGetUniformLocation(programInfo.program, "color");
-    programInfo.positionAttribLoc = glGetAttribLocation(programInfo.program, "position");
+    glUseProgram(programInfo.program);
+    if (!programInfo.viewUniformBlock)
+    {
+        float modelViewProjMat[16];
+        ComputeModelViewProjMat(modelViewProjMat, layerView, viewIndex);
+        glUniformMatrix4fv(programInfo.modelViewProjMatUniformLoc, 1, GL_FALSE, modelViewProjMat);
+    }
 
-    return true;
+    DrawGeometry(programInfo, geometryInfo, drawList, 0);
 }
 
-bool SyncInput(XrInstance instance, XrSession session, XrActionSet actionSet)
+// draws the view one foveation ring at a time, from the outside in, into frameBuffer, which must be bound.
+// Rings below full rate are drawn into the foveation target, with the viewport placed so just the ring's rect
+// lands in it, then stretched into place with a linear blit.  The first full rate ring is drawn in place,
+// scissored to its rect, along with everything inside it.  The next ring in is left out of each lower rate ring
+// with a depth of 0, so those pixels are only shaded once.
+static void DrawFoveatedView(const Context::ProgramInfo& programInfo, const Context::GeometryInfo& geometryInfo,
+                             const std::vector<uint32_t>* drawList, const Context::VisibilityMaskInfo* visibilityMaskInfo,
+                             const Context::FoveationInfo& foveationInfo, GLuint frameBuffer,
+                             const XrCompositionLayerProjectionView& layerView, uint32_t viewIndex)
 {
-    XrResult result;
+    const XrRect2Di& rect = layerView.subImage.imageRect;
 
-    // syncInput
-    XrActiveActionSet aas;
-    aas.actionSet = actionSet;
-    aas.subactionPath = XR_NULL_PATH;
-    XrActionsSyncInfo asi;
-    asi.type = XR_TYPE_ACTIONS_SYNC_INFO;
-    asi.next = NULL;
-    asi.countActiveActionSets = 1;
-    asi.activeActionSets = &aas;
-    result = xrSyncActions(session, &asi);
-    if (!CheckResult(instance, result, "xrSyncActions"))
+    // rings are centered on the view direction, which is off center with asymmetric fovs,
+    // and slid back inside the view where they would cross its edge, which keeps them nested.
+    const float tanLeft = tanf(layerView.fov.angleLeft);
+    const float tanRight = tanf(layerView.fov.angleRight);
+    const float tanDown = tanf(layerView.fov.angleDown);
+    const float tanUp = tanf(layerView.fov.angleUp);
+    const float centerX = rect.offset.x + rect.extent.width * tanLeft / (tanLeft - tanRight);
+    const float centerY = rect.offset.y + rect.extent.height * tanDown / (tanDown - tanUp);
+    int32_t x0[MAX_FOVEATION_RINGS];
+    int32_t y0[MAX_FOVEATION_RINGS];
+    int32_t x1[MAX_FOVEATION_RINGS];
+    int32_t y1[MAX_FOVEATION_RINGS];
+    for (uint32_t i = 0; i < foveationInfo.ringCount; i++)
     {
-        return false;
+        const int32_t width = (int32_t)(foveationInfo.rings[i].size * rect.extent.width + 0.5f);
+        const int32_t height = (int32_t)(foveationInfo.rings[i].size * rect.extent.height + 0.5f);
+        x0[i] = std::max(std::min((int32_t)(centerX - 0.5f * width), rect.offset.x + rect.extent.width - width), rect.offset.x);
+        y0[i] = std::max(std::min((int32_t)(centerY - 0.5f * height), rect.offset.y + rect.extent.height - height), rect.offset.y);
+        x1[i] = x0[i] + width;
+        y1[i] = y0[i] + height;
     }
 
-    // AJT: TODO: xrGetActionStateFloat()
-    // AJT: TODO: xrGetActionStatePose()
+    for (int32_t i = (int32_t)foveationInfo.ringCount - 1; i >= 0; i--)
+    {
+        const FoveationRing& ring = foveationInfo.rings[i];
+        const int32_t ringWidth = x1[i] - x0[i];
+        const int32_t ringHeight = y1[i] - y0[i];
+        if (ringWidth <= 0 || ringHeight <= 0)
+        {
+            continue;
+        }
 
-    return true;
+        if (ring.scale >= 1.0f)
+        {
+            // the rings outside have already been blitted here, with their depth when it is submitted.
+            glEnable(GL_SCISSOR_TEST);
+            glScissor(x0[i], y0[i], ringWidth, ringHeight);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            DrawView(programInfo, geometryInfo, drawList, visibilityMaskInfo, layerView, viewIndex);
+            glDisable(GL_SCISSOR_TEST);
+            break;
+        }
+
+        const int32_t width = std::min(std::max((int32_t)(ringWidth * ring.scale + 0.5f), 1), foveationInfo.width);
+        const int32_t height = std::min(std::max((int32_t)(ringHeight * ring.scale + 0.5f), 1), foveationInfo.height);
+        const float scaleX = (float)width / (float)ringWidth;
+        const float scaleY = (float)height / (float)ringHeight;
+
+        // the whole view at the ring's scale, offset so the ring's rect starts at the target's origin.
+        XrCompositionLayerProjectionView ringView = layerView;
+        ringView.subImage.imageRect.offset = {(int32_t)lroundf((rect.offset.x - x0[i]) * scaleX),
+                                              (int32_t)lroundf((rect.offset.y - y0[i]) * scaleY)};
+        ringView.subImage.imageRect.extent = {(int32_t)lroundf(rect.extent.width * scaleX),
+                                              (int32_t)lroundf(rect.extent.height * scaleY)};
+
+        glBindFramebuffer(GL_FRAMEBUFFER, foveationInfo.frameBuffer);
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(0, 0, width, height);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        if (i > 0)
+        {
+            // less a texel on each side, which the linear blit still reads for the pixels just outside.
+            const int32_t holeX0 = (int32_t)ceilf((x0[i - 1] - x0[i]) * scaleX) + 1;
+            const int32_t holeY0 = (int32_t)ceilf((y0[i - 1] - y0[i]) * scaleY) + 1;
+            const int32_t holeX1 = (int32_t)floorf((x1[i - 1] - x0[i]) * scaleX) - 1;
+            const int32_t holeY1 = (int32_t)floorf((y1[i - 1] - y0[i]) * scaleY) - 1;
+            if (holeX1 > holeX0 && holeY1 > holeY0)
+            {
+                glScissor(holeX0, holeY0, holeX1 - holeX0, holeY1 - holeY0);
+                glClearDepth(0.0f);
+                glClear(GL_DEPTH_BUFFER_BIT);
+                glClearDepth(1.0f);
+                glScissor(0, 0, width, height);
+            }
+        }
+        DrawView(programInfo, geometryInfo, drawList, visibilityMaskInfo, ringView, viewIndex);
+        glDisable(GL_SCISSOR_TEST);
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, foveationInfo.frameBuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, frameBuffer);
+        glBlitFramebuffer(0, 0, width, height, x0[i], y0[i], x1[i], y1[i], GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        if (foveationInfo.blitDepth)
+        {
+            glBlitFramebuffer(0, 0, width, height, x0[i], y0[i], x1[i], y1[i], GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+    }
 }
 
-static void InitPoseMat(float* result, const XrPosef& pose)
-{
-    const float x2 = pose.orientation.x + pose.orientation.x;
-    const float y2 = pose.orientation.y + pose.orientation.y;
-    const float z2 = pose.orientation.z + pose.orientation.z;
-
-    const float xx2 = pose.orientation.x * x2;
-    const float yy2 = pose.orientation.y * y2;
-    const float zz2 = pose.orientation.z * z2;
-
-    const float yz2 = pose.orientation.y * z2;
-    const float wx2 = pose.orientation.w * x2;
-    const float xy2 = pose.orientation.x * y2;
-    const float wz2 = pose.orientation.w * z2;
-    const float xz2 = pose.orientation.x * z2;
-    const float wy2 = pose.orientation.w * y2;
-
-    result[0] = 1.0f - yy2 - zz2;
-    result[1] = xy2 + wz2;
-    result[2] = xz2 - wy2;
-    result[3] = 0.0f;
-
-    result[4] = xy2 - wz2;
-    result[5] = 1.0f - xx2 - zz2;
-    result[6] = yz2 + wx2;
-    result[7] = 0.0f;
-
-    result[8] = xz2 + wy2;
-    result[9] = yz2 - wx2;
-    result[10] = 1.0f - xx2 - yy2;
-    result[11] = 0.0f;
-
-    result[12] = pose.position.x;
-    result[13] = pose.position.y;
-    result[14] = pose.position.z;
-    result[15] = 1.0;
-}
-
-static void MultiplyMat(float* result, const float* a, const float* b)
-{
-    result[0] = a[0] * b[0] + a[4] * b[1] + a[8] * b[2] + a[12] * b[3];
-    result[1] = a[1] * b[0] + a[5] * b[1] + a[9] * b[2] + a[13] * b[3];
-    result[2] = a[2] * b[0] + a[6] * b[1] + a[10] * b[2] + a[14] * b[3];
-    result[3] = a[3] * b[0] + a[7] * b[1] + a[11] * b[2] + a[15] * b[3];
-
-    result[4] = a[0] * b[4] + a[4] * b[5] + a[8] * b[6] + a[12] * b[7];
-    result[5] = a[1] * b[4] + a[5] * b[5] + a[9] * b[6] + a[13] * b[7];
-    result[6] = a[2] * b[4] + a[6] * b[5] + a[10] * b[6] + a[14] * b[7];
-    result[7] = a[3] * b[4] + a[7] * b[5] + a[11] * b[6] + a[15] * b[7];
-
-    result[8] = a[0] * b[8] + a[4] * b[9] + a[8] * b[10] + a[12] * b[11];
-    result[9] = a[1] * b[8] + a[5] * b[9] + a[9] * b[10] + a[13] * b[11];
-    result[10] = a[2] * b[8] + a[6] * b[9] + a[10] * b[10] + a[14] * b[11];
-    result[11] = a[3] * b[8] + a[7] * b[9] + a[11] * b[10] + a[15] * b[11];
-
-    result[12] = a[0] * b[12] + a[4] * b[13] + a[8] * b[14] + a[12] * b[15];
-    result[13] = a[1] * b[12] + a[5] * b[13] + a[9] * b[14] + a[13] * b[15];
-    result[14] = a[2] * b[12] + a[6] * b[13] + a[10] * b[14] + a[14] * b[15];
-    result[15] = a[3] * b[12] + a[7] * b[13] + a[11] * b[14] + a[15] * b[15];
-}
-
-static void InvertOrthogonalMat(float* result, float* src)
-{
-    result[0] = src[0];
-    result[1] = src[4];
-    result[2] = src[8];
-    result[3] = 0.0f;
-    result[4] = src[1];
-    result[5] = src[5];
-    result[6] = src[9];
-    result[7] = 0.0f;
-    result[8] = src[2];
-    result[9] = src[6];
-    result[10] = src[10];
-    result[11] = 0.0f;
-    result[12] = -(src[0] * src[12] + src[1] * src[13] + src[2] * src[14]);
-    result[13] = -(src[4] * src[12] + src[5] * src[13] + src[6] * src[14]);
-    result[14] = -(src[8] * src[12] + src[9] * src[13] + src[10] * src[14]);
-    result[15] = 1.0f;
-}
-
-enum GraphicsAPI { GRAPHICS_VULKAN, GRAPHICS_OPENGL, GRAPHICS_OPENGL_ES, GRAPHICS_D3D };
-static void InitProjectionMat(float* result, GraphicsAPI graphicsApi, const float tanAngleLeft,
-                              const float tanAngleRight, const float tanAngleUp, float const tanAngleDown,
-                              const float nearZ, const float farZ)
-{
-    const float tanAngleWidth = tanAngleRight - tanAngleLeft;
-
-    // Set to tanAngleDown - tanAngleUp for a clip space with positive Y down (Vulkan).
-    // Set to tanAngleUp - tanAngleDown for a clip space with positive Y up (OpenGL / D3D / Metal).
-    const float tanAngleHeight = graphicsApi == GRAPHICS_VULKAN ? (tanAngleDown - tanAngleUp) : (tanAngleUp - tanAngleDown);
-
-    // Set to nearZ for a [-1,1] Z clip space (OpenGL / OpenGL ES).
-    // Set to zero for a [0,1] Z clip space (Vulkan / D3D / Metal).
-    const float offsetZ = (graphicsApi == GRAPHICS_OPENGL || graphicsApi == GRAPHICS_OPENGL_ES) ? nearZ : 0;
-
-    if (farZ <= nearZ)
-    {
-        // place the far plane at infinity
-        result[0] = 2 / tanAngleWidth;
-        result[4] = 0;
-        result[8] = (tanAngleRight + tanAngleLeft) / tanAngleWidth;
-        result[12] = 0;
-
-        result[1] = 0;
-        result[5] = 2 / tanAngleHeight;
-        result[9] = (tanAngleUp + tanAngleDown) / tanAngleHeight;
-        result[13] = 0;
-
-        result[2] = 0;
-        result[6] = 0;
-        result[10] = -1;
-        result[14] = -(nearZ + offsetZ);
-
-        result[3] = 0;
-        result[7] = 0;
-        result[11] = -1;
-        result[15] = 0;
+bool RenderView(const Context::ProgramInfo& programInfo, const Context::GeometryInfo& geometryInfo,
+                const std::vector<uint32_t>* drawList, const Context::VisibilityMaskInfo* visibilityMaskInfo, const Context::FoveationInfo* foveationInfo,
+                const XrCompositionLayerProjectionView& layerView, uint32_t viewIndex,
+                const Context::FrameBufferInfo& frameBufferInfo, uint32_t frameBufferIndex)
+{
+    BeginRenderTarget(frameBufferInfo, frameBufferIndex);
+    if (foveationInfo)
+    {
+        DrawFoveatedView(programInfo, geometryInfo, drawList, visibilityMaskInfo, *foveationInfo,
+                         frameBufferInfo.frameBuffers[frameBufferIndex], layerView, viewIndex);
     }
     else
     {
-        // normal projection
-        result[0] = 2 / tanAngleWidth;
-        result[4] = 0;
-        result[8] = (tanAngleRight + tanAngleLeft) / tanAngleWidth;
-        result[12] = 0;
+        DrawView(programInfo, geometryInfo, drawList, visibilityMaskInfo, layerView, viewIndex);
+    }
+    EndRenderTarget(frameBufferInfo, frameBufferIndex, &layerView, 1);
+
+    return true;
+}
+
+// renders all views in one pass, into the layers of an array texture.
+bool RenderStereoView(const Context::ProgramInfo& programInfo, const Context::GeometryInfo& geometryInfo,
+                      const std::vector<uint32_t>* drawList, const Context::VisibilityMaskInfo* visibilityMaskInfo, StereoMode stereoMode, const XrCompositionLayerProjectionView* layerViews, uint32_t viewCount,
+                      const Context::FrameBufferInfo& frameBufferInfo, uint32_t frameBufferIndex)
+{
+    BeginRenderTarget(frameBufferInfo, frameBufferIndex);
 
-        result[1] = 0;
-        result[5] = 2 / tanAngleHeight;
-        result[9] = (tanAngleUp + tanAngleDown) / tanAngleHeight;
-        result[13] = 0;
+    // every view uses the same rect, in its own layer.
+    glViewport(static_cast<GLint>(layerViews[0].subImage.imageRect.offset.x),
+               static_cast<GLint>(layerViews[0].subImage.imageRect.offset.y),
+               static_cast<GLsizei>(layerViews[0].subImage.imageRect.extent.width),
+               static_cast<GLsizei>(layerViews[0].subImage.imageRect.extent.height));
 
-        result[2] = 0;
-        result[6] = 0;
-        result[10] = -(farZ + offsetZ) / (farZ - nearZ);
-        result[14] = -(farZ * (nearZ + offsetZ)) / (farZ - nearZ);
+    if (visibilityMaskInfo)
+    {
+        DrawVisibilityMask(*visibilityMaskInfo, stereoMode, layerViews, viewCount, 0);
+    }
 
-        result[3] = 0;
-        result[7] = 0;
-        result[11] = -1;
-        result[15] = 0;
+    glUseProgram(programInfo.program);
+    if (!programInfo.viewUniformBlock)
+    {
+        float modelViewProjMats[MAX_STEREO_VIEWS * 16];
+        for (uint32_t i = 0; i < viewCount; i++)
+        {
+            ComputeModelViewProjMat(modelViewProjMats + i * 16, layerViews[i], i);
+        }
+        glUniformMatrix4fv(programInfo.modelViewProjMatUniformLoc, viewCount, GL_FALSE, modelViewProjMats);
     }
+
+    DrawGeometry(programInfo, geometryInfo, drawList, stereoMode == STEREO_MULTIVIEW ? 0 : (GLsizei)viewCount);
+
+    EndRenderTarget(frameBufferInfo, frameBufferIndex, layerViews, viewCount);
+
+    return true;
 }
 
-bool RenderView(const Context::ProgramInfo& programInfo, const XrCompositionLayerProjectionView& layerView,
-                GLuint frameBuffer, GLuint colorTexture, GLuint depthTexture)
+
+static bool AcquireSwapchainImage(XrInstance instance, XrSwapchain swapchain, uint32_t& swapchainImageIndex)
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
-    glViewport(static_cast<GLint>(layerView.subImage.imageRect.offset.x),
-               static_cast<GLint>(layerView.subImage.imageRect.offset.y),
-               static_cast<GLsizei>(layerView.subImage.imageRect.extent.width),
-               static_cast<GLsizei>(layerView.subImage.imageRect.extent.height));
+    XrSwapchainImageAcquireInfo ai;
+    ai.type = XR_TYPE_SWAPCHAIN_IMAGE_ACQUIRE_INFO;
+    ai.next = NULL;
+
+    uint64_t t0 = FrameStatsNow();
+    XrResult result = xrAcquireSwapchainImage(swapchain, &ai, &swapchainImageIndex);
+    FrameStatsAddPhase(PHASE_ACQUIRE_IMAGE, t0, FrameStatsNow());
+    if (!CheckResult(instance, result, "xrAquireSwapchainImage"))
+    {
+        return false;
+    }
 
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+    XrSwapchainImageWaitInfo wi;
+    wi.type = XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO;
+    wi.next = NULL;
+    wi.timeout = XR_INFINITE_DURATION;
+    t0 = FrameStatsNow();
+    result = xrWaitSwapchainImage(swapchain, &wi);
+    FrameStatsAddPhase(PHASE_WAIT_IMAGE, t0, FrameStatsNow());
+    if (!CheckResult(instance, result, "xrWaitSwapchainImage"))
+    {
+        return false;
+    }
 
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    glClearDepth(1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    return true;
+}
 
-    // convert XrFovf into an OpenGL projection matrix.
-    const float tanLeft = tanf(layerView.fov.angleLeft);
-    const float tanRight = tanf(layerView.fov.angleRight);
-    const float tanDown = tanf(layerView.fov.angleDown);
-    const float tanUp = tanf(layerView.fov.angleUp);
-    const float nearZ = 0.05f;
-    const float farZ = 100.0f;
-    float projMat[16];
-    InitProjectionMat(projMat, GRAPHICS_OPENGL, tanLeft, tanRight, tanUp, tanDown, nearZ, farZ);
-
-    // compute view matrix by inverting the pose
-    float invViewMat[16];
-    InitPoseMat(invViewMat, layerView.pose);
-    float viewMat[16];
-    InvertOrthogonalMat(viewMat, invViewMat);
+static bool ReleaseSwapchainImage(XrInstance instance, XrSwapchain swapchain)
+{
+    XrSwapchainImageReleaseInfo ri;
+    ri.type = XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO;
+    ri.next = NULL;
+    uint64_t t0 = FrameStatsNow();
+    XrResult result = xrReleaseSwapchainImage(swapchain, &ri);
+    FrameStatsAddPhase(PHASE_RELEASE_IMAGE, t0, FrameStatsNow());
+    if (!CheckResult(instance, result, "xrReleaseSwapchainImage"))
+    {
+        return false;
+    }
 
-    float modelViewProjMat[16];
-    MultiplyMat(modelViewProjMat, projMat, viewMat);
+    return true;
+}
 
-    glUseProgram(programInfo.program);
-    glUniformMatrix4fv(programInfo.modelViewProjMatUniformLoc, 1, GL_FALSE, modelViewProjMat);
-    float green[4] = {0.0f, 1.0f, 0.0f, 1.0f};
-    glUniform4fv(programInfo.colorUniformLoc, 1, green);
-
-    // Original 1968 "Sword of Damocles" Room
-    // https://youtu.be/LZCx0yH9gLM?t=4711
-    float radius = 1.5f;
-    float portalRadius = radius / 3.0f;
-    const int NUM_VERTICES = 54;
-    static float positions[NUM_VERTICES * 3] = {
-        // room bounds
-        radius, 0.0f, radius,
-        radius, 0.0f, -radius,
-        -radius, 0.0f, -radius,
-        -radius, 0.0f, radius,
-
-        radius, 2.0f * radius, radius,
-        radius, 2.0f * radius, -radius,
-        -radius, 2.0f * radius, -radius,
-        -radius, 2.0f * radius, radius,
-
-        // north protal
-        portalRadius, radius + portalRadius, -radius,
-        -portalRadius, radius + portalRadius, -radius,
-        -portalRadius, radius - portalRadius, -radius,
-        portalRadius, radius - portalRadius, -radius,
-
-        // south protal
-        portalRadius, radius + portalRadius, radius,
-        -portalRadius, radius + portalRadius, radius,
-        -portalRadius, radius - portalRadius, radius,
-        portalRadius, radius - portalRadius, radius,
-
-        // east portal
-        radius, radius + portalRadius, portalRadius,
-        radius, radius + portalRadius, -portalRadius,
-        radius, radius - portalRadius, -portalRadius,
-        radius, radius - portalRadius, portalRadius,
-
-        // west door
-        -radius, radius + portalRadius, portalRadius,
-        -radius, radius + portalRadius, -portalRadius,
-        -radius, 0.0f, -portalRadius,
-        -radius, 0.0f, portalRadius,
-
-        // letter n
-        portalRadius / 4.0f, radius + (portalRadius / 2.0f), -radius * 0.9f,
-        -portalRadius / 4.0f, radius + (portalRadius / 2.0f), -radius * 0.9f,
-        -portalRadius / 4.0f, radius - (portalRadius / 2.0f), -radius * 0.9f,
-        portalRadius / 4.0f, radius - (portalRadius / 2.0f), -radius * 0.9f,
-
-        // letter s
-        -portalRadius / 4.0f, radius + (portalRadius / 2.0f), radius * 0.9f,
-        portalRadius / 4.0f, radius + (portalRadius / 2.0f), radius * 0.9f,
-        portalRadius / 4.0f, radius, radius * 0.9f,
-        -portalRadius / 4.0f, radius, radius * 0.9f,
-        -portalRadius / 4.0f, radius - (portalRadius / 2.0f), radius * 0.9f,
-        portalRadius / 4.0f, radius - (portalRadius / 2.0f), radius * 0.9f,
-
-        // letter e
-        radius * 0.9f, radius + (portalRadius / 2.0f), portalRadius / 4.0f,
-        radius * 0.9f, radius + (portalRadius / 2.0f), -portalRadius / 4.0f,
-        radius * 0.9f, radius, portalRadius / 4.0f,
-        radius * 0.9f, radius, -portalRadius / 4.0f,
-        radius * 0.9f, radius - (portalRadius / 2.0f), portalRadius / 4.0f,
-        radius * 0.9f, radius - (portalRadius / 2.0f), -portalRadius / 4.0f,
-
-        // letter w
-        -radius * 0.9f, radius + (portalRadius / 2.0f), -portalRadius / 3.0f,
-        -radius * 0.9f, radius + (portalRadius / 2.0f), portalRadius / 3.0f,
-        -radius * 0.9f, radius, 0.0f,
-        -radius * 0.9f, radius - (portalRadius / 2.0f), -portalRadius / 6.0f,
-        -radius * 0.9f, radius - (portalRadius / 2.0f), portalRadius / 6.0f,
-
-        // letter f
-        portalRadius / 6.0f, 0.0f, -radius * 0.9f,
-        -portalRadius / 6.0f, 0.0f, -radius * 0.9f,
-        portalRadius / 6.0f, 0.0f, -radius * 0.8f,
-        -portalRadius / 6.0f, 0.0f, -radius * 0.8f,
-        -portalRadius / 6.0f, 0.0f, -radius * 0.7f,
-
-        // letter c
-        portalRadius / 6.0f, 2.0f * radius, -radius * 0.9f,
-        -portalRadius / 6.0f, 2.0f * radius, -radius * 0.9f,
-        portalRadius / 6.0f, 2.0f * radius, -radius * 0.7f,
-        -portalRadius / 6.0f, 2.0f * radius, -radius * 0.7f,
-    };
-    glVertexAttribPointer(programInfo.positionAttribLoc, 3, GL_FLOAT, GL_FALSE, 0, positions);
-    glEnableVertexAttribArray(programInfo.positionAttribLoc);
-
-    const int NUM_INDICES = 104;
-    static uint16_t indices[NUM_INDICES] = {
-        0, 1, 1, 2, 2, 3, 3, 0,  // room
-        0, 4, 1, 5, 2, 6, 3, 7,
-        4, 5, 5, 6, 6, 7, 7, 4,
-        8, 9, 9, 10, 10, 11, 11, 8, // north portal
-        12, 13, 13, 14, 14, 15, 15, 12, // south portal
-        16, 17, 17, 18, 18, 19, 19, 16, // east portal
-        20, 21, 21, 22, 22, 23, 23, 20, // west door
-        24, 27, 27, 25, 25, 26,  // letter n
-        28, 29, 29, 30, 30, 31, 31, 32, 32, 33, // letter s
-        34, 35, 36, 37, 38, 39, 35, 37, 37, 39, // letter e
-        40, 43, 43, 42, 42, 44, 44, 41, // letter w
-        45, 46, 47, 48, 46, 48, 48, 49, // letter f
-        50, 51, 51, 53, 53, 52 // letter c
-    };
-    glDrawElements(GL_LINES, NUM_INDICES, GL_UNSIGNED_SHORT, indices);
+// acquires an image from the swapchain and, when depth is submitted, from its depth swapchain,
+// and returns the index of the framebuffer that renders to them.  If it fails, nothing is left acquired.
+static bool AcquireRenderTarget(XrInstance instance, const std::vector<Context::SwapchainInfo>& swapchains,
+                                const std::vector<Context::SwapchainInfo>& depthSwapchains,
+                                const Context::FrameBufferInfo& frameBufferInfo, uint32_t swapchain,
+                                uint32_t& frameBufferIndex)
+{
+    uint32_t swapchainImageIndex;
+    if (!AcquireSwapchainImage(instance, swapchains[swapchain].handle, swapchainImageIndex))
+    {
+        return false;
+    }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    uint32_t depthImageIndex = 0;
+    if (!depthSwapchains.empty() && !AcquireSwapchainImage(instance, depthSwapchains[swapchain].handle, depthImageIndex))
+    {
+        // otherwise every later acquire on the color swapchain would fail.
+        ReleaseSwapchainImage(instance, swapchains[swapchain].handle);
+        return false;
+    }
 
+    frameBufferIndex = GetFrameBufferIndex(frameBufferInfo, swapchain, swapchainImageIndex, depthImageIndex);
     return true;
 }
 
-GLuint CreateDepthTexture(GLuint colorTexture)
+static bool ReleaseRenderTarget(XrInstance instance, const std::vector<Context::SwapchainInfo>& swapchains,
+                                const std::vector<Context::SwapchainInfo>& depthSwapchains, uint32_t swapchain)
 {
-    GLint width, height;
-    glBindTexture(GL_TEXTURE_2D, colorTexture);
-    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
-    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    // depth is released even if color fails, so neither is left acquired.
+    bool released = ReleaseSwapchainImage(instance, swapchains[swapchain].handle);
+    if (!depthSwapchains.empty())
+    {
+        released = ReleaseSwapchainImage(instance, depthSwapchains[swapchain].handle) && released;
+    }
+    return released;
+}
 
-    uint32_t depthTexture;
-    glGenTextures(1, &depthTexture);
-    glBindTexture(GL_TEXTURE_2D, depthTexture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-    return depthTexture;
+// hands back render targets [begin, end), when images acquired for late latching won't be rendered.
+static void ReleaseRenderTargets(XrInstance instance, const std::vector<Context::SwapchainInfo>& swapchains,
+                                 const std::vector<Context::SwapchainInfo>& depthSwapchains, uint32_t begin,
+                                 uint32_t end)
+{
+    for (uint32_t i = begin; i < end; i++)
+    {
+        ReleaseRenderTarget(instance, swapchains, depthSwapchains, i);
+    }
 }
 
 
 bool RenderLayer(XrInstance instance, XrSession session, std::vector<XrViewConfigurationView>& viewConfigs,
-                 XrSpace stageSpace, std::vector<Context::SwapchainInfo>& swapchains,
-                 std::vector<std::vector<XrSwapchainImageOpenGLKHR>>& swapchainImages,
-                 std::map<GLuint, GLuint>& colorToDepthMap, GLuint frameBuffer,
-                 const Context::ProgramInfo& programInfo, XrTime predictedDisplayTime,
+                 XrSpace stageSpace, StereoMode stereoMode, std::vector<Context::SwapchainInfo>& swapchains,
+                 std::vector<Context::SwapchainInfo>& depthSwapchains, const Context::FrameBufferInfo& frameBufferInfo,
+                 const Context::ProgramInfo& programInfo, Context::GeometryInfo& geometryInfo,
+                 Context::CullInfo* cullInfo, const Context::VisibilityMaskInfo* visibilityMaskInfo,
+                 const Context::FoveationInfo* foveationInfo, Context::UniformRingInfo* uniformRingInfo,
+                 bool lateLatch, float resolutionScale, XrTime predictedDisplayTime,
                  std::vector<XrCompositionLayerProjectionView>& projectionLayerViews,
-                 XrCompositionLayerProjection& layer)
+                 std::vector<XrCompositionLayerDepthInfoKHR>& depthInfos,
+                 XrCompositionLayerProjection& layer, uint64_t& poseTime)
 {
+    // two pass rendering has a render target per view, the other modes one for all views.
+    const uint32_t renderTargetCount = stereoMode == STEREO_TWO_PASS ? (uint32_t)swapchains.size() : 1;
+    assert(renderTargetCount <= MAX_STEREO_VIEWS);
+    uint32_t frameBufferIndices[MAX_STEREO_VIEWS];
+
+    // when late latching, every image is acquired and waited for before the views are located,
+    // so the poses don't age while the runtime hands back the images.
+    if (lateLatch)
+    {
+        for (uint32_t i = 0; i < renderTargetCount; i++)
+        {
+            if (!AcquireRenderTarget(instance, swapchains, depthSwapchains, frameBufferInfo, i, frameBufferIndices[i]))
+            {
+                // only targets before i are released, a failed AcquireRenderTarget leaves nothing of i acquired.
+                ReleaseRenderTargets(instance, swapchains, depthSwapchains, 0, i);
+                return false;
+            }
+        }
+    }
+
     XrViewState viewState;
     viewState.type = XR_TYPE_VIEW_STATE;
     viewState.next = NULL;
@@ -1248,104 +3934,237 @@ bool RenderLayer(XrInstance instance, XrSession session, std::vector<XrViewConfi
     uint32_t viewCapacityInput = (uint32_t)viewConfigs.size();
     uint32_t viewCountOutput;
 
-    std::vector<XrView> views(viewConfigs.size());
-    for (size_t i = 0; i < viewConfigs.size(); i++)
+    std::vector<XrView> views(viewConfigs.size());
+    for (size_t i = 0; i < viewConfigs.size(); i++)
+    {
+        views[i].type = XR_TYPE_VIEW;
+        views[i].next = NULL;
+    }
+
+    XrViewLocateInfo vli;
+    vli.type = XR_TYPE_VIEW_LOCATE_INFO;
+    vli.viewConfigurationType = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO;
+    vli.displayTime = predictedDisplayTime;
+    vli.space = stageSpace;
+    uint64_t t0 = FrameStatsNow();
+    XrResult result = xrLocateViews(session, &vli, &viewState, viewCapacityInput, &viewCountOutput, views.data());
+    poseTime = FrameStatsNow();
+    FrameStatsAddPhase(PHASE_LOCATE_VIEWS, t0, poseTime);
+    if (!CheckResult(instance, result, "xrLocateViews") || !XR_UNQUALIFIED_SUCCESS(result))
+    {
+        // nothing to render, hand back the images acquired for late latching,
+        // otherwise every later acquire fails and nothing is ever rendered again.
+        if (lateLatch)
+        {
+            ReleaseRenderTargets(instance, swapchains, depthSwapchains, 0, renderTargetCount);
+        }
+        return false;
+    }
+
+    assert(viewCountOutput == viewCapacityInput);
+    assert(viewCountOutput == viewConfigs.size());
+
+    // array layers all have the same size, that of the largest view.
+    uint32_t maxRecommendedWidth = 0;
+    uint32_t maxRecommendedHeight = 0;
+    for (auto& viewConfig : viewConfigs)
+    {
+        maxRecommendedWidth = std::max(maxRecommendedWidth, viewConfig.recommendedImageRectWidth);
+        maxRecommendedHeight = std::max(maxRecommendedHeight, viewConfig.recommendedImageRectHeight);
+    }
+
+    // the poses and fovs submitted are exactly the ones rendered with.
+    // each view is drawn into the bottom left of its part of the swapchain, at resolutionScale of its recommended size.
+    projectionLayerViews.resize(viewCountOutput);
+    int32_t offsetX = 0;
+    for (uint32_t i = 0; i < viewCountOutput; i++)
+    {
+        projectionLayerViews[i].type = XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW;
+        projectionLayerViews[i].next = NULL;
+        projectionLayerViews[i].pose = views[i].pose;
+        projectionLayerViews[i].fov = views[i].fov;
+        if (stereoMode == STEREO_TWO_PASS)
+        {
+            // Each view has a separate swapchain.
+            projectionLayerViews[i].subImage.swapchain = swapchains[i].handle;
+            projectionLayerViews[i].subImage.imageRect.offset = {0, 0};
+            projectionLayerViews[i].subImage.imageRect.extent = {
+                ScaledViewSize(viewConfigs[i].recommendedImageRectWidth, resolutionScale, swapchains[i].width),
+                ScaledViewSize(viewConfigs[i].recommendedImageRectHeight, resolutionScale, swapchains[i].height)};
+            projectionLayerViews[i].subImage.imageArrayIndex = 0;
+        }
+        else if (stereoMode == STEREO_DOUBLE_WIDE)
+        {
+            // All views share one side by side swapchain.
+            const int32_t viewWidth = ScaledViewSize(viewConfigs[i].recommendedImageRectWidth, resolutionScale,
+                                                     swapchains[0].width - offsetX);
+            const int32_t viewHeight = ScaledViewSize(viewConfigs[i].recommendedImageRectHeight, resolutionScale,
+                                                      swapchains[0].height);
+            projectionLayerViews[i].subImage.swapchain = swapchains[0].handle;
+            projectionLayerViews[i].subImage.imageRect.offset = {offsetX, 0};
+            projectionLayerViews[i].subImage.imageRect.extent = {viewWidth, viewHeight};
+            projectionLayerViews[i].subImage.imageArrayIndex = 0;
+            offsetX += viewWidth;
+        }
+        else
+        {
+            // All views share one swapchain, each view in its own array layer.
+            projectionLayerViews[i].subImage.swapchain = swapchains[0].handle;
+            projectionLayerViews[i].subImage.imageRect.offset = {0, 0};
+            projectionLayerViews[i].subImage.imageRect.extent = {
+                ScaledViewSize(maxRecommendedWidth, resolutionScale, swapchains[0].width),
+                ScaledViewSize(maxRecommendedHeight, resolutionScale, swapchains[0].height)};
+            projectionLayerViews[i].subImage.imageArrayIndex = i;
+        }
+    }
+
+    if (cullInfo)
     {
-        views[i].type = XR_TYPE_VIEW;
-        views[i].next = NULL;
+        CullViews(*cullInfo, stereoMode, programInfo.submitMode == SUBMIT_DIRECT, projectionLayerViews.data(),
+                  viewCountOutput);
+    }
+    if (programInfo.submitMode != SUBMIT_DIRECT)
+    {
+        BuildBatch(geometryInfo, cullInfo ? &cullInfo->candidates : NULL);
     }
 
-    XrViewLocateInfo vli;
-    vli.type = XR_TYPE_VIEW_LOCATE_INFO;
-    vli.viewConfigurationType = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO;
-    vli.displayTime = predictedDisplayTime;
-    vli.space = stageSpace;
-    XrResult result = xrLocateViews(session, &vli, &viewState, viewCapacityInput, &viewCountOutput, views.data());
-    if (!CheckResult(instance, result, "xrLocateViews"))
+    if (uniformRingInfo)
     {
-        return false;
+        WriteUniformRing(*uniformRingInfo, projectionLayerViews.data(), viewCountOutput);
     }
 
-    if (XR_UNQUALIFIED_SUCCESS(result))
+    bool rendered = true;
+    if (stereoMode == STEREO_TWO_PASS)
     {
-        assert(viewCountOutput == viewCapacityInput);
-        assert(viewCountOutput == viewConfigs.size());
         assert(viewCountOutput == swapchains.size());
 
-        projectionLayerViews.resize(viewCountOutput);
-
-        // Render view to the appropriate part of the swapchain image.
-        for (uint32_t i = 0; i < viewCountOutput; i++)
+        for (uint32_t i = 0; i < viewCountOutput && rendered; i++)
         {
-            // Each view has a separate swapchain which is acquired, rendered to, and released.
-            const Context::SwapchainInfo viewSwapchain = swapchains[i];
-
-            XrSwapchainImageAcquireInfo ai;
-            ai.type = XR_TYPE_SWAPCHAIN_IMAGE_ACQUIRE_INFO;
-            ai.next = NULL;
-
-            uint32_t swapchainImageIndex;
-            result = xrAcquireSwapchainImage(viewSwapchain.handle, &ai, &swapchainImageIndex);
-            if (!CheckResult(instance, result, "xrAquireSwapchainImage"))
+            // Each view's swapchain is acquired, rendered to, and released.
+            if (!lateLatch &&
+                !AcquireRenderTarget(instance, swapchains, depthSwapchains, frameBufferInfo, i, frameBufferIndices[i]))
             {
-                return false;
+                rendered = false;
+                break;
             }
-
-            XrSwapchainImageWaitInfo wi;
-            wi.type = XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO;
-            wi.next = NULL;
-            wi.timeout = XR_INFINITE_DURATION;
-            result = xrWaitSwapchainImage(viewSwapchain.handle, &wi);
-            if (!CheckResult(instance, result, "xrWaitSwapchainImage"))
+            if (uniformRingInfo)
             {
-                return false;
+                BindViewUniforms(*uniformRingInfo, i);
             }
 
-            projectionLayerViews[i].type = XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW;
-            projectionLayerViews[i].pose = views[i].pose;
-            projectionLayerViews[i].fov = views[i].fov;
-            projectionLayerViews[i].subImage.swapchain = viewSwapchain.handle;
-            projectionLayerViews[i].subImage.imageRect.offset = {0, 0};
-            projectionLayerViews[i].subImage.imageRect.extent = {viewSwapchain.width, viewSwapchain.height};
-
-            const XrSwapchainImageOpenGLKHR& swapchainImage = swapchainImages[i][swapchainImageIndex];
-
-            // find or create the depthTexture associated with this colorTexture
-            const uint32_t colorTexture = swapchainImage.image;
-            auto iter = colorToDepthMap.find(colorTexture);
-            if (iter == colorToDepthMap.end())
+            const FramePhase gpuPhase = (FramePhase)(PHASE_GPU_VIEW0 + (i < 2 ? i : 1));
+            t0 = FrameStatsNow();
+            GpuTimerBegin(PHASE_GPU_RENDER);
+            GpuTimerBegin(gpuPhase);
+            RenderView(programInfo, geometryInfo, cullInfo ? &cullInfo->visible[i] : NULL, visibilityMaskInfo,
+                       foveationInfo, projectionLayerViews[i], i, frameBufferInfo, frameBufferIndices[i]);
+            GpuTimerEnd(gpuPhase);
+            GpuTimerEnd(PHASE_GPU_RENDER);
+            FrameStatsAddPhase(PHASE_RENDER_VIEW, t0, FrameStatsNow());
+
+            if (!ReleaseRenderTarget(instance, swapchains, depthSwapchains, i))
             {
-                const uint32_t depthTexture = CreateDepthTexture(colorTexture);
-                iter = colorToDepthMap.insert(std::make_pair(colorTexture, depthTexture)).first;
+                if (lateLatch)
+                {
+                    ReleaseRenderTargets(instance, swapchains, depthSwapchains, i + 1, viewCountOutput);
+                }
+                rendered = false;
             }
+        }
+    }
+    else
+    {
+        assert(swapchains.size() == 1);
 
-            RenderView(programInfo, projectionLayerViews[i], frameBuffer, iter->first, iter->second);
-
-            XrSwapchainImageReleaseInfo ri;
-            ri.type = XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO;
-            ri.next = NULL;
-            result = xrReleaseSwapchainImage(viewSwapchain.handle, &ri);
-            if (!CheckResult(instance, result, "xrReleaseSwapchainImage"))
+        // one acquire, bind and release per frame for all views.
+        if (!lateLatch &&
+            !AcquireRenderTarget(instance, swapchains, depthSwapchains, frameBufferInfo, 0, frameBufferIndices[0]))
+        {
+            rendered = false;
+        }
+        else
+        {
+            t0 = FrameStatsNow();
+            GpuTimerBegin(PHASE_GPU_RENDER);
+            if (stereoMode == STEREO_DOUBLE_WIDE)
             {
-                return false;
+                BeginRenderTarget(frameBufferInfo, frameBufferIndices[0]);
+                for (uint32_t i = 0; i < viewCountOutput; i++)
+                {
+                    const FramePhase gpuPhase = (FramePhase)(PHASE_GPU_VIEW0 + (i < 2 ? i : 1));
+                    GpuTimerBegin(gpuPhase);
+                    if (uniformRingInfo)
+                    {
+                        BindViewUniforms(*uniformRingInfo, i);
+                    }
+                    if (foveationInfo)
+                    {
+                        DrawFoveatedView(programInfo, geometryInfo, cullInfo ? &cullInfo->visible[i] : NULL,
+                                         visibilityMaskInfo, *foveationInfo,
+                                         frameBufferInfo.frameBuffers[frameBufferIndices[0]],
+                                         projectionLayerViews[i], i);
+                    }
+                    else
+                    {
+                        DrawView(programInfo, geometryInfo, cullInfo ? &cullInfo->visible[i] : NULL, visibilityMaskInfo,
+                                 projectionLayerViews[i], i);
+                    }
+                    GpuTimerEnd(gpuPhase);
+                }
+                EndRenderTarget(frameBufferInfo, frameBufferIndices[0], projectionLayerViews.data(), viewCountOutput);
+            }
+            else
+            {
+                assert(viewCountOutput == swapchains[0].arraySize && viewCountOutput <= MAX_STEREO_VIEWS);
+                RenderStereoView(programInfo, geometryInfo, cullInfo ? &cullInfo->candidates : NULL, visibilityMaskInfo,
+                                 stereoMode, projectionLayerViews.data(), viewCountOutput, frameBufferInfo,
+                                 frameBufferIndices[0]);
             }
+            GpuTimerEnd(PHASE_GPU_RENDER);
+            FrameStatsAddPhase(PHASE_RENDER_VIEW, t0, FrameStatsNow());
 
-            layer.space = stageSpace;
-            layer.viewCount = (uint32_t)projectionLayerViews.size();
-            layer.views = projectionLayerViews.data();
+            rendered = ReleaseRenderTarget(instance, swapchains, depthSwapchains, 0);
         }
     }
 
+    // the slot is fenced and moved on from even when the frame is abandoned, draws reading it may already be
+    // queued, and the next frame must not overwrite it without waiting.
+    if (uniformRingInfo)
+    {
+        EndUniformRing(*uniformRingInfo);
+    }
+    if (!rendered)
+    {
+        return false;
+    }
+
+    if (!depthSwapchains.empty())
+    {
+        // depth for each view is at the same rect and layer of the matching depth swapchain.
+        depthInfos.resize(viewCountOutput);
+        for (uint32_t i = 0; i < viewCountOutput; i++)
+        {
+            depthInfos[i].type = XR_TYPE_COMPOSITION_LAYER_DEPTH_INFO_KHR;
+            depthInfos[i].next = NULL;
+            depthInfos[i].subImage = projectionLayerViews[i].subImage;
+            depthInfos[i].subImage.swapchain = depthSwapchains[stereoMode == STEREO_TWO_PASS ? i : 0].handle;
+            depthInfos[i].minDepth = 0.0f;
+            depthInfos[i].maxDepth = 1.0f;
+            depthInfos[i].nearZ = NEAR_Z;
+            depthInfos[i].farZ = FAR_Z;
+            projectionLayerViews[i].next = &depthInfos[i];
+        }
+    }
+
+    layer.space = stageSpace;
+    layer.viewCount = (uint32_t)projectionLayerViews.size();
+    layer.views = projectionLayerViews.data();
+
     return true;
 }
 
-bool RenderFrame(XrInstance instance, XrSession session, std::vector<XrViewConfigurationView>& viewConfigs,
-                 XrSpace stageSpace, std::vector<Context::SwapchainInfo>& swapchains,
-                 std::vector<std::vector<XrSwapchainImageOpenGLKHR>>& swapchainImages,
-                 std::map<GLuint, GLuint>& colorToDepthMap, GLuint frameBuffer,
-                 const Context::ProgramInfo& programInfo)
+bool WaitFrame(XrInstance instance, XrSession session, XrFrameState& fs)
 {
-    XrFrameState fs;
     fs.type = XR_TYPE_FRAME_STATE;
     fs.next = NULL;
 
@@ -1353,16 +4172,53 @@ bool RenderFrame(XrInstance instance, XrSession session, std::vector<XrViewConfi
     fwi.type = XR_TYPE_FRAME_WAIT_INFO;
     fwi.next = NULL;
 
+    uint64_t t0 = FrameStatsNow();
     XrResult result = xrWaitFrame(session, &fwi, &fs);
+    FrameStatsAddPhase(PHASE_WAIT_FRAME, t0, FrameStatsNow());
     if (!CheckResult(instance, result, "xrWaitFrame"))
     {
         return false;
     }
 
+    return true;
+}
+
+// gets the next frame from the pacing thread, in place of WaitFrame in pipelined mode.
+bool DequeueFrame(XrInstance instance, XrFrameState& fs)
+{
+    PacedFrame frame;
+    uint64_t t0 = FrameStatsNow();
+    if (!FramePacerPop(frame))
+    {
+        printf("Frame pacing thread stopped\n");
+        return false;
+    }
+    FrameStatsAddPhase(PHASE_DEQUEUE_FRAME, t0, FrameStatsNow());
+    FrameStatsAddPhase(PHASE_WAIT_FRAME, frame.waitStart, frame.waitEnd);
+    if (!CheckResult(instance, frame.result, "xrWaitFrame"))
+    {
+        return false;
+    }
+
+    fs = frame.frameState;
+    return true;
+}
+
+// begins, renders and ends a frame that has already been waited for.
+bool RenderFrame(XrInstance instance, XrSession session, std::vector<XrViewConfigurationView>& viewConfigs,
+                 XrSpace stageSpace, StereoMode stereoMode, std::vector<Context::SwapchainInfo>& swapchains,
+                 std::vector<Context::SwapchainInfo>& depthSwapchains, const Context::FrameBufferInfo& frameBufferInfo,
+                 const Context::ProgramInfo& programInfo, Context::GeometryInfo& geometryInfo,
+                 Context::CullInfo* cullInfo, const Context::VisibilityMaskInfo* visibilityMaskInfo,
+                 const Context::FoveationInfo* foveationInfo, Context::UniformRingInfo* uniformRingInfo,
+                 bool lateLatch, float resolutionScale, const XrFrameState& fs)
+{
     XrFrameBeginInfo fbi;
     fbi.type = XR_TYPE_FRAME_BEGIN_INFO;
     fbi.next = NULL;
-    result = xrBeginFrame(session, &fbi);
+    uint64_t t0 = FrameStatsNow();
+    XrResult result = xrBeginFrame(session, &fbi);
+    FrameStatsAddPhase(PHASE_BEGIN_FRAME, t0, FrameStatsNow());
     if (!CheckResult(instance, result, "xrBeginFrame"))
     {
         return false;
@@ -1374,10 +4230,13 @@ bool RenderFrame(XrInstance instance, XrSession session, std::vector<XrViewConfi
     layer.next = NULL;
 
     std::vector<XrCompositionLayerProjectionView> projectionLayerViews;
+    std::vector<XrCompositionLayerDepthInfoKHR> depthInfos;
+    uint64_t poseTime = 0;
     if (fs.shouldRender == XR_TRUE)
     {
-        if (RenderLayer(instance, session, viewConfigs, stageSpace, swapchains, swapchainImages, colorToDepthMap,
-                        frameBuffer, programInfo, fs.predictedDisplayTime, projectionLayerViews, layer))
+        if (RenderLayer(instance, session, viewConfigs, stageSpace, stereoMode, swapchains, depthSwapchains,
+                        frameBufferInfo, programInfo, geometryInfo, cullInfo, visibilityMaskInfo, foveationInfo, uniformRingInfo,
+                        lateLatch, resolutionScale, fs.predictedDisplayTime, projectionLayerViews, depthInfos, layer, poseTime))
         {
             layers.push_back(reinterpret_cast<XrCompositionLayerBaseHeader*>(&layer));
         }
@@ -1390,7 +4249,14 @@ bool RenderFrame(XrInstance instance, XrSession session, std::vector<XrViewConfi
     fei.environmentBlendMode = XR_ENVIRONMENT_BLEND_MODE_OPAQUE;
     fei.layerCount = (uint32_t)layers.size();
     fei.layers = layers.data();
+    t0 = FrameStatsNow();
+    if (!layers.empty())
+    {
+        // how old the submitted poses are by the time the runtime gets them.
+        FrameStatsAddPhase(PHASE_POSE_AGE, poseTime, t0);
+    }
     result = xrEndFrame(session, &fei);
+    FrameStatsAddPhase(PHASE_END_FRAME, t0, FrameStatsNow());
     if (!CheckResult(instance, result, "xrEndFrame"))
     {
         return false;
@@ -1399,46 +4265,135 @@ bool RenderFrame(XrInstance instance, XrSession session, std::vector<XrViewConfi
     return true;
 }
 
-int main(int argc, char *argv[])
+// what the startup tasks work on, they write only their own parts of the context until they are waited for.
+struct StartupArgs
 {
-    Context context;
+    Context* context;
+    const Options* options;
+    uint64_t sceneLoadTime;
+};
+
+static bool LoadSceneTask(void* userData)
+{
+    StartupArgs& args = *(StartupArgs*)userData;
+    const uint64_t start = FrameStatsClock();
+    if (args.options->scenePath)
+    {
+        if (!SceneLoad(args.context->scene, args.options->scenePath))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        InitRoomScene(args.context->scene);
+    }
+    args.sceneLoadTime = FrameStatsClock() - start;
+    StartupTraceStep("scene load", start);
+    return true;
+}
+
+// the xr instance, system and view configurations, which need neither the window nor gl.
+static bool InitXrTask(void* userData)
+{
+    StartupArgs& args = *(StartupArgs*)userData;
+    Context& context = *args.context;
+    const Options& options = *args.options;
+
+    uint64_t stepStart = FrameStatsClock();
     if (!EnumerateExtensions(context.extensionProps))
     {
-        return 1;
+        return false;
     }
 
     if (!ExtensionSupported(context.extensionProps, XR_KHR_OPENGL_ENABLE_EXTENSION_NAME))
     {
         printf("XR_KHR_opengl_enable not supported!\n");
-        return 1;
+        return false;
     }
 
     if (!EnumerateLayers(context.layerProps))
     {
-        return 1;
+        return false;
     }
+    StartupTraceStep("xr extensions and layers", stepStart);
 
-    if (!CreateInstance(context.instance))
+    if (options.submitDepth)
     {
-        return 1;
+        context.depthLayerEnabled = ExtensionSupported(context.extensionProps, XR_KHR_COMPOSITION_LAYER_DEPTH_EXTENSION_NAME);
+        if (!context.depthLayerEnabled)
+        {
+            printf("XR_KHR_composition_layer_depth not supported, depth will not be submitted\n");
+        }
+    }
+
+    if (options.visibilityMask)
+    {
+        context.visibilityMaskEnabled = ExtensionSupported(context.extensionProps, XR_KHR_VISIBILITY_MASK_EXTENSION_NAME);
+        if (!context.visibilityMaskEnabled)
+        {
+            printf("XR_KHR_visibility_mask not supported, the whole of each view will be shaded\n");
+        }
     }
 
+    stepStart = FrameStatsClock();
+    if (!CreateInstance(context.instance, context.depthLayerEnabled, context.visibilityMaskEnabled))
+    {
+        return false;
+    }
+    StartupTraceStep("xrCreateInstance", stepStart);
+
+    stepStart = FrameStatsClock();
     if (!GetSystemId(context.instance, context.systemId))
     {
-        return 1;
+        return false;
     }
 
     if (!SupportsVR(context.instance, context.systemId))
     {
         printf("System doesn't support VR\n");
-        return 1;
+        return false;
     }
 
     if (!EnumerateViewConfigs(context.instance, context.systemId, context.viewConfigs))
+    {
+        return false;
+    }
+    StartupTraceStep("xr system and view configs", stepStart);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    StartupTraceInit();
+#if defined(XR_USE_PLATFORM_XLIB)
+    // the runtime may use xlib from the xr thread while SDL opens its display on this one,
+    // and the program worker makes its context current with glx while this thread renders.
+    XInitThreads();
+#endif
+
+    Options options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        return 1;
+    }
+
+    if (options.statsPath && !FrameStatsInit(options.statsPath))
     {
         return 1;
     }
 
+    // the scene and the xr instance don't depend on each other or on gl, so they're set up on their own threads
+    // while the window and gl context are created.  Tasks are declared after context, so an early return joins them
+    // before it is destroyed.
+    Context context;
+    StartupArgs startupArgs = {&context, &options, 0};
+    StartupTask sceneTask;
+    StartupTask xrTask;
+    StartupTaskStart(sceneTask, "scene", LoadSceneTask, &startupArgs);
+    StartupTaskStart(xrTask, "xr", InitXrTask, &startupArgs);
+
+    uint64_t stepStart = FrameStatsClock();
     if (SDL_Init(SDL_INIT_VIDEO|SDL_INIT_EVENTS) != 0)
     {
         SDL_Log("Failed to initialize SDL: %s", SDL_GetError());
@@ -1464,14 +4419,79 @@ int main(int argc, char *argv[])
         printf("glewInit failed: %s\n", glewGetErrorString(err));
         return 1;
     }
+    StartupTraceStep("window and gl context", stepStart);
 
     SDL_AddEventWatch(watch, NULL);
 
+    // dynamic resolution needs gpu times even without stats.
+    if (g_frameStatsEnabled || options.dynamicResolution)
+    {
+        GpuTimerInit();
+    }
+
+    context.stereoMode = ChooseStereoMode(options.stereoMode);
+
+    context.uniformRing = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+    if (!context.uniformRing)
+    {
+        printf("persistently mapped buffers not supported, view constants are set as uniforms\n");
+    }
+    context.lateLatch = options.lateLatch && context.uniformRing;
+    if (options.lateLatch && !context.lateLatch)
+    {
+        printf("views will not be late latched\n");
+    }
+
+    const std::string programCacheDir = options.programCacheDir ? options.programCacheDir : DefaultProgramCacheDir();
+    if (options.programCache && !programCacheDir.empty() && ProgramCacheInit(programCacheDir.c_str()))
+    {
+        printf("program cache: %s\n", programCacheDir.c_str());
+    }
+
+    bool storageBuffer = false;
+    const SubmitMode submitMode = ChooseSubmitMode(options.submitMode, storageBuffer);
+
+    // an early return from here on still stops and joins the program worker.
+    ProgramCacheAsyncScope programCacheAsyncScope;
+    if (options.asyncPrograms)
+    {
+        // the worker's context is only needed when the driver can't compile in parallel itself.
+        if (!GLEW_KHR_parallel_shader_compile && !GLEW_ARB_parallel_shader_compile)
+        {
+            SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+            workerContext = SDL_GL_CreateContext(window);
+            SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+            SDL_GL_MakeCurrent(window, gl_context);
+            if (!workerContext)
+            {
+                printf("Failed to create worker context: %s\n", SDL_GetError());
+            }
+        }
+        if (ProgramCacheInitAsync(workerContext ? MakeWorkerContextCurrent : NULL, NULL))
+        {
+            printf("programs linked in the background, %s\n",
+                   workerContext ? "on a worker thread" : "by the driver's compiler threads");
+        }
+    }
+
+    // programs link in the background, where they can, while the session is created.
+    Context::PendingProgramInfo firstProgramInfo;
+    BeginPrograms(firstProgramInfo, context.pendingProgramInfo, context.stereoMode, context.uniformRing, submitMode,
+                  storageBuffer);
+
+    if (!StartupTaskWait(xrTask))
+    {
+        return 1;
+    }
+
+    stepStart = FrameStatsClock();
     if (!CreateSession(context.instance, context.systemId, context.session))
     {
         return 1;
     }
+    StartupTraceStep("xrCreateSession", stepStart);
 
+    stepStart = FrameStatsClock();
     if (!CreateActions(context.instance, context.systemId, context.session, context.actionSet))
     {
         return 1;
@@ -1481,34 +4501,168 @@ int main(int argc, char *argv[])
     {
         return 1;
     }
+    StartupTraceStep("actions and stage space", stepStart);
+
+    stepStart = FrameStatsClock();
+    if (!WaitForProgram(context.programInfo, firstProgramInfo))
+    {
+        return 1;
+    }
+    StartupTraceStep("wait for program", stepStart);
+
+    if (context.uniformRing && !CreateUniformRing(context.uniformRingInfo))
+    {
+        return 1;
+    }
+
+    if (!StartupTaskWait(sceneTask))
+    {
+        return 1;
+    }
 
-    if (!CreateFrameBuffer(context.frameBuffer))
+    stepStart = FrameStatsClock();
+    if (!CreateGeometry(context.geometryInfo, context.scene))
+    {
+        return 1;
+    }
+    glFinish();
+    printf("scene: %u meshes, %llu vertices, %llu indices, loaded in %.2f ms, uploaded in %.2f ms\n",
+           context.scene.meshCount, (unsigned long long)context.scene.vertexCount,
+           (unsigned long long)context.scene.indexCount, (double)startupArgs.sceneLoadTime / 1e6,
+           (double)(FrameStatsClock() - stepStart) / 1e6);
+
+    CreateObjects(context.geometryInfo, context.scene, options.stressInstances);
+    if (!CreateBatch(context.geometryInfo, submitMode, storageBuffer,
+                     context.stereoMode == STEREO_LAYERED ? MAX_STEREO_VIEWS : 1))
     {
         return 1;
     }
+    if (options.stressInstances > 0)
+    {
+        printf("stress test: %u objects\n", options.stressInstances);
+    }
 
-    if (!CompileProgram(context.programInfo))
+    context.culling = options.culling;
+    if (context.culling)
+    {
+        CreateCulling(context.cullInfo, context.geometryInfo, context.scene);
+    }
+    StartupTraceStep("scene upload", stepStart);
+
+    stepStart = FrameStatsClock();
+    if (context.visibilityMaskEnabled &&
+        (!CreateVisibilityMask(context.instance, context.visibilityMaskInfo, context.stereoMode, context.uniformRing) ||
+         !UpdateVisibilityMask(context.instance, context.session, (uint32_t)context.viewConfigs.size(),
+                               context.visibilityMaskInfo)))
     {
         return 1;
     }
+    StartupTraceStep("visibility mask", stepStart);
+
+    // with a warm cache, linking is a glProgramBinary per program.
+    const ProgramCacheStats& programStats = ProgramCacheGetStats();
+    printf("programs: %u linked in %.2f ms, %u from the cache, %u compiled\n", programStats.hits + programStats.misses,
+           (double)programStats.linkTime / 1e6, programStats.hits, programStats.misses);
+
+    context.depthPolicy = options.depthPolicy;
+    context.depthFormat = options.depthFormat;
+    context.samples = options.samples;
+    context.msaaMode = options.msaaMode;
+
+    if (options.foveationRingCount > 0)
+    {
+        context.foveation = context.stereoMode == STEREO_TWO_PASS || context.stereoMode == STEREO_DOUBLE_WIDE;
+        if (!context.foveation)
+        {
+            printf("foveation needs twopass or doublewide stereo, every pixel will be rendered at full resolution\n");
+        }
+        else if (context.samples == 0)
+        {
+            // rings are blitted into the acquired images, which have to be single sampled.
+            context.samples = 1;
+        }
+    }
 
-    if (!CreateSwapchains(context.instance, context.session, context.viewConfigs,
-                          context.swapchains, context.swapchainImages))
+    if (options.dynamicResolution)
+    {
+        // the largest scale every view can be allocated at.
+        context.dynamicResolution = true;
+        context.maxResolutionScale = MAX_RESOLUTION_SCALE;
+        for (auto& viewConfig : context.viewConfigs)
+        {
+            context.maxResolutionScale = std::min(context.maxResolutionScale,
+                                                  (float)viewConfig.maxImageRectWidth / viewConfig.recommendedImageRectWidth);
+            context.maxResolutionScale = std::min(context.maxResolutionScale,
+                                                  (float)viewConfig.maxImageRectHeight / viewConfig.recommendedImageRectHeight);
+        }
+        context.maxResolutionScale = std::max(context.maxResolutionScale, 1.0f);
+        DynResInit(MIN_RESOLUTION_SCALE, context.maxResolutionScale);
+    }
+
+    stepStart = FrameStatsClock();
+    if (!CreateSwapchains(context.instance, context.session, context.viewConfigs, context.stereoMode,
+                          options.colorFormat, context.depthPolicy, context.depthFormat, context.depthLayerEnabled,
+                          context.samples, context.msaaMode, context.maxResolutionScale,
+                          context.swapchains, context.swapchainImages,
+                          context.depthSwapchains, context.depthSwapchainImages, context.frameBufferInfo))
     {
         return 1;
     }
+    StartupTraceStep("swapchains", stepStart);
+
+    if (context.foveation && context.samples > 1)
+    {
+        printf("foveation can't be used with msaa, every pixel will be rendered at full resolution\n");
+        context.foveation = false;
+    }
 
+    if (context.foveation)
+    {
+        int32_t viewWidth = 0;
+        int32_t viewHeight = 0;
+        for (auto& viewConfig : context.viewConfigs)
+        {
+            viewWidth = std::max(viewWidth, (int32_t)AllocatedViewSize(viewConfig.recommendedImageRectWidth,
+                                                                       context.maxResolutionScale, viewConfig.maxImageRectWidth));
+            viewHeight = std::max(viewHeight, (int32_t)AllocatedViewSize(viewConfig.recommendedImageRectHeight,
+                                                                         context.maxResolutionScale, viewConfig.maxImageRectHeight));
+        }
+        if (!CreateFoveation(context.foveationInfo, options.foveationRings, options.foveationRingCount,
+                             context.swapchains[0].format, context.depthFormat, viewWidth, viewHeight,
+                             !context.depthSwapchains.empty()))
+        {
+            return 1;
+        }
+    }
+
+    // an early return from the frame loop still stops and joins the pacing thread.
+    FramePacerScope framePacerScope;
     bool sessionReady = false;
     XrSessionState xrState = XR_SESSION_STATE_UNKNOWN;
+    uint64_t readyTime = 0;     // when the session last became ready, until its first frame is submitted
+    const uint64_t loopStart = FrameStatsClock();
+    uint32_t idleWaitMs = 1;
     while (!quitting)
     {
-        XrEventDataBuffer xrEvent;
-        xrEvent.type = XR_TYPE_EVENT_DATA_BUFFER;
-        xrEvent.next = NULL;
-
-        XrResult result = xrPollEvent(context.instance, &xrEvent);
-        if (result == XR_SUCCESS)
+        // drain every pending xr event, so a burst of events doesn't take several frames to handle.
+        bool eventsHandled = false;
+        while (!quitting)
         {
+            XrEventDataBuffer xrEvent;
+            xrEvent.type = XR_TYPE_EVENT_DATA_BUFFER;
+            xrEvent.next = NULL;
+
+            XrResult result = xrPollEvent(context.instance, &xrEvent);
+            if (result == XR_EVENT_UNAVAILABLE)
+            {
+                break;
+            }
+            if (!CheckResult(context.instance, result, "xrPollEvent"))
+            {
+                return 1;
+            }
+            eventsHandled = true;
+
             switch (xrEvent.type)
             {
             case XR_TYPE_EVENT_DATA_INSTANCE_LOSS_PENDING:
@@ -1537,6 +4691,12 @@ int main(int argc, char *argv[])
                         return 1;
                     }
                     sessionReady = true;
+                    readyTime = FrameStatsClock();
+                    StartupTraceStep("wait for XR_SESSION_STATE_READY", loopStart);
+                    if (options.pipelined && !FramePacerStart(context.session))
+                    {
+                        return 1;
+                    }
                     break;
                 case XR_SESSION_STATE_SYNCHRONIZED:
                     // The application has synced its frame loop with the runtime but is not visible to the user.
@@ -1553,14 +4713,23 @@ int main(int argc, char *argv[])
                 case XR_SESSION_STATE_STOPPING:
                     // The application should exit its frame loop and call xrEndSession.
                     printf("XR_SESSION_STATE_STOPPING\n");
+                    if (sessionReady)
+                    {
+                        FramePacerStop();
+                        result = xrEndSession(context.session);
+                        CheckResult(context.instance, result, "xrEndSession");
+                        sessionReady = false;
+                    }
                     break;
                 case XR_SESSION_STATE_LOSS_PENDING:
                     printf("XR_SESSION_STATE_LOSS_PENDING\n");
                     // The session is in the process of being lost. The application should destroy the current session and can optionally recreate it.
+                    quitting = true;
                     break;
                 case XR_SESSION_STATE_EXITING:
                     printf("XR_SESSION_STATE_EXITING\n");
                     // The application should end its XR experience and not automatically restart it.
+                    quitting = true;
                     break;
                 default:
                     printf("XR_SESSION_STATE_??? %d\n", (int)xrState);
@@ -1576,6 +4745,16 @@ int main(int argc, char *argv[])
                 // Receiving the XrEventDataEventsLost event structure indicates that the event queue overflowed and some events were removed at the position within the queue at which this event was found.
                 printf("xrEvent: XR_TYPE_EVENT_DATA_EVENTS_LOST\n");
                 break;
+            case XR_TYPE_EVENT_DATA_VISIBILITY_MASK_CHANGED_KHR:
+                // The hidden area of a view changed, e.g. the user adjusted the lenses, so every mesh is fetched again.
+                printf("XR_TYPE_EVENT_DATA_VISIBILITY_MASK_CHANGED_KHR\n");
+                if (context.visibilityMaskEnabled &&
+                    !UpdateVisibilityMask(context.instance, context.session, (uint32_t)context.viewConfigs.size(),
+                                          context.visibilityMaskInfo))
+                {
+                    return 1;
+                }
+                break;
             case XR_TYPE_EVENT_DATA_INTERACTION_PROFILE_CHANGED:
                 // The XrEventDataInteractionProfileChanged event is sent to the application to notify it that the active input form factor for one or more top level user paths has changed.:
                 printf("XR_TYPE_EVENT_DATA_INTERACTION_PROFILE_CHANGED\n");
@@ -1593,45 +4772,127 @@ int main(int argc, char *argv[])
             {
                 quitting = true;
             }
+            eventsHandled = true;
         }
 
         if (sessionReady)
         {
+            FrameStatsBeginFrame();
+            GpuTimerBeginFrame();
+            uint64_t frameStart = FrameStatsNow();
+
+            uint64_t t0 = FrameStatsNow();
             if (!SyncInput(context.instance, context.session, context.actionSet))
             {
                 return 1;
             }
+            FrameStatsAddPhase(PHASE_SYNC_INPUT, t0, FrameStatsNow());
+
+            XrFrameState frameState;
+            if (options.pipelined ? !DequeueFrame(context.instance, frameState) :
+                                    !WaitFrame(context.instance, context.session, frameState))
+            {
+                return 1;
+            }
+
+            if (!UpdatePendingProgram(context.programInfo, context.pendingProgramInfo))
+            {
+                return 1;
+            }
 
+            // cpu time of the frame, for dynamic resolution, not counting the wait for it.
+            const uint64_t renderStart = context.dynamicResolution ? FrameStatsClock() : 0;
             if (!RenderFrame(context.instance, context.session, context.viewConfigs,
-                             context.stageSpace, context.swapchains, context.swapchainImages,
-                             context.colorToDepthMap, context.frameBuffer, context.programInfo))
+                             context.stageSpace, context.stereoMode, context.swapchains, context.depthSwapchains,
+                             context.frameBufferInfo, context.programInfo, context.geometryInfo,
+                             context.culling ? &context.cullInfo : NULL,
+                             context.visibilityMaskEnabled ? &context.visibilityMaskInfo : NULL,
+                             context.foveation ? &context.foveationInfo : NULL,
+                             context.uniformRing ? &context.uniformRingInfo : NULL, context.lateLatch, DynResScale(),
+                             frameState))
             {
                 return 1;
             }
+
+            if (context.dynamicResolution)
+            {
+                DynResUpdate(GpuTimerLatest(PHASE_GPU_RENDER), FrameStatsClock() - renderStart,
+                             frameState.predictedDisplayPeriod);
+            }
+
+            FrameStatsAddPhase(PHASE_FRAME, frameStart, FrameStatsNow());
+            FrameStatsEndFrame();
+
+            if (readyTime != 0)
+            {
+                printf("time to first frame after XR_SESSION_STATE_READY: %.2f ms\n",
+                       (double)(FrameStatsClock() - readyTime) / 1.0e6);
+                StartupTraceStep("first frame", readyTime);
+                StartupTraceFirstFrame();
+                readyTime = 0;
+            }
+            idleWaitMs = 1;
+        }
+        else if (eventsHandled)
+        {
+            // more state changes often follow, so check again right away.
+            idleWaitMs = 1;
         }
         else
         {
-            SDL_Delay(100);
+            // nothing to do, back off gradually so an idle session doesn't spin,
+            // but a READY event is still picked up within a few milliseconds.
+            SDL_Delay(idleWaitMs);
+            idleWaitMs = std::min(idleWaitMs * 2, MAX_IDLE_WAIT_MS);
         }
+
+        FrameStatsPoll();
     }
 
+    FramePacerStop();
+    GpuTimerShutdown();
+    FrameStatsShutdown();
+
     SDL_DelEventWatch(watch, NULL);
-    SDL_GL_DeleteContext(gl_context);
 
-    glDeleteFramebuffers(1, &context.frameBuffer);
+    DestroyGeometry(context.geometryInfo);
+    SceneUnload(context.scene);
+    DestroyVisibilityMask(context.visibilityMaskInfo);
+    DestroyFoveation(context.foveationInfo);
+    DestroyUniformRing(context.uniformRingInfo);
+    DestroyFrameBuffers(context.frameBufferInfo);
 
+    // swapchain images are gl textures, so destroy them while the context is still alive.
     XrResult result;
     for (auto& swapchain : context.swapchains)
     {
         result = xrDestroySwapchain(swapchain.handle);
         CheckResult(context.instance, result, "xrDestroySwapchain");
     }
+    for (auto& swapchain : context.depthSwapchains)
+    {
+        result = xrDestroySwapchain(swapchain.handle);
+        CheckResult(context.instance, result, "xrDestroySwapchain");
+    }
+
+    ProgramCacheCancel(context.pendingProgramInfo.link);
+    ProgramCacheShutdownAsync();
+    if (workerContext)
+    {
+        SDL_GL_DeleteContext(workerContext);
+    }
+    glDeleteProgram(context.programInfo.program);
+
+    SDL_GL_DeleteContext(gl_context);
 
     result = xrDestroySpace(context.stageSpace);
     CheckResult(context.instance, result, "xrDestroySpace");
 
-    result = xrEndSession(context.session);
-    CheckResult(context.instance, result, "xrEndSession");
+    if (sessionReady)
+    {
+        result = xrEndSession(context.session);
+        CheckResult(context.instance, result, "xrEndSession");
+    }
 
     result = xrDestroySession(context.session);
     CheckResult(context.instance, result, "xrDestroySession");
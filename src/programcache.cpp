@@ -0,0 +1,647 @@
+// gl program binary cache
+
+#include "programcache.h"
+#include "framestats.h"
+
+#if defined(WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+static const uint32_t PROGRAM_CACHE_MAGIC = 0x43505850;    // "PXPC"
+static const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+// followed by the renderer and version strings, then the binary.
+struct ProgramCacheFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t binaryFormat;
+    uint32_t binarySize;
+    uint32_t driverSize;
+    uint32_t reserved;
+};
+
+static bool s_enabled = false;
+static std::string s_dir;
+static std::string s_driver;    // GL_RENDERER and GL_VERSION
+static bool s_parallel = false;    // the driver compiles in the background
+static ProgramCacheStats s_stats = {};
+
+enum ProgramLinkStage
+{
+    STAGE_LOADING = 0,      // glProgramBinary
+    STAGE_COMPILING,        // glCompileShader
+    STAGE_LINKING,          // glLinkProgram
+    STAGE_DONE,
+};
+
+struct ProgramLink
+{
+    std::string vertSource;
+    std::string fragSource;
+    std::vector<std::string> attribNames;
+    uint64_t key = 0;
+    std::string path;
+
+    ProgramLinkStage stage = STAGE_COMPILING;
+    GLuint vertShader = 0;
+    GLuint fragShader = 0;
+    GLuint program = 0;
+    bool hit = false;
+
+    // worker thread links, written by the worker before status.
+    std::atomic<int> status{PROGRAM_LINK_PENDING};
+    bool cancelled = false;     // guarded by s_workerMutex
+};
+
+static std::thread s_worker;
+static std::mutex s_workerMutex;
+static std::condition_variable s_workerWake;
+static std::deque<ProgramLink*> s_workerQueue;
+static ProgramLink* s_workerCurrent = NULL;
+static bool s_workerStop = false;
+static bool s_workerRunning = false;
+
+static void MakeDir(const std::string& dir)
+{
+    // every parent first, ignoring those that already exist.
+    for (size_t i = 1; i <= dir.size(); i++)
+    {
+        if (i == dir.size() || dir[i] == '/' || dir[i] == '\\')
+        {
+            const std::string parent = dir.substr(0, i);
+#if defined(WIN32)
+            _mkdir(parent.c_str());
+#else
+            mkdir(parent.c_str(), 0755);
+#endif
+        }
+    }
+}
+
+// 64 bit FNV-1a, continued from hash.
+static uint64_t Hash(uint64_t hash, const void* data, size_t size)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// strings are hashed with their terminator, so "ab" + "c" and "a" + "bc" differ.
+static uint64_t HashString(uint64_t hash, const char* str)
+{
+    return Hash(hash, str, strlen(str) + 1);
+}
+
+bool ProgramCacheInit(const char* dir)
+{
+    if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary)
+    {
+        printf("program binaries not supported, programs will be compiled every run\n");
+        return false;
+    }
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    if (formatCount <= 0)
+    {
+        printf("no program binary formats, programs will be compiled every run\n");
+        return false;
+    }
+
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+    const char* version = (const char*)glGetString(GL_VERSION);
+    s_driver = std::string(renderer ? renderer : "") + "\n" + (version ? version : "");
+    s_dir = dir;
+    MakeDir(s_dir);
+    s_enabled = true;
+    return true;
+}
+
+static void InitLink(ProgramLink& link, const char* vertSource, const char* fragSource, const char* const* attribNames,
+                     uint32_t attribCount)
+{
+    link.vertSource = vertSource;
+    link.fragSource = fragSource;
+    link.attribNames.assign(attribNames, attribNames + attribCount);
+
+    uint64_t key = 0xcbf29ce484222325ull;
+    key = HashString(key, vertSource);
+    key = HashString(key, fragSource);
+    for (uint32_t i = 0; i < attribCount; i++)
+    {
+        key = HashString(key, attribNames[i]);
+    }
+    link.key = HashString(key, s_driver.c_str());
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)link.key);
+    link.path = s_dir + name;
+}
+
+static bool CompileStatus(GLuint shader, GLenum type)
+{
+    GLint compiled;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled)
+    {
+        GLint logLength = 0;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+        std::vector<char> log(logLength > 0 ? logLength : 1, '\0');
+        glGetShaderInfoLog(shader, (GLsizei)log.size(), NULL, log.data());
+        printf("Failed to compile %s shader:\n%s\n", type == GL_VERTEX_SHADER ? "vertex" : "fragment", log.data());
+    }
+    return (bool)compiled;
+}
+
+static bool LinkStatus(GLuint program, bool printLog)
+{
+    GLint linked;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked && printLog)
+    {
+        GLint logLength = 0;
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+        std::vector<char> log(logLength > 0 ? logLength : 1, '\0');
+        glGetProgramInfoLog(program, (GLsizei)log.size(), NULL, log.data());
+        printf("Failed to link program:\n%s\n", log.data());
+    }
+    return (bool)linked;
+}
+
+// hands the binary saved for the link to glProgramBinary, false if there isn't one or it doesn't match.
+// Whether the driver took it is only known from the link status.
+static bool BeginLoad(ProgramLink& link)
+{
+    FILE* fp = fopen(link.path.c_str(), "rb");
+    if (!fp)
+    {
+        return false;
+    }
+    ProgramCacheFileHeader header;
+    std::string driver;
+    std::vector<uint8_t> binary;
+    bool ok = fread(&header, sizeof(header), 1, fp) == 1 && header.magic == PROGRAM_CACHE_MAGIC &&
+              header.version == PROGRAM_CACHE_VERSION && header.key == link.key &&
+              header.driverSize == s_driver.size();
+    if (ok)
+    {
+        driver.resize(header.driverSize);
+        binary.resize(header.binarySize);
+        ok = (driver.empty() || fread(&driver[0], driver.size(), 1, fp) == 1) && driver == s_driver &&
+             !binary.empty() && fread(binary.data(), binary.size(), 1, fp) == 1;
+    }
+    fclose(fp);
+    if (!ok)
+    {
+        return false;
+    }
+
+    link.program = glCreateProgram();
+    glProgramBinary(link.program, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+    link.stage = STAGE_LOADING;
+    return true;
+}
+
+// saves the program's binary under path, through a temporary file so a reader never sees half of it.
+static void SaveBinary(const ProgramLink& link)
+{
+    GLint binarySize = 0;
+    glGetProgramiv(link.program, GL_PROGRAM_BINARY_LENGTH, &binarySize);
+    if (binarySize <= 0)
+    {
+        return;
+    }
+    std::vector<uint8_t> binary(binarySize);
+    GLenum binaryFormat = 0;
+    glGetProgramBinary(link.program, binarySize, &binarySize, &binaryFormat, binary.data());
+    if (glGetError() != GL_NO_ERROR)
+    {
+        return;
+    }
+
+    ProgramCacheFileHeader header = {};
+    header.magic = PROGRAM_CACHE_MAGIC;
+    header.version = PROGRAM_CACHE_VERSION;
+    header.key = link.key;
+    header.binaryFormat = binaryFormat;
+    header.binarySize = (uint32_t)binarySize;
+    header.driverSize = (uint32_t)s_driver.size();
+
+    const std::string tempPath = link.path + ".tmp";
+    FILE* fp = fopen(tempPath.c_str(), "wb");
+    if (!fp)
+    {
+        printf("Failed to write program cache file \"%s\": %s\n", tempPath.c_str(), strerror(errno));
+        return;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+              (s_driver.empty() || fwrite(s_driver.data(), s_driver.size(), 1, fp) == 1) &&
+              fwrite(binary.data(), (size_t)binarySize, 1, fp) == 1;
+    ok = fclose(fp) == 0 && ok;
+#if defined(WIN32)
+    remove(link.path.c_str());
+#endif
+    if (!ok || rename(tempPath.c_str(), link.path.c_str()) != 0)
+    {
+        printf("Failed to write program cache file \"%s\"\n", link.path.c_str());
+        remove(tempPath.c_str());
+    }
+}
+
+static void BeginCompile(ProgramLink& link)
+{
+    // a fresh program, one that failed glProgramBinary may have been left in an odd state.
+    if (link.program)
+    {
+        glDeleteProgram(link.program);
+        link.program = 0;
+    }
+    const char* sources[2] = {link.vertSource.c_str(), link.fragSource.c_str()};
+    GLuint* shaders[2] = {&link.vertShader, &link.fragShader};
+    const GLenum types[2] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER};
+    for (int i = 0; i < 2; i++)
+    {
+        *shaders[i] = glCreateShader(types[i]);
+        int size = (int)strlen(sources[i]);
+        glShaderSource(*shaders[i], 1, (const GLchar**)&sources[i], &size);
+        glCompileShader(*shaders[i]);
+    }
+    link.stage = STAGE_COMPILING;
+}
+
+static void DeleteShaders(ProgramLink& link)
+{
+    glDeleteShader(link.vertShader);
+    glDeleteShader(link.fragShader);
+    link.vertShader = 0;
+    link.fragShader = 0;
+}
+
+static void DeleteLink(ProgramLink& link)
+{
+    DeleteShaders(link);
+    if (link.program)
+    {
+        glDeleteProgram(link.program);
+        link.program = 0;
+    }
+}
+
+// false if either shader failed to compile.
+static bool BeginLink(ProgramLink& link)
+{
+    if (!CompileStatus(link.vertShader, GL_VERTEX_SHADER) || !CompileStatus(link.fragShader, GL_FRAGMENT_SHADER))
+    {
+        DeleteShaders(link);
+        return false;
+    }
+    link.program = glCreateProgram();
+    glAttachShader(link.program, link.vertShader);
+    glAttachShader(link.program, link.fragShader);
+    for (uint32_t i = 0; i < (uint32_t)link.attribNames.size(); i++)
+    {
+        glBindAttribLocation(link.program, i, link.attribNames[i].c_str());
+    }
+    if (s_enabled)
+    {
+        glProgramParameteri(link.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(link.program);
+    DeleteShaders(link);
+    link.stage = STAGE_LINKING;
+    return true;
+}
+
+// false if the program failed to link.
+static bool EndLink(ProgramLink& link)
+{
+    if (!LinkStatus(link.program, true))
+    {
+        DeleteLink(link);
+        return false;
+    }
+    if (s_enabled)
+    {
+        SaveBinary(link);
+    }
+    link.stage = STAGE_DONE;
+    return true;
+}
+
+// every stage in turn, blocking on each, returns the program or 0.
+static GLuint LinkNow(ProgramLink& link)
+{
+    if (s_enabled && BeginLoad(link))
+    {
+        if (LinkStatus(link.program, false))
+        {
+            link.hit = true;
+            link.stage = STAGE_DONE;
+            return link.program;
+        }
+    }
+    BeginCompile(link);
+    if (!BeginLink(link) || !EndLink(link))
+    {
+        return 0;
+    }
+    return link.program;
+}
+
+GLuint ProgramCacheLink(const char* vertSource, const char* fragSource, const char* const* attribNames,
+                        uint32_t attribCount)
+{
+    const uint64_t start = FrameStatsClock();
+    ProgramLink link;
+    InitLink(link, vertSource, fragSource, attribNames, attribCount);
+    const GLuint program = LinkNow(link);
+    if (program)
+    {
+        (link.hit ? s_stats.hits : s_stats.misses)++;
+    }
+    s_stats.linkTime += FrameStatsClock() - start;
+    return program;
+}
+
+//
+// background linking
+//
+
+bool ProgramCacheAsync()
+{
+    return s_parallel || s_workerRunning;
+}
+
+static void WorkerThread(void (*makeCurrent)(bool current, void* userData), void* userData)
+{
+    makeCurrent(true, userData);
+    std::unique_lock<std::mutex> lock(s_workerMutex);
+    while (true)
+    {
+        s_workerWake.wait(lock, [] { return s_workerStop || !s_workerQueue.empty(); });
+        if (s_workerStop)
+        {
+            break;
+        }
+        ProgramLink* link = s_workerQueue.front();
+        s_workerQueue.pop_front();
+        s_workerCurrent = link;
+        lock.unlock();
+
+        // finished before it is handed over, so the program is complete when the render thread binds it.
+        const GLuint program = LinkNow(*link);
+        glFinish();
+
+        lock.lock();
+        s_workerCurrent = NULL;
+        if (link->cancelled)
+        {
+            DeleteLink(*link);
+            delete link;
+        }
+        else
+        {
+            link->status.store(program ? PROGRAM_LINK_READY : PROGRAM_LINK_FAILED, std::memory_order_release);
+        }
+    }
+    lock.unlock();
+    makeCurrent(false, userData);
+}
+
+bool ProgramCacheInitAsync(void (*makeCurrent)(bool current, void* userData), void* userData)
+{
+    s_parallel = GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+    if (s_parallel)
+    {
+        // as many driver threads as it likes.
+        if (GLEW_KHR_parallel_shader_compile)
+        {
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        }
+        else
+        {
+            glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+        }
+        return true;
+    }
+    if (!makeCurrent)
+    {
+        return false;
+    }
+    s_workerStop = false;
+    s_workerRunning = true;
+    s_worker = std::thread(WorkerThread, makeCurrent, userData);
+    return true;
+}
+
+void ProgramCacheShutdownAsync()
+{
+    if (!s_workerRunning)
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(s_workerMutex);
+        s_workerStop = true;
+    }
+    s_workerWake.notify_one();
+    s_worker.join();
+    s_workerRunning = false;
+
+    // links it never got to are left for their owners to poll, they fail.
+    for (ProgramLink* link : s_workerQueue)
+    {
+        link->status.store(PROGRAM_LINK_FAILED, std::memory_order_release);
+    }
+    s_workerQueue.clear();
+}
+
+ProgramCacheAsyncScope::~ProgramCacheAsyncScope()
+{
+    ProgramCacheShutdownAsync();
+}
+
+ProgramLink* ProgramCacheLinkAsync(const char* vertSource, const char* fragSource, const char* const* attribNames,
+                                   uint32_t attribCount)
+{
+    const uint64_t start = FrameStatsClock();
+    ProgramLink* link = new ProgramLink();
+    InitLink(*link, vertSource, fragSource, attribNames, attribCount);
+    if (s_workerRunning)
+    {
+        {
+            std::lock_guard<std::mutex> lock(s_workerMutex);
+            s_workerQueue.push_back(link);
+        }
+        s_workerWake.notify_one();
+    }
+    else if (s_parallel)
+    {
+        if (!(s_enabled && BeginLoad(*link)))
+        {
+            BeginCompile(*link);
+        }
+    }
+    else
+    {
+        const GLuint program = LinkNow(*link);
+        link->status.store(program ? PROGRAM_LINK_READY : PROGRAM_LINK_FAILED, std::memory_order_relaxed);
+    }
+    s_stats.linkTime += FrameStatsClock() - start;
+    return link;
+}
+
+static bool Complete(GLuint object, bool isProgram)
+{
+    GLint complete = GL_TRUE;
+    if (isProgram)
+    {
+        glGetProgramiv(object, GL_COMPLETION_STATUS_KHR, &complete);
+    }
+    else
+    {
+        glGetShaderiv(object, GL_COMPLETION_STATUS_KHR, &complete);
+    }
+    return complete == GL_TRUE;
+}
+
+// moves a parallel link on by as many stages as have completed.
+static ProgramLinkStatus StepParallel(ProgramLink& link)
+{
+    if (link.stage == STAGE_LOADING)
+    {
+        if (!Complete(link.program, true))
+        {
+            return PROGRAM_LINK_PENDING;
+        }
+        if (LinkStatus(link.program, false))
+        {
+            link.hit = true;
+            link.stage = STAGE_DONE;
+            return PROGRAM_LINK_READY;
+        }
+        BeginCompile(link);
+    }
+    if (link.stage == STAGE_COMPILING)
+    {
+        if (!Complete(link.vertShader, false) || !Complete(link.fragShader, false))
+        {
+            return PROGRAM_LINK_PENDING;
+        }
+        if (!BeginLink(link))
+        {
+            return PROGRAM_LINK_FAILED;
+        }
+    }
+    if (link.stage == STAGE_LINKING)
+    {
+        if (!Complete(link.program, true))
+        {
+            return PROGRAM_LINK_PENDING;
+        }
+        if (!EndLink(link))
+        {
+            return PROGRAM_LINK_FAILED;
+        }
+    }
+    return PROGRAM_LINK_READY;
+}
+
+static ProgramLinkStatus Poll(ProgramLink*& link, GLuint& program)
+{
+    ProgramLinkStatus status;
+    if (s_parallel)
+    {
+        status = StepParallel(*link);
+    }
+    else
+    {
+        status = (ProgramLinkStatus)link->status.load(std::memory_order_acquire);
+    }
+
+    program = 0;
+    if (status != PROGRAM_LINK_PENDING)
+    {
+        if (status == PROGRAM_LINK_READY)
+        {
+            program = link->program;
+            (link->hit ? s_stats.hits : s_stats.misses)++;
+        }
+        delete link;
+        link = NULL;
+    }
+    return status;
+}
+
+ProgramLinkStatus ProgramCachePoll(ProgramLink*& link, GLuint& program)
+{
+    const uint64_t start = FrameStatsClock();
+    const ProgramLinkStatus status = Poll(link, program);
+    s_stats.linkTime += FrameStatsClock() - start;
+    return status;
+}
+
+ProgramLinkStatus ProgramCacheWait(ProgramLink*& link, GLuint& program)
+{
+    const uint64_t start = FrameStatsClock();
+    ProgramLinkStatus status;
+    while ((status = Poll(link, program)) == PROGRAM_LINK_PENDING)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    s_stats.linkTime += FrameStatsClock() - start;
+    return status;
+}
+
+void ProgramCacheCancel(ProgramLink*& link)
+{
+    if (!link)
+    {
+        return;
+    }
+    if (s_workerRunning)
+    {
+        // the worker deletes the one it is working on when it is done with it.
+        std::lock_guard<std::mutex> lock(s_workerMutex);
+        if (link == s_workerCurrent)
+        {
+            link->cancelled = true;
+            link = NULL;
+            return;
+        }
+        for (auto it = s_workerQueue.begin(); it != s_workerQueue.end(); ++it)
+        {
+            if (*it == link)
+            {
+                s_workerQueue.erase(it);
+                break;
+            }
+        }
+    }
+    DeleteLink(*link);
+    delete link;
+    link = NULL;
+}
+
+const ProgramCacheStats& ProgramCacheGetStats()
+{
+    return s_stats;
+}
@@ -0,0 +1,79 @@
+// gl program binary cache
+//
+// Linked programs are saved to a directory with glGetProgramBinary and loaded back with glProgramBinary on later
+// runs, skipping compilation.  Each file is named by a hash of everything the binary depends on: the shader
+// sources, the attribute bindings, GL_RENDERER and GL_VERSION.  The renderer and version strings are also stored
+// in the file and compared on load, and a binary the driver refuses (after a driver update with the same version
+// string, say) is compiled again and replaces the file.
+//
+// Programs can also be linked without blocking the caller.  With GL_KHR_parallel_shader_compile the driver
+// compiles on its own threads, and each poll moves the program one step on once GL_COMPLETION_STATUS_KHR says the
+// last one is done.  Without it, programs are linked on a worker thread with a context sharing the caller's
+// objects, if one was given to ProgramCacheInitAsync, or else linked right away.
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstdint>
+
+struct ProgramCacheStats
+{
+    uint32_t hits;          // programs loaded from a binary
+    uint32_t misses;        // programs compiled from source, and saved if the cache is enabled
+    uint64_t linkTime;      // nanoseconds the calling thread spent in ProgramCacheLink, Poll and Wait
+};
+
+// enables the cache in dir, which is created if it doesn't exist, call after glewInit().  Returns false if the
+// implementation can't return program binaries, ProgramCacheLink then always compiles.
+bool ProgramCacheInit(const char* dir);
+
+// links a program from vertex and fragment shader sources, from the cache when it has a binary of them.  Attribute
+// attribNames[i] is bound to location i before linking.  Returns 0 and prints the info log on failure.
+GLuint ProgramCacheLink(const char* vertSource, const char* fragSource, const char* const* attribNames,
+                        uint32_t attribCount);
+
+// a program being linked in the background.
+struct ProgramLink;
+
+enum ProgramLinkStatus
+{
+    PROGRAM_LINK_PENDING = 0,
+    PROGRAM_LINK_READY,
+    PROGRAM_LINK_FAILED,
+};
+
+// true when programs are linked in the background, by the driver or the worker thread.
+bool ProgramCacheAsync();
+
+// sets up linking in the background, call after glewInit().  Uses parallel compilation if the driver has it, or
+// else starts a worker thread, if makeCurrent is given.  makeCurrent(true, userData) is called on the worker to
+// make current a context that shares objects with the caller's, and makeCurrent(false, userData) before it exits.
+// Returns false if programs will be linked right away.
+bool ProgramCacheInitAsync(void (*makeCurrent)(bool current, void* userData), void* userData);
+
+// stops the worker thread after the link it is working on, links it hasn't started fail.  Call with the gl context
+// still current.
+void ProgramCacheShutdownAsync();
+
+// calls ProgramCacheShutdownAsync() when it goes out of scope, so returning early doesn't leave the worker running.
+struct ProgramCacheAsyncScope
+{
+    ~ProgramCacheAsyncScope();
+};
+
+// starts linking a program like ProgramCacheLink, poll it until it is no longer pending.
+ProgramLink* ProgramCacheLinkAsync(const char* vertSource, const char* fragSource, const char* const* attribNames,
+                                   uint32_t attribCount);
+
+// checks on the link without blocking.  When it is no longer pending, program is set to the linked program, or 0,
+// and link is freed and set to NULL.
+ProgramLinkStatus ProgramCachePoll(ProgramLink*& link, GLuint& program);
+
+// blocks until the link is no longer pending, then finishes it like ProgramCachePoll.
+ProgramLinkStatus ProgramCacheWait(ProgramLink*& link, GLuint& program);
+
+// abandons the link, deleting whatever it made so far.
+void ProgramCacheCancel(ProgramLink*& link);
+
+const ProgramCacheStats& ProgramCacheGetStats();
@@ -0,0 +1,203 @@
+// scene geometry
+
+#include "scene.h"
+
+#if defined(WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
+
+static bool MapFile(const char* path, void*& mapping, size_t& size)
+{
+#if defined(WIN32)
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE fileMapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!fileMapping)
+    {
+        return false;
+    }
+    // the view keeps the mapping alive.
+    mapping = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(fileMapping);
+    size = (size_t)fileSize.QuadPart;
+    return mapping != NULL;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+    size = (size_t)st.st_size;
+    mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        mapping = NULL;
+        return false;
+    }
+    // the whole file is uploaded right after loading, so let the kernel read ahead.  The advice values
+    // aren't flags that can be combined, each takes its own call.
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    madvise(mapping, size, MADV_WILLNEED);
+    return true;
+#endif
+}
+
+static void UnmapFile(void* mapping, size_t size)
+{
+#if defined(WIN32)
+    (void)size;
+    UnmapViewOfFile(mapping);
+#else
+    munmap(mapping, size);
+#endif
+}
+
+// true if count elements of elementSize at offset are aligned and inside a file of fileSize bytes.
+static bool BlockValid(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t fileSize)
+{
+    return offset % SCENE_FILE_ALIGNMENT == 0 && offset <= fileSize && count <= (fileSize - offset) / elementSize;
+}
+
+// largest of count indices, 0 if there are none.
+template <typename T>
+static uint32_t MaxIndex(const T* indices, uint32_t count)
+{
+    uint32_t maxIndex = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        maxIndex = indices[i] > maxIndex ? indices[i] : maxIndex;
+    }
+    return maxIndex;
+}
+
+bool SceneLoad(Scene& scene, const char* path)
+{
+    scene = Scene();
+    if (!MapFile(path, scene.mapping, scene.mappingSize))
+    {
+        printf("Failed to map scene file \"%s\"\n", path);
+        return false;
+    }
+
+    const char* error = NULL;
+    const uint8_t* base = (const uint8_t*)scene.mapping;
+    const SceneFileHeader* header = (const SceneFileHeader*)base;
+    if (scene.mappingSize < sizeof(SceneFileHeader) || memcmp(header->magic, SCENE_FILE_MAGIC, sizeof(SCENE_FILE_MAGIC)) != 0)
+    {
+        error = "not a scene file";
+    }
+    else if (header->version != SCENE_FILE_VERSION)
+    {
+        error = "unsupported version";
+    }
+    else if (header->indexSize != 2 && header->indexSize != 4)
+    {
+        error = "bad index size";
+    }
+    else if (!BlockValid(header->meshOffset, header->meshCount, sizeof(SceneFileMesh), scene.mappingSize) ||
+             !BlockValid(header->vertexOffset, header->vertexCount, 3 * sizeof(float), scene.mappingSize) ||
+             !BlockValid(header->indexOffset, header->indexCount, header->indexSize, scene.mappingSize))
+    {
+        error = "truncated or misaligned";
+    }
+    else
+    {
+        const SceneFileMesh* meshes = (const SceneFileMesh*)(base + header->meshOffset);
+        for (uint32_t i = 0; i < header->meshCount && !error; i++)
+        {
+            const SceneFileMesh& mesh = meshes[i];
+            if (mesh.primitive != SCENE_LINES && mesh.primitive != SCENE_TRIANGLES)
+            {
+                error = "bad mesh primitive";
+            }
+            else if ((uint64_t)mesh.baseVertex + mesh.vertexCount > header->vertexCount ||
+                     (uint64_t)mesh.firstIndex + mesh.indexCount > header->indexCount)
+            {
+                error = "mesh out of range";
+            }
+            else if (mesh.indexCount > 0)
+            {
+                // an index past the mesh's vertices would have the gpu read outside the vertex buffer.
+                const uint8_t* indices = base + header->indexOffset + (uint64_t)mesh.firstIndex * header->indexSize;
+                const uint32_t maxIndex = header->indexSize == 2 ? MaxIndex((const uint16_t*)indices, mesh.indexCount) :
+                                                                   MaxIndex((const uint32_t*)indices, mesh.indexCount);
+                if (maxIndex >= mesh.vertexCount)
+                {
+                    error = "index out of range";
+                }
+            }
+        }
+    }
+
+    if (error)
+    {
+        printf("Failed to load scene file \"%s\": %s\n", path, error);
+        SceneUnload(scene);
+        return false;
+    }
+
+    scene.meshes = (const SceneFileMesh*)(base + header->meshOffset);
+    scene.meshCount = header->meshCount;
+    scene.positions = (const float*)(base + header->vertexOffset);
+    scene.vertexCount = header->vertexCount;
+    scene.indices = base + header->indexOffset;
+    scene.indexCount = header->indexCount;
+    scene.indexSize = header->indexSize;
+    return true;
+}
+
+void SceneUnload(Scene& scene)
+{
+    if (scene.mapping)
+    {
+        UnmapFile(scene.mapping, scene.mappingSize);
+    }
+    scene = Scene();
+}
+
+void SceneComputeBounds(const float* positions, uint32_t count, float* boundsMin, float* boundsMax)
+{
+    for (int j = 0; j < 3; j++)
+    {
+        boundsMin[j] = count > 0 ? FLT_MAX : 0.0f;
+        boundsMax[j] = count > 0 ? -FLT_MAX : 0.0f;
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            const float p = positions[i * 3 + j];
+            boundsMin[j] = p < boundsMin[j] ? p : boundsMin[j];
+            boundsMax[j] = p > boundsMax[j] ? p : boundsMax[j];
+        }
+    }
+    boundsMin[3] = 0.0f;
+    boundsMax[3] = 0.0f;
+}
@@ -0,0 +1,84 @@
+// scene geometry
+//
+// A scene is a set of meshes sharing one position array and one index array, loaded from a compact binary file
+// that is memory mapped and used in place: the header and indices are validated and the arrays are pointed at,
+// nothing is parsed or copied.  The arrays go straight from the mapping into gpu buffers.  Files are written by
+// openxrstub_meshconv, see tools/meshconv.cpp.
+//
+// File layout, little endian, every block aligned to SCENE_FILE_ALIGNMENT bytes:
+//
+//     SceneFileHeader
+//     SceneFileMesh       meshes[meshCount]
+//     float               positions[vertexCount * 3]
+//     uint16_t/uint32_t   indices[indexCount]
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+static const char SCENE_FILE_MAGIC[8] = {'X', 'R', 'S', 'C', 'E', 'N', 'E', '\0'};
+static const uint32_t SCENE_FILE_VERSION = 1;
+static const uint32_t SCENE_FILE_ALIGNMENT = 16;
+
+enum ScenePrimitive
+{
+    SCENE_LINES = 0,
+    SCENE_TRIANGLES = 1
+};
+
+struct SceneFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t meshCount;
+    uint32_t indexSize;         // 2 or 4 bytes
+    uint32_t reserved;
+    uint64_t meshOffset;        // offsets are from the start of the file
+    uint64_t vertexOffset;
+    uint64_t vertexCount;
+    uint64_t indexOffset;
+    uint64_t indexCount;
+};
+
+struct SceneFileMesh
+{
+    uint32_t primitive;         // ScenePrimitive
+    uint32_t baseVertex;        // added to each of the mesh's indices
+    uint32_t vertexCount;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t reserved[3];
+    float color[4];
+    float boundsMin[4];         // w is unused, so bounds can be loaded as vectors
+    float boundsMax[4];
+};
+
+static_assert(sizeof(SceneFileHeader) % SCENE_FILE_ALIGNMENT == 0, "SceneFileHeader must keep the blocks after it aligned");
+static_assert(sizeof(SceneFileMesh) % SCENE_FILE_ALIGNMENT == 0, "SceneFileMesh must keep the blocks after it aligned");
+
+// the arrays of a scene, pointing into the file mapping, or at arrays owned by the caller.
+struct Scene
+{
+    const SceneFileMesh* meshes = NULL;
+    uint32_t meshCount = 0;
+    const float* positions = NULL;
+    uint64_t vertexCount = 0;
+    const void* indices = NULL;
+    uint64_t indexCount = 0;
+    uint32_t indexSize = 2;
+
+    void* mapping = NULL;
+    size_t mappingSize = 0;
+};
+
+// maps the file and checks that its header and mesh table are consistent, and that every index is inside its
+// mesh's vertices.  The index check reads the whole index array, which the upload right after would fault in
+// anyway.  Prints why and returns false if the file can't be used.
+bool SceneLoad(Scene& scene, const char* path);
+
+// unmaps the file, the scene's arrays must no longer be used.
+void SceneUnload(Scene& scene);
+
+// bounds of count positions, with w set to 0.
+void SceneComputeBounds(const float* positions, uint32_t count, float* boundsMin, float* boundsMax);
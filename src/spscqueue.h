@@ -0,0 +1,50 @@
+// lock-free single producer, single consumer queue
+//
+// A fixed size ring, one thread may Push and one other thread may Pop without locking.  Neither call
+// blocks, Push fails when the queue is full and Pop fails when it is empty.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+template <typename T, uint32_t CAPACITY>
+class SpscQueue
+{
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of two");
+
+public:
+    SpscQueue() : head(0), tail(0) {}
+
+    // producer thread only.
+    bool Push(const T& item)
+    {
+        const uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == CAPACITY)
+        {
+            return false;
+        }
+        items[t & (CAPACITY - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer thread only.
+    bool Pop(T& item)
+    {
+        const uint32_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        item = items[h & (CAPACITY - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // head and tail on separate cache lines, so the two threads don't fight over one.
+    alignas(64) std::atomic<uint32_t> head;
+    alignas(64) std::atomic<uint32_t> tail;
+    T items[CAPACITY];
+};
@@ -0,0 +1,95 @@
+// startup tasks and trace
+
+#include "startup.h"
+#include "framestats.h"
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <cstdio>
+
+struct StartupStep
+{
+    std::string name;
+    const char* thread;
+    uint64_t start;
+    uint64_t end;
+};
+
+static std::mutex s_mutex;
+static std::vector<StartupStep> s_steps;
+static uint64_t s_origin = 0;
+static bool s_printed = false;
+static thread_local const char* s_threadName = "main";
+
+StartupTask::~StartupTask()
+{
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+}
+
+void StartupTraceInit()
+{
+    s_origin = FrameStatsClock();
+}
+
+void StartupTraceThread(const char* name)
+{
+    s_threadName = name;
+}
+
+static void AddStep(std::string name, uint64_t start)
+{
+    const uint64_t end = FrameStatsClock();
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_steps.push_back({std::move(name), s_threadName, start, end});
+}
+
+void StartupTraceStep(const char* name, uint64_t start)
+{
+    AddStep(name, start);
+}
+
+void StartupTraceFirstFrame()
+{
+    if (s_printed)
+    {
+        return;
+    }
+    s_printed = true;
+    const uint64_t end = FrameStatsClock();
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    std::stable_sort(s_steps.begin(), s_steps.end(),
+                     [](const StartupStep& a, const StartupStep& b) { return a.start < b.start; });
+    printf("startup trace, ms since start:\n");
+    for (const StartupStep& step : s_steps)
+    {
+        printf("    %9.2f + %8.2f  %-6s %s\n", (double)(step.start - s_origin) / 1e6,
+               (double)(step.end - step.start) / 1e6, step.thread, step.name.c_str());
+    }
+    printf("time to first xrEndFrame: %.2f ms\n", (double)(end - s_origin) / 1e6);
+}
+
+void StartupTaskStart(StartupTask& task, const char* name, bool (*fn)(void* userData), void* userData)
+{
+    task.name = name;
+    task.thread = std::thread([&task, name, fn, userData]()
+    {
+        StartupTraceThread(name);
+        task.result = fn(userData);
+    });
+}
+
+bool StartupTaskWait(StartupTask& task)
+{
+    const uint64_t start = FrameStatsClock();
+    task.thread.join();
+    AddStep(std::string("wait for ") + task.name, start);
+    return task.result;
+}
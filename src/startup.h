@@ -0,0 +1,43 @@
+// startup tasks and trace
+//
+// Startup runs as a small dependency graph rather than a straight line.  Steps that don't depend on each other run
+// on their own threads, the xr instance and system queries while the main thread creates the window and gl
+// context, and the scene load while the session is created, and each is waited for just before the first step
+// that needs it.
+//
+// Every step records when it began and ended, and on which thread.  The trace is printed once the first frame has
+// been submitted with xrEndFrame, along with the time since StartupTraceInit(), so it shows which steps overlapped
+// and which the first frame waited on.
+
+#pragma once
+
+#include <cstdint>
+#include <thread>
+
+// a step run on its own thread.  The thread is joined when the task is destroyed, if it hasn't been waited for.
+struct StartupTask
+{
+    std::thread thread;
+    const char* name = NULL;
+    bool result = false;
+
+    ~StartupTask();
+};
+
+// starts timing startup, call first thing in main().
+void StartupTraceInit();
+
+// names the calling thread in the trace, the thread calling StartupTraceInit() is "main".
+void StartupTraceThread(const char* name);
+
+// records a step of the calling thread, from start, a FrameStatsClock() time, until now.
+void StartupTraceStep(const char* name, uint64_t start);
+
+// prints the trace and the time to the first frame, call after every xrEndFrame, only the first one prints.
+void StartupTraceFirstFrame();
+
+// runs fn(userData) on a new thread, named name in the trace.
+void StartupTaskStart(StartupTask& task, const char* name, bool (*fn)(void* userData), void* userData);
+
+// waits for the task, the wait is recorded as a step of the calling thread.  Returns what fn returned.
+bool StartupTaskWait(StartupTask& task);
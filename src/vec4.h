@@ -0,0 +1,84 @@
+// 4-wide float vectors
+//
+// The handful of operations the math and culling kernels need, on SSE on x86, NEON on ARM, or plain floats
+// elsewhere, picked at compile time.  Comparisons return a Mask4 with all bits of a lane set where they hold.
+// Only included by the kernels' .cpp files.
+
+#pragma once
+
+#include <cstdint>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+
+#include <xmmintrin.h>
+
+#define VEC4_BACKEND "sse"
+
+typedef __m128 Vec4;
+typedef __m128 Mask4;
+static inline Vec4 Load(const float* p) { return _mm_loadu_ps(p); }
+static inline void Store(float* p, Vec4 v) { _mm_storeu_ps(p, v); }
+static inline Vec4 Splat(float f) { return _mm_set1_ps(f); }
+static inline Vec4 Add(Vec4 a, Vec4 b) { return _mm_add_ps(a, b); }
+static inline Vec4 Mul(Vec4 a, Vec4 b) { return _mm_mul_ps(a, b); }
+static inline Vec4 MulAdd(Vec4 a, Vec4 b, Vec4 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+static inline Mask4 Less(Vec4 a, Vec4 b) { return _mm_cmplt_ps(a, b); }
+static inline Mask4 Or(Mask4 a, Mask4 b) { return _mm_or_ps(a, b); }
+static inline Vec4 Select(Mask4 m, Vec4 a, Vec4 b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+static inline uint32_t MoveMask(Mask4 m) { return (uint32_t)_mm_movemask_ps(m); }
+
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+
+#include <arm_neon.h>
+
+#define VEC4_BACKEND "neon"
+
+typedef float32x4_t Vec4;
+typedef uint32x4_t Mask4;
+static inline Vec4 Load(const float* p) { return vld1q_f32(p); }
+static inline void Store(float* p, Vec4 v) { vst1q_f32(p, v); }
+static inline Vec4 Splat(float f) { return vdupq_n_f32(f); }
+static inline Vec4 Add(Vec4 a, Vec4 b) { return vaddq_f32(a, b); }
+static inline Vec4 Mul(Vec4 a, Vec4 b) { return vmulq_f32(a, b); }
+static inline Vec4 MulAdd(Vec4 a, Vec4 b, Vec4 c) { return vmlaq_f32(c, a, b); }
+static inline Mask4 Less(Vec4 a, Vec4 b) { return vcltq_f32(a, b); }
+static inline Mask4 Or(Mask4 a, Mask4 b) { return vorrq_u32(a, b); }
+static inline Vec4 Select(Mask4 m, Vec4 a, Vec4 b) { return vbslq_f32(m, a, b); }
+static inline uint32_t MoveMask(Mask4 m)
+{
+    static const uint32_t laneBits[4] = {1, 2, 4, 8};
+    const uint32x4_t bits = vandq_u32(m, vld1q_u32(laneBits));
+    const uint32x2_t sum = vadd_u32(vget_low_u32(bits), vget_high_u32(bits));
+    return vget_lane_u32(vpadd_u32(sum, sum), 0);
+}
+
+#else
+
+#define VEC4_BACKEND "scalar"
+
+struct Vec4
+{
+    float v[4];
+};
+struct Mask4
+{
+    bool b[4];
+};
+static inline Vec4 Load(const float* p) { return {{p[0], p[1], p[2], p[3]}}; }
+static inline void Store(float* p, Vec4 v) { p[0] = v.v[0]; p[1] = v.v[1]; p[2] = v.v[2]; p[3] = v.v[3]; }
+static inline Vec4 Splat(float f) { return {{f, f, f, f}}; }
+static inline Vec4 Add(Vec4 a, Vec4 b) { return {{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}}; }
+static inline Vec4 Mul(Vec4 a, Vec4 b) { return {{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]}}; }
+static inline Vec4 MulAdd(Vec4 a, Vec4 b, Vec4 c)
+{
+    return {{a.v[0] * b.v[0] + c.v[0], a.v[1] * b.v[1] + c.v[1], a.v[2] * b.v[2] + c.v[2], a.v[3] * b.v[3] + c.v[3]}};
+}
+static inline Mask4 Less(Vec4 a, Vec4 b) { return {{a.v[0] < b.v[0], a.v[1] < b.v[1], a.v[2] < b.v[2], a.v[3] < b.v[3]}}; }
+static inline Mask4 Or(Mask4 a, Mask4 b) { return {{a.b[0] || b.b[0], a.b[1] || b.b[1], a.b[2] || b.b[2], a.b[3] || b.b[3]}}; }
+static inline Vec4 Select(Mask4 m, Vec4 a, Vec4 b)
+{
+    return {{m.b[0] ? a.v[0] : b.v[0], m.b[1] ? a.v[1] : b.v[1], m.b[2] ? a.v[2] : b.v[2], m.b[3] ? a.v[3] : b.v[3]}};
+}
+static inline uint32_t MoveMask(Mask4 m) { return (m.b[0] ? 1u : 0u) | (m.b[1] ? 2u : 0u) | (m.b[2] ? 4u : 0u) | (m.b[3] ? 8u : 0u); }
+
+#endif
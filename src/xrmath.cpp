@@ -0,0 +1,239 @@
+// pose, projection and matrix math
+
+#include "xrmath.h"
+#include "vec4.h"
+
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define XRMATH_AVX
+static const char* s_backend = "avx";
+#else
+static const char* s_backend = VEC4_BACKEND;
+#endif
+
+const char* XrMathBackend()
+{
+    return s_backend;
+}
+
+// one column of a * b, from the columns of a and a column of b.
+static inline Vec4 MulColumn(const Vec4* a, const float* b)
+{
+    return MulAdd(a[3], Splat(b[3]), MulAdd(a[2], Splat(b[2]), MulAdd(a[1], Splat(b[1]), Mul(a[0], Splat(b[0])))));
+}
+
+void XrMathMultiplyMat(float* result, const float* a, const float* b)
+{
+    const Vec4 columns[4] = {Load(a), Load(a + 4), Load(a + 8), Load(a + 12)};
+    Store(result, MulColumn(columns, b));
+    Store(result + 4, MulColumn(columns, b + 4));
+    Store(result + 8, MulColumn(columns, b + 8));
+    Store(result + 12, MulColumn(columns, b + 12));
+}
+
+void XrMathMultiplyMatBatch(float* results, const float* a, const float* bs, uint32_t count)
+{
+    // the matrices are contiguous, so this is just count * 4 columns, each multiplied by a.
+    const uint32_t columnCount = count * 4;
+#if defined(XRMATH_AVX)
+    // a's columns in both halves, each half computes one column of the result.
+    const __m256 a0 = _mm256_broadcast_ps((const __m128*)a);
+    const __m256 a1 = _mm256_broadcast_ps((const __m128*)(a + 4));
+    const __m256 a2 = _mm256_broadcast_ps((const __m128*)(a + 8));
+    const __m256 a3 = _mm256_broadcast_ps((const __m128*)(a + 12));
+    for (uint32_t i = 0; i < columnCount; i += 2)
+    {
+        const __m256 b = _mm256_loadu_ps(bs + i * 4);
+        __m256 r = _mm256_mul_ps(a0, _mm256_shuffle_ps(b, b, _MM_SHUFFLE(0, 0, 0, 0)));
+        r = _mm256_add_ps(r, _mm256_mul_ps(a1, _mm256_shuffle_ps(b, b, _MM_SHUFFLE(1, 1, 1, 1))));
+        r = _mm256_add_ps(r, _mm256_mul_ps(a2, _mm256_shuffle_ps(b, b, _MM_SHUFFLE(2, 2, 2, 2))));
+        r = _mm256_add_ps(r, _mm256_mul_ps(a3, _mm256_shuffle_ps(b, b, _MM_SHUFFLE(3, 3, 3, 3))));
+        _mm256_storeu_ps(results + i * 4, r);
+    }
+#else
+    const Vec4 columns[4] = {Load(a), Load(a + 4), Load(a + 8), Load(a + 12)};
+    for (uint32_t i = 0; i < columnCount; i++)
+    {
+        Store(results + i * 4, MulColumn(columns, bs + i * 4));
+    }
+#endif
+}
+
+void XrMathInitPoseMat(float* result, const XrPosef& pose)
+{
+    const float x2 = pose.orientation.x + pose.orientation.x;
+    const float y2 = pose.orientation.y + pose.orientation.y;
+    const float z2 = pose.orientation.z + pose.orientation.z;
+
+    const float xx2 = pose.orientation.x * x2;
+    const float yy2 = pose.orientation.y * y2;
+    const float zz2 = pose.orientation.z * z2;
+
+    const float yz2 = pose.orientation.y * z2;
+    const float wx2 = pose.orientation.w * x2;
+    const float xy2 = pose.orientation.x * y2;
+    const float wz2 = pose.orientation.w * z2;
+    const float xz2 = pose.orientation.x * z2;
+    const float wy2 = pose.orientation.w * y2;
+
+    result[0] = 1.0f - yy2 - zz2;
+    result[1] = xy2 + wz2;
+    result[2] = xz2 - wy2;
+    result[3] = 0.0f;
+
+    result[4] = xy2 - wz2;
+    result[5] = 1.0f - xx2 - zz2;
+    result[6] = yz2 + wx2;
+    result[7] = 0.0f;
+
+    result[8] = xz2 + wy2;
+    result[9] = yz2 - wx2;
+    result[10] = 1.0f - xx2 - yy2;
+    result[11] = 0.0f;
+
+    result[12] = pose.position.x;
+    result[13] = pose.position.y;
+    result[14] = pose.position.z;
+    result[15] = 1.0f;
+}
+
+void XrMathInvertRigidMat(float* result, const float* src)
+{
+    result[0] = src[0];
+    result[1] = src[4];
+    result[2] = src[8];
+    result[3] = 0.0f;
+    result[4] = src[1];
+    result[5] = src[5];
+    result[6] = src[9];
+    result[7] = 0.0f;
+    result[8] = src[2];
+    result[9] = src[6];
+    result[10] = src[10];
+    result[11] = 0.0f;
+    result[12] = -(src[0] * src[12] + src[1] * src[13] + src[2] * src[14]);
+    result[13] = -(src[4] * src[12] + src[5] * src[13] + src[6] * src[14]);
+    result[14] = -(src[8] * src[12] + src[9] * src[13] + src[10] * src[14]);
+    result[15] = 1.0f;
+}
+
+void XrMathInitViewMat(float* result, const XrPosef& pose)
+{
+    const float x2 = pose.orientation.x + pose.orientation.x;
+    const float y2 = pose.orientation.y + pose.orientation.y;
+    const float z2 = pose.orientation.z + pose.orientation.z;
+
+    const float xx2 = pose.orientation.x * x2;
+    const float yy2 = pose.orientation.y * y2;
+    const float zz2 = pose.orientation.z * z2;
+
+    const float yz2 = pose.orientation.y * z2;
+    const float wx2 = pose.orientation.w * x2;
+    const float xy2 = pose.orientation.x * y2;
+    const float wz2 = pose.orientation.w * z2;
+    const float xz2 = pose.orientation.x * z2;
+    const float wy2 = pose.orientation.w * y2;
+
+    // the transpose of the pose's rotation.
+    result[0] = 1.0f - yy2 - zz2;
+    result[1] = xy2 - wz2;
+    result[2] = xz2 + wy2;
+    result[3] = 0.0f;
+
+    result[4] = xy2 + wz2;
+    result[5] = 1.0f - xx2 - zz2;
+    result[6] = yz2 - wx2;
+    result[7] = 0.0f;
+
+    result[8] = xz2 - wy2;
+    result[9] = yz2 + wx2;
+    result[10] = 1.0f - xx2 - yy2;
+    result[11] = 0.0f;
+
+    // and the position rotated back by it.
+    const XrVector3f& p = pose.position;
+    result[12] = -(result[0] * p.x + result[4] * p.y + result[8] * p.z);
+    result[13] = -(result[1] * p.x + result[5] * p.y + result[9] * p.z);
+    result[14] = -(result[2] * p.x + result[6] * p.y + result[10] * p.z);
+    result[15] = 1.0f;
+}
+
+void XrMathInitProjectionMat(float* result, GraphicsAPI graphicsApi, const float tanAngleLeft,
+                             const float tanAngleRight, const float tanAngleUp, float const tanAngleDown,
+                             const float nearZ, const float farZ)
+{
+    const float tanAngleWidth = tanAngleRight - tanAngleLeft;
+
+    // Set to tanAngleDown - tanAngleUp for a clip space with positive Y down (Vulkan).
+    // Set to tanAngleUp - tanAngleDown for a clip space with positive Y up (OpenGL / D3D / Metal).
+    const float tanAngleHeight = graphicsApi == GRAPHICS_VULKAN ? (tanAngleDown - tanAngleUp) : (tanAngleUp - tanAngleDown);
+
+    // Set to nearZ for a [-1,1] Z clip space (OpenGL / OpenGL ES).
+    // Set to zero for a [0,1] Z clip space (Vulkan / D3D / Metal).
+    const float offsetZ = (graphicsApi == GRAPHICS_OPENGL || graphicsApi == GRAPHICS_OPENGL_ES) ? nearZ : 0;
+
+    if (farZ <= nearZ)
+    {
+        // place the far plane at infinity
+        result[0] = 2 / tanAngleWidth;
+        result[4] = 0;
+        result[8] = (tanAngleRight + tanAngleLeft) / tanAngleWidth;
+        result[12] = 0;
+
+        result[1] = 0;
+        result[5] = 2 / tanAngleHeight;
+        result[9] = (tanAngleUp + tanAngleDown) / tanAngleHeight;
+        result[13] = 0;
+
+        result[2] = 0;
+        result[6] = 0;
+        result[10] = -1;
+        result[14] = -(nearZ + offsetZ);
+
+        result[3] = 0;
+        result[7] = 0;
+        result[11] = -1;
+        result[15] = 0;
+    }
+    else
+    {
+        // normal projection
+        result[0] = 2 / tanAngleWidth;
+        result[4] = 0;
+        result[8] = (tanAngleRight + tanAngleLeft) / tanAngleWidth;
+        result[12] = 0;
+
+        result[1] = 0;
+        result[5] = 2 / tanAngleHeight;
+        result[9] = (tanAngleUp + tanAngleDown) / tanAngleHeight;
+        result[13] = 0;
+
+        result[2] = 0;
+        result[6] = 0;
+        result[10] = -(farZ + offsetZ) / (farZ - nearZ);
+        result[14] = -(farZ * (nearZ + offsetZ)) / (farZ - nearZ);
+
+        result[3] = 0;
+        result[7] = 0;
+        result[11] = -1;
+        result[15] = 0;
+    }
+}
+
+const float* XrMathGetProjectionMat(XrMathProjectionCache& cache, const XrFovf& fov, float nearZ, float farZ)
+{
+    if (!cache.valid || cache.fov.angleLeft != fov.angleLeft || cache.fov.angleRight != fov.angleRight ||
+        cache.fov.angleUp != fov.angleUp || cache.fov.angleDown != fov.angleDown ||
+        cache.nearZ != nearZ || cache.farZ != farZ)
+    {
+        XrMathInitProjectionMat(cache.mat, GRAPHICS_OPENGL, tanf(fov.angleLeft), tanf(fov.angleRight),
+                                tanf(fov.angleUp), tanf(fov.angleDown), nearZ, farZ);
+        cache.fov = fov;
+        cache.nearZ = nearZ;
+        cache.farZ = farZ;
+        cache.valid = true;
+    }
+    return cache.mat;
+}
@@ -0,0 +1,51 @@
+// pose, projection and matrix math
+//
+// 4x4 matrices are 16 floats, column major, as OpenGL expects them.  Products are computed a column at a time
+// with 4-wide vectors, SSE on x86, NEON on ARM, or plain floats elsewhere, picked at compile time.  When built
+// with AVX, the batched product handles two columns per instruction.
+//
+// Projections only depend on the view's XrFovf, which almost never changes, so they are built through a
+// cache that recomputes the tangents and the matrix only when the fov or clip planes differ from last time.
+
+#pragma once
+
+#include <openxr/openxr.h>
+
+#include <cstdint>
+
+enum GraphicsAPI { GRAPHICS_VULKAN, GRAPHICS_OPENGL, GRAPHICS_OPENGL_ES, GRAPHICS_D3D };
+
+// the vector instruction set the kernels were compiled for, e.g. "sse", "avx", "neon" or "scalar".
+const char* XrMathBackend();
+
+// result = a * b, result may not alias a or b.
+void XrMathMultiplyMat(float* result, const float* a, const float* b);
+
+// results[i] = a * bs[i] for count matrices, e.g. every model matrix by one view projection.
+void XrMathMultiplyMatBatch(float* results, const float* a, const float* bs, uint32_t count);
+
+// the matrix that takes pose space into its parent space.
+void XrMathInitPoseMat(float* result, const XrPosef& pose);
+
+// inverse of a matrix made of a rotation and a translation, such as one from XrMathInitPoseMat.
+void XrMathInvertRigidMat(float* result, const float* src);
+
+// the view matrix of a pose, the same as inverting XrMathInitPoseMat's matrix, without building it first.
+void XrMathInitViewMat(float* result, const XrPosef& pose);
+
+// projection from the tangents of the fov's angles, farZ <= nearZ puts the far plane at infinity.
+void XrMathInitProjectionMat(float* result, GraphicsAPI graphicsApi, const float tanAngleLeft,
+                             const float tanAngleRight, const float tanAngleUp, float const tanAngleDown,
+                             const float nearZ, const float farZ);
+
+struct XrMathProjectionCache
+{
+    XrFovf fov;
+    float nearZ;
+    float farZ;
+    bool valid = false;
+    float mat[16];
+};
+
+// the OpenGL projection matrix for fov, rebuilt only if fov, nearZ or farZ changed since the last call.
+const float* XrMathGetProjectionMat(XrMathProjectionCache& cache, const XrFovf& fov, float nearZ, float farZ);
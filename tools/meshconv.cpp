@@ -0,0 +1,990 @@
+// mesh converter
+//
+// usage: openxrstub_meshconv INPUT OUTPUT
+//        openxrstub_meshconv --generate VERTICES OUTPUT
+//
+// Converts an OBJ or glTF 2.0 (.gltf or .glb) file into the binary scene format of src/scene.h, for openxrstub
+// --scene.  Only positions and primitives are kept:
+//
+//     OBJ    v, f and l records, faces are triangulated as fans, each o or g starts a new mesh
+//     glTF   POSITION as float VEC3, u8/u16/u32 or no indices, lines and triangles, node transforms applied,
+//            buffers from .bin files, data uris or the .glb BIN chunk, colors from baseColorFactor
+//
+// --generate writes a synthetic terrain of at least VERTICES vertices, in tiles of up to 64k vertices, for load
+// benchmarks.  Indices are stored relative to each mesh's baseVertex, so 16-bit indices are used whenever every
+// mesh has fewer than 64k vertices, however big the whole file is.
+
+#include "scene.h"
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static const float DEFAULT_COLOR[4] = {0.0f, 1.0f, 0.0f, 1.0f};
+
+struct Mesh
+{
+    ScenePrimitive primitive = SCENE_TRIANGLES;
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;      // relative to this mesh's positions
+    float color[4] = {DEFAULT_COLOR[0], DEFAULT_COLOR[1], DEFAULT_COLOR[2], DEFAULT_COLOR[3]};
+};
+
+static bool ReadFile(const std::string& path, std::vector<uint8_t>& data)
+{
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp)
+    {
+        printf("Failed to open \"%s\"\n", path.c_str());
+        return false;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    data.resize(size > 0 ? (size_t)size : 0);
+    bool ok = size >= 0 && fread(data.data(), 1, data.size(), fp) == data.size();
+    fclose(fp);
+    if (!ok)
+    {
+        printf("Failed to read \"%s\"\n", path.c_str());
+    }
+    return ok;
+}
+
+static std::string Extension(const std::string& path)
+{
+    size_t dot = path.find_last_of('.');
+    std::string ext = dot == std::string::npos ? "" : path.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return (char)tolower((unsigned char)c); });
+    return ext;
+}
+
+static std::string Directory(const std::string& path)
+{
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+}
+
+//
+// OBJ
+//
+
+// builds one mesh of an OBJ object, copying only the vertices it references.
+struct ObjMeshBuilder
+{
+    Mesh mesh;
+    std::unordered_map<uint32_t, uint32_t> remap;
+
+    uint32_t AddVertex(const std::vector<float>& positions, uint32_t index)
+    {
+        auto it = remap.find(index);
+        if (it != remap.end())
+        {
+            return it->second;
+        }
+        uint32_t local = (uint32_t)(mesh.positions.size() / 3);
+        mesh.positions.insert(mesh.positions.end(), positions.begin() + index * 3, positions.begin() + index * 3 + 3);
+        remap[index] = local;
+        return local;
+    }
+};
+
+static void FlushObjObject(ObjMeshBuilder& lines, ObjMeshBuilder& triangles, std::vector<Mesh>& meshes)
+{
+    for (ObjMeshBuilder* builder : {&lines, &triangles})
+    {
+        if (!builder->mesh.indices.empty())
+        {
+            meshes.push_back(builder->mesh);
+        }
+        ScenePrimitive primitive = builder->mesh.primitive;
+        *builder = ObjMeshBuilder();
+        builder->mesh.primitive = primitive;
+    }
+}
+
+// the next space separated token of a line, or NULL at its end.
+static const char* NextToken(char*& p)
+{
+    p += strspn(p, " \t");
+    if (!*p)
+    {
+        return NULL;
+    }
+    const char* token = p;
+    p += strcspn(p, " \t");
+    if (*p)
+    {
+        *p++ = '\0';
+    }
+    return token;
+}
+
+// parses the vertex index of an f or l element such as "3", "3/1" or "-1//2", into a 0 based index.
+static bool ParseObjIndex(const char* token, uint32_t vertexCount, uint32_t& index)
+{
+    long i = strtol(token, NULL, 10);
+    if (i < 0)
+    {
+        i += (long)vertexCount;
+    }
+    else
+    {
+        i -= 1;
+    }
+    if (i < 0 || i >= (long)vertexCount)
+    {
+        return false;
+    }
+    index = (uint32_t)i;
+    return true;
+}
+
+static bool LoadObj(const std::string& path, std::vector<Mesh>& meshes)
+{
+    std::vector<uint8_t> data;
+    if (!ReadFile(path, data))
+    {
+        return false;
+    }
+    data.push_back('\0');
+
+    std::vector<float> positions;
+    ObjMeshBuilder lines;
+    lines.mesh.primitive = SCENE_LINES;
+    ObjMeshBuilder triangles;
+    triangles.mesh.primitive = SCENE_TRIANGLES;
+
+    char* line = (char*)data.data();
+    uint32_t lineNumber = 0;
+    while (*line)
+    {
+        char* next = line + strcspn(line, "\r\n");
+        if (*next)
+        {
+            *next++ = '\0';
+        }
+        next += strspn(next, "\r\n");
+        lineNumber++;
+
+        const char* keyword = NextToken(line);
+        if (!keyword)
+        {
+            line = next;
+            continue;
+        }
+        if (!strcmp(keyword, "v"))
+        {
+            float p[3] = {};
+            for (int i = 0; i < 3; i++)
+            {
+                const char* token = NextToken(line);
+                p[i] = token ? strtof(token, NULL) : 0.0f;
+            }
+            positions.insert(positions.end(), p, p + 3);
+        }
+        else if (!strcmp(keyword, "f") || !strcmp(keyword, "l"))
+        {
+            const bool face = keyword[0] == 'f';
+            ObjMeshBuilder& builder = face ? triangles : lines;
+            const uint32_t vertexCount = (uint32_t)(positions.size() / 3);
+            std::vector<uint32_t> element;
+            for (const char* token = NextToken(line); token; token = NextToken(line))
+            {
+                uint32_t index;
+                if (!ParseObjIndex(token, vertexCount, index))
+                {
+                    printf("%s:%u: bad vertex index \"%s\"\n", path.c_str(), lineNumber, token);
+                    return false;
+                }
+                element.push_back(builder.AddVertex(positions, index));
+            }
+            // faces as triangle fans, polylines as segments.
+            for (size_t i = 1; i + (face ? 1 : 0) < element.size(); i++)
+            {
+                if (face)
+                {
+                    builder.mesh.indices.insert(builder.mesh.indices.end(), {element[0], element[i], element[i + 1]});
+                }
+                else
+                {
+                    builder.mesh.indices.insert(builder.mesh.indices.end(), {element[i - 1], element[i]});
+                }
+            }
+        }
+        else if (!strcmp(keyword, "o") || !strcmp(keyword, "g"))
+        {
+            FlushObjObject(lines, triangles, meshes);
+        }
+        line = next;
+    }
+    FlushObjObject(lines, triangles, meshes);
+    return true;
+}
+
+//
+// JSON, just enough for glTF
+//
+
+struct JsonValue
+{
+    enum Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+    Type type = NUL;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    const JsonValue* Get(const char* key) const
+    {
+        for (const auto& member : members)
+        {
+            if (member.first == key)
+            {
+                return &member.second;
+            }
+        }
+        return NULL;
+    }
+
+    // the member as a number, or def if it is missing.
+    double Number(const char* key, double def) const
+    {
+        const JsonValue* value = Get(key);
+        return value && value->type == NUMBER ? value->number : def;
+    }
+
+    const JsonValue* Item(const char* key, double index) const
+    {
+        const JsonValue* array = Get(key);
+        if (!array || array->type != ARRAY || index < 0 || index >= (double)array->items.size())
+        {
+            return NULL;
+        }
+        return &array->items[(size_t)index];
+    }
+};
+
+struct JsonParser
+{
+    const char* p;
+    const char* end;
+
+    void SkipSpace()
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+        {
+            p++;
+        }
+    }
+
+    bool ParseString(std::string& str)
+    {
+        p++;
+        while (p < end && *p != '"')
+        {
+            if (*p == '\\' && p + 1 < end)
+            {
+                p++;
+                switch (*p)
+                {
+                case 'n': str += '\n'; break;
+                case 't': str += '\t'; break;
+                case 'r': str += '\r'; break;
+                case 'b': str += '\b'; break;
+                case 'f': str += '\f'; break;
+                case 'u':
+                    // names and uris are ascii in practice, keep the code unit's low byte.
+                    if (end - p < 5)
+                    {
+                        return false;
+                    }
+                    str += (char)strtol(std::string(p + 1, 4).c_str(), NULL, 16);
+                    p += 4;
+                    break;
+                default: str += *p; break;
+                }
+            }
+            else
+            {
+                str += *p;
+            }
+            p++;
+        }
+        if (p == end)
+        {
+            return false;
+        }
+        p++;
+        return true;
+    }
+
+    bool Parse(JsonValue& value, int depth = 0)
+    {
+        SkipSpace();
+        if (p == end || depth > 64)
+        {
+            return false;
+        }
+        if (*p == '{')
+        {
+            value.type = JsonValue::OBJECT;
+            p++;
+            SkipSpace();
+            if (p < end && *p == '}')
+            {
+                p++;
+                return true;
+            }
+            while (true)
+            {
+                SkipSpace();
+                std::pair<std::string, JsonValue> member;
+                if (p == end || *p != '"' || !ParseString(member.first))
+                {
+                    return false;
+                }
+                SkipSpace();
+                if (p == end || *p++ != ':' || !Parse(member.second, depth + 1))
+                {
+                    return false;
+                }
+                value.members.push_back(std::move(member));
+                SkipSpace();
+                if (p < end && *p == ',')
+                {
+                    p++;
+                    continue;
+                }
+                return p < end && *p++ == '}';
+            }
+        }
+        if (*p == '[')
+        {
+            value.type = JsonValue::ARRAY;
+            p++;
+            SkipSpace();
+            if (p < end && *p == ']')
+            {
+                p++;
+                return true;
+            }
+            while (true)
+            {
+                value.items.emplace_back();
+                if (!Parse(value.items.back(), depth + 1))
+                {
+                    return false;
+                }
+                SkipSpace();
+                if (p < end && *p == ',')
+                {
+                    p++;
+                    continue;
+                }
+                return p < end && *p++ == ']';
+            }
+        }
+        if (*p == '"')
+        {
+            value.type = JsonValue::STRING;
+            return ParseString(value.string);
+        }
+        if (end - p >= 4 && !strncmp(p, "true", 4))
+        {
+            value.type = JsonValue::BOOLEAN;
+            value.number = 1.0;
+            p += 4;
+            return true;
+        }
+        if (end - p >= 5 && !strncmp(p, "false", 5))
+        {
+            value.type = JsonValue::BOOLEAN;
+            p += 5;
+            return true;
+        }
+        if (end - p >= 4 && !strncmp(p, "null", 4))
+        {
+            p += 4;
+            return true;
+        }
+        // the text is followed by a '\0' or more json, so strtod can't run off the end.
+        char* numberEnd = NULL;
+        value.type = JsonValue::NUMBER;
+        value.number = strtod(p, &numberEnd);
+        if (numberEnd == p)
+        {
+            return false;
+        }
+        p = numberEnd;
+        return true;
+    }
+};
+
+//
+// glTF 2.0
+//
+
+static bool DecodeBase64(const char* str, std::vector<uint8_t>& data)
+{
+    uint32_t bits = 0;
+    int bitCount = 0;
+    for (; *str && *str != '='; str++)
+    {
+        const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        const char* c = strchr(alphabet, *str);
+        if (!c)
+        {
+            return false;
+        }
+        bits = (bits << 6) | (uint32_t)(c - alphabet);
+        bitCount += 6;
+        if (bitCount >= 8)
+        {
+            bitCount -= 8;
+            data.push_back((uint8_t)(bits >> bitCount));
+        }
+    }
+    return true;
+}
+
+struct Gltf
+{
+    JsonValue json;
+    std::vector<std::vector<uint8_t>> buffers;
+};
+
+static bool LoadGltfBuffers(Gltf& gltf, const std::string& path, const std::vector<uint8_t>* glbBin)
+{
+    const JsonValue* buffers = gltf.json.Get("buffers");
+    size_t bufferCount = buffers && buffers->type == JsonValue::ARRAY ? buffers->items.size() : 0;
+    gltf.buffers.resize(bufferCount);
+    for (size_t i = 0; i < bufferCount; i++)
+    {
+        const JsonValue* uri = buffers->items[i].Get("uri");
+        if (!uri)
+        {
+            // only the first buffer of a .glb may leave out its uri, it is the BIN chunk.
+            if (i != 0 || !glbBin)
+            {
+                printf("%s: buffer %zu has no uri\n", path.c_str(), i);
+                return false;
+            }
+            gltf.buffers[i] = *glbBin;
+        }
+        else if (!uri->string.compare(0, 5, "data:"))
+        {
+            size_t comma = uri->string.find(";base64,");
+            if (comma == std::string::npos || !DecodeBase64(uri->string.c_str() + comma + 8, gltf.buffers[i]))
+            {
+                printf("%s: buffer %zu has an unsupported data uri\n", path.c_str(), i);
+                return false;
+            }
+        }
+        else if (!ReadFile(Directory(path) + uri->string, gltf.buffers[i]))
+        {
+            return false;
+        }
+        if (gltf.buffers[i].size() < (size_t)buffers->items[i].Number("byteLength", 0))
+        {
+            printf("%s: buffer %zu is shorter than its byteLength\n", path.c_str(), i);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool LoadGltfFile(const std::string& path, Gltf& gltf)
+{
+    std::vector<uint8_t> data;
+    if (!ReadFile(path, data))
+    {
+        return false;
+    }
+
+    const uint8_t* jsonBegin = data.data();
+    const uint8_t* jsonEnd = data.data() + data.size();
+    std::vector<uint8_t> glbBin;
+    bool glb = data.size() >= 12 && !memcmp(data.data(), "glTF", 4);
+    if (glb)
+    {
+        // 12 byte header, then chunks of length, type and data, JSON first.
+        size_t offset = 12;
+        jsonBegin = jsonEnd = NULL;
+        while (offset + 8 <= data.size())
+        {
+            uint32_t chunkLength;
+            uint32_t chunkType;
+            memcpy(&chunkLength, &data[offset], 4);
+            memcpy(&chunkType, &data[offset + 4], 4);
+            offset += 8;
+            if (chunkLength > data.size() - offset)
+            {
+                break;
+            }
+            if (chunkType == 0x4E4F534A && !jsonBegin)
+            {
+                jsonBegin = &data[offset];
+                jsonEnd = jsonBegin + chunkLength;
+            }
+            else if (chunkType == 0x004E4942 && glbBin.empty())
+            {
+                glbBin.assign(data.begin() + offset, data.begin() + offset + chunkLength);
+            }
+            offset += chunkLength;
+        }
+        if (!jsonBegin)
+        {
+            printf("%s: no JSON chunk\n", path.c_str());
+            return false;
+        }
+    }
+
+    std::string text((const char*)jsonBegin, (const char*)jsonEnd);
+    JsonParser parser = {text.c_str(), text.c_str() + text.size()};
+    if (!parser.Parse(gltf.json) || gltf.json.type != JsonValue::OBJECT)
+    {
+        printf("%s: bad JSON\n", path.c_str());
+        return false;
+    }
+
+    return LoadGltfBuffers(gltf, path, glb ? &glbBin : NULL);
+}
+
+// the bytes of an accessor's elements, with the stride between them.
+static bool GetAccessorData(const Gltf& gltf, const JsonValue& accessor, uint32_t componentSize,
+                            uint32_t componentCount, const uint8_t*& data, size_t& stride, size_t& count)
+{
+    const JsonValue* view = gltf.json.Item("bufferViews", accessor.Number("bufferView", -1));
+    if (!view)
+    {
+        return false;
+    }
+    const double bufferIndex = view->Number("buffer", -1);
+    if (bufferIndex < 0 || bufferIndex >= (double)gltf.buffers.size())
+    {
+        return false;
+    }
+    const std::vector<uint8_t>& buffer = gltf.buffers[(size_t)bufferIndex];
+    const size_t elementSize = componentSize * componentCount;
+    const size_t offset = (size_t)view->Number("byteOffset", 0) + (size_t)accessor.Number("byteOffset", 0);
+    const size_t viewEnd = (size_t)view->Number("byteOffset", 0) + (size_t)view->Number("byteLength", 0);
+    stride = (size_t)view->Number("byteStride", 0);
+    stride = stride ? stride : elementSize;
+    count = (size_t)accessor.Number("count", 0);
+    if (viewEnd > buffer.size() || (count > 0 && offset + (count - 1) * stride + elementSize > viewEnd))
+    {
+        return false;
+    }
+    data = buffer.data() + offset;
+    return true;
+}
+
+// column major 4x4, the same layout as glTF's node matrices.
+static void MultiplyMat(float* result, const float* a, const float* b)
+{
+    for (int c = 0; c < 4; c++)
+    {
+        for (int r = 0; r < 4; r++)
+        {
+            result[c * 4 + r] = a[r] * b[c * 4] + a[4 + r] * b[c * 4 + 1] + a[8 + r] * b[c * 4 + 2] + a[12 + r] * b[c * 4 + 3];
+        }
+    }
+}
+
+// copies count numbers of an array member into values, leaving them as they are if it is missing.
+static void GetNumbers(const JsonValue& value, const char* key, float* values, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        const JsonValue* item = value.Item(key, i);
+        values[i] = item ? (float)item->number : values[i];
+    }
+}
+
+static void GetNodeMat(const JsonValue& node, float* result)
+{
+    const JsonValue* matrix = node.Get("matrix");
+    if (matrix && matrix->type == JsonValue::ARRAY && matrix->items.size() == 16)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            result[i] = (float)matrix->items[i].number;
+        }
+        return;
+    }
+
+    float t[3] = {0.0f, 0.0f, 0.0f};
+    float q[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+    float s[3] = {1.0f, 1.0f, 1.0f};
+    GetNumbers(node, "translation", t, 3);
+    GetNumbers(node, "rotation", q, 4);
+    GetNumbers(node, "scale", s, 3);
+
+    // T * R * S
+    const float x = q[0], y = q[1], z = q[2], w = q[3];
+    const float rotation[9] = {
+        1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + z * w), 2.0f * (x * z - y * w),
+        2.0f * (x * y - z * w), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + x * w),
+        2.0f * (x * z + y * w), 2.0f * (y * z - x * w), 1.0f - 2.0f * (x * x + y * y)
+    };
+    for (int c = 0; c < 3; c++)
+    {
+        for (int r = 0; r < 3; r++)
+        {
+            result[c * 4 + r] = rotation[c * 3 + r] * s[c];
+        }
+        result[c * 4 + 3] = 0.0f;
+    }
+    result[12] = t[0];
+    result[13] = t[1];
+    result[14] = t[2];
+    result[15] = 1.0f;
+}
+
+static bool AddGltfPrimitive(const Gltf& gltf, const std::string& path, const JsonValue& primitive,
+                             const float* mat, std::vector<Mesh>& meshes)
+{
+    Mesh mesh;
+    const double mode = primitive.Number("mode", 4);
+    if (mode != 1 && mode != 4)
+    {
+        printf("%s: skipping a primitive with unsupported mode %g\n", path.c_str(), mode);
+        return true;
+    }
+    mesh.primitive = mode == 1 ? SCENE_LINES : SCENE_TRIANGLES;
+
+    const JsonValue* attributes = primitive.Get("attributes");
+    const JsonValue* accessor = attributes ? gltf.json.Item("accessors", attributes->Number("POSITION", -1)) : NULL;
+    const JsonValue* type = accessor ? accessor->Get("type") : NULL;
+    const uint8_t* data;
+    size_t stride;
+    size_t count;
+    if (!accessor || accessor->Number("componentType", 0) != 5126 || !type || type->string != "VEC3" ||
+        !GetAccessorData(gltf, *accessor, 4, 3, data, stride, count))
+    {
+        printf("%s: primitive has no usable float VEC3 POSITION\n", path.c_str());
+        return false;
+    }
+    mesh.positions.resize(count * 3);
+    for (size_t i = 0; i < count; i++)
+    {
+        float p[3];
+        memcpy(p, data + i * stride, sizeof(p));
+        for (int r = 0; r < 3; r++)
+        {
+            mesh.positions[i * 3 + r] = mat[r] * p[0] + mat[4 + r] * p[1] + mat[8 + r] * p[2] + mat[12 + r];
+        }
+    }
+
+    const JsonValue* indices = gltf.json.Item("accessors", primitive.Number("indices", -1));
+    if (indices)
+    {
+        const double componentType = indices->Number("componentType", 0);
+        const uint32_t componentSize = componentType == 5121 ? 1 : componentType == 5123 ? 2 : componentType == 5125 ? 4 : 0;
+        size_t indexCount;
+        if (!componentSize || !GetAccessorData(gltf, *indices, componentSize, 1, data, stride, indexCount))
+        {
+            printf("%s: primitive has unusable indices\n", path.c_str());
+            return false;
+        }
+        mesh.indices.resize(indexCount);
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            uint32_t index = 0;
+            memcpy(&index, data + i * stride, componentSize);
+            if (index >= count)
+            {
+                printf("%s: index out of range\n", path.c_str());
+                return false;
+            }
+            mesh.indices[i] = index;
+        }
+    }
+    else
+    {
+        mesh.indices.resize(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            mesh.indices[i] = (uint32_t)i;
+        }
+    }
+
+    const JsonValue* material = gltf.json.Item("materials", primitive.Number("material", -1));
+    const JsonValue* pbr = material ? material->Get("pbrMetallicRoughness") : NULL;
+    if (pbr)
+    {
+        // glTF's default base color is white.
+        std::fill(mesh.color, mesh.color + 4, 1.0f);
+        GetNumbers(*pbr, "baseColorFactor", mesh.color, 4);
+    }
+
+    meshes.push_back(std::move(mesh));
+    return true;
+}
+
+static bool AddGltfNode(const Gltf& gltf, const std::string& path, double nodeIndex, const float* parentMat,
+                        std::vector<Mesh>& meshes, int depth)
+{
+    const JsonValue* node = gltf.json.Item("nodes", nodeIndex);
+    if (!node || depth > 64)
+    {
+        printf("%s: bad node %g\n", path.c_str(), nodeIndex);
+        return false;
+    }
+    float nodeMat[16];
+    GetNodeMat(*node, nodeMat);
+    float mat[16];
+    MultiplyMat(mat, parentMat, nodeMat);
+
+    const JsonValue* mesh = gltf.json.Item("meshes", node->Number("mesh", -1));
+    const JsonValue* primitives = mesh ? mesh->Get("primitives") : NULL;
+    for (size_t i = 0; primitives && i < primitives->items.size(); i++)
+    {
+        if (!AddGltfPrimitive(gltf, path, primitives->items[i], mat, meshes))
+        {
+            return false;
+        }
+    }
+
+    const JsonValue* children = node->Get("children");
+    for (size_t i = 0; children && i < children->items.size(); i++)
+    {
+        if (!AddGltfNode(gltf, path, children->items[i].number, mat, meshes, depth + 1))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool LoadGltf(const std::string& path, std::vector<Mesh>& meshes)
+{
+    Gltf gltf;
+    if (!LoadGltfFile(path, gltf))
+    {
+        return false;
+    }
+
+    const float identity[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+    const JsonValue* scene = gltf.json.Item("scenes", gltf.json.Number("scene", 0));
+    const JsonValue* roots = scene ? scene->Get("nodes") : NULL;
+    if (roots)
+    {
+        for (const JsonValue& root : roots->items)
+        {
+            if (!AddGltfNode(gltf, path, root.number, identity, meshes, 0))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // no scene, just the meshes as they are.
+    const JsonValue* gltfMeshes = gltf.json.Get("meshes");
+    for (size_t i = 0; gltfMeshes && i < gltfMeshes->items.size(); i++)
+    {
+        const JsonValue* primitives = gltfMeshes->items[i].Get("primitives");
+        for (size_t j = 0; primitives && j < primitives->items.size(); j++)
+        {
+            if (!AddGltfPrimitive(gltf, path, primitives->items[j], identity, meshes))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+//
+// synthetic terrain
+//
+
+// a wavy floor of square triangulated tiles, each with up to 256x256 vertices so its indices fit in 16 bits.
+static void GenerateTerrain(uint64_t minVertexCount, std::vector<Mesh>& meshes)
+{
+    const uint32_t TILE_VERTICES = 256;
+    const float TILE_SIZE = 4.0f;
+    const uint64_t tileVertexCount = TILE_VERTICES * TILE_VERTICES;
+    const uint32_t tileCount = (uint32_t)((minVertexCount + tileVertexCount - 1) / tileVertexCount);
+    const uint32_t tilesPerRow = (uint32_t)ceil(sqrt((double)tileCount));
+
+    for (uint32_t tile = 0; tile < tileCount; tile++)
+    {
+        Mesh mesh;
+        mesh.primitive = SCENE_TRIANGLES;
+        const float tileX = ((float)(tile % tilesPerRow) - tilesPerRow * 0.5f) * TILE_SIZE;
+        const float tileZ = ((float)(tile / tilesPerRow) - tilesPerRow * 0.5f) * TILE_SIZE;
+        mesh.positions.reserve(tileVertexCount * 3);
+        for (uint32_t z = 0; z < TILE_VERTICES; z++)
+        {
+            for (uint32_t x = 0; x < TILE_VERTICES; x++)
+            {
+                // tiles share their edge vertices' positions, so the terrain has no gaps.
+                const float px = tileX + TILE_SIZE * x / (TILE_VERTICES - 1);
+                const float pz = tileZ + TILE_SIZE * z / (TILE_VERTICES - 1);
+                const float py = 0.1f * sinf(px * 1.7f) * cosf(pz * 1.3f);
+                mesh.positions.insert(mesh.positions.end(), {px, py, pz});
+            }
+        }
+        mesh.indices.reserve((TILE_VERTICES - 1) * (TILE_VERTICES - 1) * 6);
+        for (uint32_t z = 0; z + 1 < TILE_VERTICES; z++)
+        {
+            for (uint32_t x = 0; x + 1 < TILE_VERTICES; x++)
+            {
+                const uint32_t i = z * TILE_VERTICES + x;
+                mesh.indices.insert(mesh.indices.end(), {i, i + TILE_VERTICES, i + 1, i + 1, i + TILE_VERTICES, i + TILE_VERTICES + 1});
+            }
+        }
+        const float shade = 0.5f + 0.5f * (float)((tile % tilesPerRow + tile / tilesPerRow) % 2);
+        mesh.color[0] = 0.0f;
+        mesh.color[1] = shade;
+        mesh.color[2] = 0.0f;
+        meshes.push_back(std::move(mesh));
+    }
+}
+
+//
+// writer
+//
+
+static uint64_t Align(uint64_t offset)
+{
+    return (offset + SCENE_FILE_ALIGNMENT - 1) & ~(uint64_t)(SCENE_FILE_ALIGNMENT - 1);
+}
+
+static bool WriteBlock(FILE* fp, uint64_t offset, const void* data, size_t size)
+{
+    // pad up to the block's offset.
+    static const uint8_t zeros[SCENE_FILE_ALIGNMENT] = {};
+    const long pos = ftell(fp);
+    return pos >= 0 && fwrite(zeros, 1, (size_t)(offset - (uint64_t)pos), fp) == offset - (uint64_t)pos &&
+           fwrite(data, 1, size, fp) == size;
+}
+
+static bool WriteScene(const std::string& path, const std::vector<Mesh>& meshes)
+{
+    SceneFileHeader header = {};
+    memcpy(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic));
+    header.version = SCENE_FILE_VERSION;
+    header.meshCount = (uint32_t)meshes.size();
+    header.indexSize = 2;
+
+    std::vector<SceneFileMesh> fileMeshes(meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        const Mesh& mesh = meshes[i];
+        SceneFileMesh& fileMesh = fileMeshes[i];
+        const uint64_t vertexCount = mesh.positions.size() / 3;
+        if (header.vertexCount + vertexCount > UINT32_MAX || header.indexCount + mesh.indices.size() > UINT32_MAX)
+        {
+            printf("Too many vertices or indices for one scene file\n");
+            return false;
+        }
+        fileMesh.primitive = mesh.primitive;
+        fileMesh.baseVertex = (uint32_t)header.vertexCount;
+        fileMesh.vertexCount = (uint32_t)vertexCount;
+        fileMesh.firstIndex = (uint32_t)header.indexCount;
+        fileMesh.indexCount = (uint32_t)mesh.indices.size();
+        memcpy(fileMesh.color, mesh.color, sizeof(fileMesh.color));
+        SceneComputeBounds(mesh.positions.data(), fileMesh.vertexCount, fileMesh.boundsMin, fileMesh.boundsMax);
+        header.vertexCount += vertexCount;
+        header.indexCount += mesh.indices.size();
+        header.indexSize = vertexCount > 0x10000 ? 4 : header.indexSize;
+    }
+
+    header.meshOffset = Align(sizeof(header));
+    header.vertexOffset = Align(header.meshOffset + fileMeshes.size() * sizeof(SceneFileMesh));
+    header.indexOffset = Align(header.vertexOffset + header.vertexCount * 3 * sizeof(float));
+
+    FILE* fp = fopen(path.c_str(), "wb");
+    if (!fp)
+    {
+        printf("Failed to open \"%s\" for writing\n", path.c_str());
+        return false;
+    }
+    bool ok = WriteBlock(fp, 0, &header, sizeof(header)) &&
+              WriteBlock(fp, header.meshOffset, fileMeshes.data(), fileMeshes.size() * sizeof(SceneFileMesh));
+    uint64_t offset = header.vertexOffset;
+    for (size_t i = 0; ok && i < meshes.size(); i++)
+    {
+        ok = WriteBlock(fp, offset, meshes[i].positions.data(), meshes[i].positions.size() * sizeof(float));
+        offset += meshes[i].positions.size() * sizeof(float);
+    }
+    offset = header.indexOffset;
+    for (size_t i = 0; ok && i < meshes.size(); i++)
+    {
+        const std::vector<uint32_t>& indices = meshes[i].indices;
+        if (header.indexSize == 2)
+        {
+            std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+            ok = WriteBlock(fp, offset, shortIndices.data(), shortIndices.size() * sizeof(uint16_t));
+        }
+        else
+        {
+            ok = WriteBlock(fp, offset, indices.data(), indices.size() * sizeof(uint32_t));
+        }
+        offset += indices.size() * header.indexSize;
+    }
+    ok = fclose(fp) == 0 && ok;
+    if (!ok)
+    {
+        printf("Failed to write \"%s\"\n", path.c_str());
+        return false;
+    }
+
+    printf("%s: %u meshes, %llu vertices, %llu %u-bit indices, %llu bytes\n", path.c_str(), header.meshCount,
+           (unsigned long long)header.vertexCount, (unsigned long long)header.indexCount, header.indexSize * 8,
+           (unsigned long long)offset);
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<Mesh> meshes;
+    if (argc == 4 && !strcmp(argv[1], "--generate") && atoll(argv[2]) > 0)
+    {
+        GenerateTerrain((uint64_t)atoll(argv[2]), meshes);
+    }
+    else if (argc == 3)
+    {
+        const std::string input = argv[1];
+        const std::string ext = Extension(input);
+        bool loaded;
+        if (ext == "obj")
+        {
+            loaded = LoadObj(input, meshes);
+        }
+        else if (ext == "gltf" || ext == "glb")
+        {
+            loaded = LoadGltf(input, meshes);
+        }
+        else
+        {
+            printf("%s: unknown file type, expected .obj, .gltf or .glb\n", input.c_str());
+            return 1;
+        }
+        if (!loaded)
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        printf("usage: openxrstub_meshconv INPUT OUTPUT\n");
+        printf("       openxrstub_meshconv --generate VERTICES OUTPUT\n");
+        return 1;
+    }
+
+    // drop meshes with nothing to draw.
+    meshes.erase(std::remove_if(meshes.begin(), meshes.end(), [](const Mesh& mesh) { return mesh.indices.empty(); }),
+                 meshes.end());
+    return WriteScene(argv[argc - 1], meshes) ? 0 : 1;
+}